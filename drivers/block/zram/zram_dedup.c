@@ -0,0 +1,187 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Deduplication of identical compressed objects in zram
+ *
+ * Compressed objects are hashed with xxh32 into buckets of rbtrees keyed
+ * by the checksum. A write whose compressed data matches an object
+ * already stored takes a reference on it instead of allocating a new
+ * zsmalloc object.
+ */
+
+#include <linux/vmalloc.h>
+#include <linux/slab.h>
+#include <linux/log2.h>
+#include <linux/xxhash.h>
+
+#include "zram_drv.h"
+
+/* One hash bucket for every (1 << ZRAM_HASH_SHIFT) pages of disksize */
+#define ZRAM_HASH_SHIFT		6
+#define ZRAM_HASH_SIZE_MIN	(1UL << 6)
+#define ZRAM_HASH_SIZE_MAX	(1UL << 20)
+
+u32 zram_dedup_checksum(const void *mem, unsigned int len)
+{
+	return xxh32(mem, len, 0);
+}
+
+static struct zram_hash *zram_dedup_bucket(struct zram *zram, u32 checksum)
+{
+	return &zram->hash[checksum & (zram->hash_size - 1)];
+}
+
+/*
+ * Look up an object with the same content as @mem and take a reference on
+ * it. Returns NULL if there is none.
+ */
+struct zram_entry *zram_dedup_find(struct zram *zram, const void *mem,
+				   unsigned int len, u32 checksum)
+{
+	struct zram_hash *hash = zram_dedup_bucket(zram, checksum);
+	struct zram_entry *entry, *found = NULL;
+	struct rb_node *rb_node, *prev;
+	bool match;
+	void *obj;
+
+	spin_lock(&hash->lock);
+	rb_node = hash->rb_root.rb_node;
+	while (rb_node) {
+		entry = rb_entry(rb_node, struct zram_entry, rb_node);
+		if (checksum == entry->checksum)
+			break;
+
+		if (checksum < entry->checksum)
+			rb_node = rb_node->rb_left;
+		else
+			rb_node = rb_node->rb_right;
+	}
+
+	if (!rb_node)
+		goto out;
+
+	/* Several entries may share a checksum; start from the first one */
+	while ((prev = rb_prev(rb_node)) &&
+	       rb_entry(prev, struct zram_entry, rb_node)->checksum == checksum)
+		rb_node = prev;
+
+	for (; rb_node; rb_node = rb_next(rb_node)) {
+		entry = rb_entry(rb_node, struct zram_entry, rb_node);
+		if (entry->checksum != checksum)
+			break;
+
+		if (entry->len != len)
+			continue;
+
+		obj = zs_map_object(zram->mem_pool, entry->handle, ZS_MM_RO);
+		match = !memcmp(obj, mem, len);
+		zs_unmap_object(zram->mem_pool, entry->handle);
+
+		if (match) {
+			entry->refcount++;
+			found = entry;
+			break;
+		}
+	}
+out:
+	spin_unlock(&hash->lock);
+
+	return found;
+}
+
+/*
+ * Make a newly stored object available for deduplication. Returns NULL if
+ * the entry can't be allocated, in which case the object is simply not
+ * shared.
+ */
+struct zram_entry *zram_dedup_insert(struct zram *zram, unsigned long handle,
+				     unsigned int len, u32 checksum)
+{
+	struct zram_hash *hash = zram_dedup_bucket(zram, checksum);
+	struct rb_node **rb_node, *parent = NULL;
+	struct zram_entry *entry, *cur;
+
+	entry = kmalloc(sizeof(*entry), GFP_NOIO | __GFP_NOWARN);
+	if (!entry)
+		return NULL;
+
+	entry->handle = handle;
+	entry->len = len;
+	entry->checksum = checksum;
+	entry->refcount = 1;
+
+	spin_lock(&hash->lock);
+	rb_node = &hash->rb_root.rb_node;
+	while (*rb_node) {
+		parent = *rb_node;
+		cur = rb_entry(parent, struct zram_entry, rb_node);
+		if (checksum < cur->checksum)
+			rb_node = &parent->rb_left;
+		else
+			rb_node = &parent->rb_right;
+	}
+
+	rb_link_node(&entry->rb_node, parent, rb_node);
+	rb_insert_color(&entry->rb_node, &hash->rb_root);
+	spin_unlock(&hash->lock);
+
+	atomic64_add(sizeof(*entry), &zram->stats.meta_data_size);
+
+	return entry;
+}
+
+/*
+ * Drop a reference on @entry. Returns true if it was the last one, in which
+ * case the zsmalloc object has been freed too.
+ */
+bool zram_dedup_put(struct zram *zram, struct zram_entry *entry)
+{
+	struct zram_hash *hash = zram_dedup_bucket(zram, entry->checksum);
+	unsigned int len = entry->len;
+
+	spin_lock(&hash->lock);
+	if (--entry->refcount) {
+		spin_unlock(&hash->lock);
+		atomic64_sub(len, &zram->stats.dup_data_size);
+		return false;
+	}
+
+	rb_erase(&entry->rb_node, &hash->rb_root);
+	spin_unlock(&hash->lock);
+
+	zs_free(zram->mem_pool, entry->handle);
+	kfree(entry);
+	atomic64_sub(sizeof(*entry), &zram->stats.meta_data_size);
+
+	return true;
+}
+
+int zram_dedup_init(struct zram *zram, size_t num_pages)
+{
+	size_t i;
+
+	if (!zram->use_dedup)
+		return 0;
+
+	zram->hash_size = clamp_t(size_t, num_pages >> ZRAM_HASH_SHIFT,
+				  ZRAM_HASH_SIZE_MIN, ZRAM_HASH_SIZE_MAX);
+	zram->hash_size = roundup_pow_of_two(zram->hash_size);
+	zram->hash = vzalloc(array_size(zram->hash_size, sizeof(*zram->hash)));
+	if (!zram->hash) {
+		zram->hash_size = 0;
+		return -ENOMEM;
+	}
+
+	for (i = 0; i < zram->hash_size; i++) {
+		spin_lock_init(&zram->hash[i].lock);
+		zram->hash[i].rb_root = RB_ROOT;
+	}
+
+	return 0;
+}
+
+void zram_dedup_fini(struct zram *zram)
+{
+	vfree(zram->hash);
+	zram->hash = NULL;
+	zram->hash_size = 0;
+}
@@ -20,6 +20,7 @@
 #include <linux/crypto.h>
 
 #include "zcomp.h"
+#include "zram_dedup.h"
 
 #define SECTORS_PER_PAGE_SHIFT	(PAGE_SHIFT - SECTOR_SHIFT)
 #define SECTORS_PER_PAGE	(1 << SECTORS_PER_PAGE_SHIFT)
@@ -36,10 +37,13 @@
  *
  * zram is mainly used for memory efficiency so we want to keep memory
  * footprint small so we can squeeze size and flags into a field.
- * The lower ZRAM_FLAG_SHIFT bits is for object size (excluding header),
- * the higher bits is for zram_pageflags.
+ * The object size is at most PAGE_SIZE, so PAGE_SHIFT + 1 bits are
+ * enough for it and leave the rest of the field for zram_pageflags.
  */
-#define ZRAM_FLAG_SHIFT 24
+#define ZRAM_FLAG_SHIFT (PAGE_SHIFT + 1)
+
+/* Only 2 bits are allowed for comp priority index */
+#define ZRAM_COMP_PRIORITY_MASK	0x3UL
 
 /* Flags for zram pages (table[page_no].value) */
 enum zram_pageflags {
@@ -48,10 +52,20 @@ enum zram_pageflags {
 	ZRAM_SAME,	/* Page consists the same element */
 	ZRAM_WB,	/* page is stored on backing_device */
 	ZRAM_HUGE,	/* Incompressible page */
+	ZRAM_UNDER_WB,	/* page is being written back to backing_device */
+	ZRAM_IDLE,	/* page not accessed since it was marked idle */
+	ZRAM_INCOMPRESSIBLE, /* none of the algorithms could compress it */
+	ZRAM_COMP_PRIORITY_BIT1, /* First bit of comp priority index */
+	ZRAM_COMP_PRIORITY_BIT2, /* Second bit of comp priority index */
+	ZRAM_DEDUP,	/* handle points to a shared zram_entry */
 
 	__NR_ZRAM_PAGEFLAGS,
 };
 
+#define ZRAM_PRIMARY_COMP	0U
+#define ZRAM_SECONDARY_COMP	1U
+#define ZRAM_MAX_COMPS	4U
+
 /*-- Data structures */
 
 /* Allocated for each disk page */
@@ -79,12 +93,20 @@ struct zram_stats {
 	atomic64_t pages_stored;	/* no. of pages currently stored */
 	atomic_long_t max_used_pages;	/* no. of maximum pages stored */
 	atomic64_t writestall;		/* no. of write slow paths */
+	atomic64_t num_recompressed;	/* no. of pages recompressed */
+	atomic64_t dup_data_size;	/* compressed size of deduplicated pages */
+	atomic64_t meta_data_size;	/* size of dedup metadata */
+#ifdef CONFIG_ZRAM_WRITEBACK
+	atomic64_t bd_count;		/* no. of pages in backing device */
+	atomic64_t bd_reads;		/* no. of reads from backing device */
+	atomic64_t bd_writes;		/* no. of writes to backing device */
+#endif
 };
 
 struct zram {
 	struct zram_table_entry *table;
 	struct zs_pool *mem_pool;
-	struct zcomp *comp;
+	struct zcomp *comps[ZRAM_MAX_COMPS];
 	struct gendisk *disk;
 	/* Prevent concurrent execution of device init */
 	struct rw_semaphore init_lock;
@@ -99,7 +121,9 @@ struct zram {
 	 * we can store in a disk.
 	 */
 	u64 disksize;	/* bytes */
-	char compressor[CRYPTO_MAX_ALG_NAME];
+	/* comp_algs[ZRAM_PRIMARY_COMP] compresses every newly written page */
+	char comp_algs[ZRAM_MAX_COMPS][CRYPTO_MAX_ALG_NAME];
+	unsigned int num_active_comps;
 	/*
 	 * zram is claimed so open request will be failed
 	 */
@@ -115,5 +139,10 @@ struct zram {
 #ifdef CONFIG_ZRAM_MEMORY_TRACKING
 	struct dentry *debugfs_dir;
 #endif
+#ifdef CONFIG_ZRAM_DEDUP
+	bool use_dedup;
+	struct zram_hash *hash;
+	size_t hash_size;
+#endif
 };
 #endif
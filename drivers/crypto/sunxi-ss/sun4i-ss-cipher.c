@@ -53,6 +53,12 @@ static int sun4i_ss_opti_poll(struct skcipher_request *areq)
 
 	spin_lock_irqsave(&ss->slock, flags);
 
+	/* the device is in use by a DMA request, let the engine queue us */
+	if (ss->dma_active) {
+		spin_unlock_irqrestore(&ss->slock, flags);
+		return -EAGAIN;
+	}
+
 	for (i = 0; i < op->keylen; i += 4)
 		writel(*(op->key + i / 4), ss->base + SS_KEY0 + i);
 
@@ -187,6 +193,12 @@ static int sun4i_ss_cipher_poll(struct skcipher_request *areq)
 
 	spin_lock_irqsave(&ss->slock, flags);
 
+	/* the device is in use by a DMA request, let the engine queue us */
+	if (ss->dma_active) {
+		spin_unlock_irqrestore(&ss->slock, flags);
+		return -EAGAIN;
+	}
+
 	for (i = 0; i < op->keylen; i += 4)
 		writel(*(op->key + i / 4), ss->base + SS_KEY0 + i);
 
@@ -316,6 +328,232 @@ static int sun4i_ss_cipher_poll(struct skcipher_request *areq)
 	return err;
 }
 
+/*
+ * DMA could be used only if every SG is word aligned, both in offset and
+ * length, since the FIFOs are accessed 32bits at a time.
+ * The SGs are given whole to the DMA engine, so they must also add up to
+ * exactly len, otherwise the last one would be read or written past it.
+ */
+static bool sun4i_ss_sg_dma_ok(struct scatterlist *sg, unsigned int len)
+{
+	while (sg && len) {
+		if (!IS_ALIGNED(sg->offset, 4) || !IS_ALIGNED(sg->length, 4))
+			return false;
+		if (sg->length > len)
+			return false;
+		len -= sg->length;
+		sg = sg_next(sg);
+	}
+	return !len;
+}
+
+static bool sun4i_ss_can_dma(struct skcipher_request *areq)
+{
+	struct crypto_skcipher *tfm = crypto_skcipher_reqtfm(areq);
+	struct sun4i_tfm_ctx *op = crypto_skcipher_ctx(tfm);
+	struct sun4i_ss_ctx *ss = op->ss;
+
+	if (!ss->engine || areq->cryptlen < SS_DMA_MIN_LEN)
+		return false;
+	if (!areq->iv || !areq->src || !areq->dst)
+		return false;
+	return sun4i_ss_sg_dma_ok(areq->src, areq->cryptlen) &&
+	       sun4i_ss_sg_dma_ok(areq->dst, areq->cryptlen);
+}
+
+static void sun4i_ss_cipher_dma_unmap(struct skcipher_request *areq)
+{
+	struct crypto_skcipher *tfm = crypto_skcipher_reqtfm(areq);
+	struct sun4i_tfm_ctx *op = crypto_skcipher_ctx(tfm);
+	struct sun4i_cipher_req_ctx *ctx = skcipher_request_ctx(areq);
+	struct sun4i_ss_ctx *ss = op->ss;
+
+	if (areq->src == areq->dst) {
+		dma_unmap_sg(ss->dev, areq->src, ctx->src_nents,
+			     DMA_BIDIRECTIONAL);
+	} else {
+		dma_unmap_sg(ss->dev, areq->src, ctx->src_nents,
+			     DMA_TO_DEVICE);
+		dma_unmap_sg(ss->dev, areq->dst, ctx->dst_nents,
+			     DMA_FROM_DEVICE);
+	}
+}
+
+/* called by the TX DMA channel once all output words are written back */
+static void sun4i_ss_cipher_dma_done(void *data)
+{
+	struct skcipher_request *areq = data;
+	struct crypto_skcipher *tfm = crypto_skcipher_reqtfm(areq);
+	struct sun4i_tfm_ctx *op = crypto_skcipher_ctx(tfm);
+	struct sun4i_ss_ctx *ss = op->ss;
+	unsigned int ivsize = crypto_skcipher_ivsize(tfm);
+	unsigned long flags;
+	unsigned int i;
+	u32 v;
+
+	sun4i_ss_cipher_dma_unmap(areq);
+
+	spin_lock_irqsave(&ss->slock, flags);
+	for (i = 0; i < 4 && i < ivsize / 4; i++) {
+		v = readl(ss->base + SS_IV0 + i * 4);
+		*(u32 *)(areq->iv + i * 4) = v;
+	}
+	writel(0, ss->base + SS_ICSR);
+	writel(0, ss->base + SS_CTL);
+	ss->dma_active = false;
+	spin_unlock_irqrestore(&ss->slock, flags);
+
+	crypto_finalize_skcipher_request(ss->engine, areq, 0);
+}
+
+static int sun4i_ss_cipher_dma(struct skcipher_request *areq)
+{
+	struct crypto_skcipher *tfm = crypto_skcipher_reqtfm(areq);
+	struct sun4i_tfm_ctx *op = crypto_skcipher_ctx(tfm);
+	struct sun4i_cipher_req_ctx *ctx = skcipher_request_ctx(areq);
+	struct sun4i_ss_ctx *ss = op->ss;
+	unsigned int ivsize = crypto_skcipher_ivsize(tfm);
+	struct dma_async_tx_descriptor *rxd, *txd;
+	struct dma_slave_config cfg;
+	int src_cnt, dst_cnt;
+	unsigned long flags;
+	unsigned int i;
+	int err;
+	u32 v;
+
+	ctx->src_nents = sg_nents_for_len(areq->src, areq->cryptlen);
+	ctx->dst_nents = sg_nents_for_len(areq->dst, areq->cryptlen);
+	if (ctx->src_nents < 0 || ctx->dst_nents < 0)
+		return -EINVAL;
+
+	if (areq->src == areq->dst) {
+		src_cnt = dma_map_sg(ss->dev, areq->src, ctx->src_nents,
+				     DMA_BIDIRECTIONAL);
+		if (!src_cnt)
+			goto err_map;
+		dst_cnt = src_cnt;
+	} else {
+		src_cnt = dma_map_sg(ss->dev, areq->src, ctx->src_nents,
+				     DMA_TO_DEVICE);
+		if (!src_cnt)
+			goto err_map;
+		dst_cnt = dma_map_sg(ss->dev, areq->dst, ctx->dst_nents,
+				     DMA_FROM_DEVICE);
+		if (!dst_cnt) {
+			dma_unmap_sg(ss->dev, areq->src, ctx->src_nents,
+				     DMA_TO_DEVICE);
+			goto err_map;
+		}
+	}
+
+	memset(&cfg, 0, sizeof(cfg));
+	cfg.direction = DMA_MEM_TO_DEV;
+	cfg.dst_addr = ss->res->start + SS_RXFIFO;
+	cfg.dst_addr_width = DMA_SLAVE_BUSWIDTH_4_BYTES;
+	cfg.dst_maxburst = SS_DMA_BURST;
+	err = dmaengine_slave_config(ss->dma_rx, &cfg);
+	if (err)
+		goto err_unmap;
+
+	memset(&cfg, 0, sizeof(cfg));
+	cfg.direction = DMA_DEV_TO_MEM;
+	cfg.src_addr = ss->res->start + SS_TXFIFO;
+	cfg.src_addr_width = DMA_SLAVE_BUSWIDTH_4_BYTES;
+	cfg.src_maxburst = SS_DMA_BURST;
+	err = dmaengine_slave_config(ss->dma_tx, &cfg);
+	if (err)
+		goto err_unmap;
+
+	rxd = dmaengine_prep_slave_sg(ss->dma_rx, areq->src, src_cnt,
+				      DMA_MEM_TO_DEV, DMA_PREP_INTERRUPT);
+	txd = dmaengine_prep_slave_sg(ss->dma_tx, areq->dst, dst_cnt,
+				      DMA_DEV_TO_MEM, DMA_PREP_INTERRUPT);
+	if (!rxd || !txd) {
+		dev_err_ratelimited(ss->dev, "ERROR: Cannot prepare DMA\n");
+		err = -EIO;
+		goto err_terminate;
+	}
+	txd->callback = sun4i_ss_cipher_dma_done;
+	txd->callback_param = areq;
+
+	spin_lock_irqsave(&ss->slock, flags);
+	ss->dma_active = true;
+
+	for (i = 0; i < op->keylen; i += 4)
+		writel(*(op->key + i / 4), ss->base + SS_KEY0 + i);
+
+	for (i = 0; i < 4 && i < ivsize / 4; i++) {
+		v = *(u32 *)(areq->iv + i * 4);
+		writel(v, ss->base + SS_IV0 + i * 4);
+	}
+	writel(SS_RXFIFO_EMP_TRIG(SS_DMA_BURST) |
+	       SS_TXFIFO_AVA_TRIG(SS_DMA_BURST), ss->base + SS_FCSR);
+	writel(SS_ICS_DRQ_ENABLE, ss->base + SS_ICSR);
+	writel(ctx->mode, ss->base + SS_CTL);
+	spin_unlock_irqrestore(&ss->slock, flags);
+
+	/* start draining the output before feeding the input */
+	dmaengine_submit(txd);
+	dmaengine_submit(rxd);
+	dma_async_issue_pending(ss->dma_tx);
+	dma_async_issue_pending(ss->dma_rx);
+
+	return 0;
+
+err_terminate:
+	dmaengine_terminate_all(ss->dma_rx);
+	dmaengine_terminate_all(ss->dma_tx);
+err_unmap:
+	sun4i_ss_cipher_dma_unmap(areq);
+	return err;
+err_map:
+	dev_err_ratelimited(ss->dev, "ERROR: Cannot map SGs\n");
+	return -ENOMEM;
+}
+
+/*
+ * Called by the crypto engine, one request at a time.
+ * Requests which cannot use DMA are queued here only because the device
+ * was busy when they were issued, so handle them by PIO.
+ */
+static int sun4i_ss_cipher_run(struct crypto_engine *engine, void *async_req)
+{
+	struct skcipher_request *areq = container_of(async_req,
+						     struct skcipher_request,
+						     base);
+	int err;
+
+	if (sun4i_ss_can_dma(areq))
+		return sun4i_ss_cipher_dma(areq);
+
+	err = sun4i_ss_cipher_poll(areq);
+	crypto_finalize_skcipher_request(engine, areq, err);
+	return 0;
+}
+
+/*
+ * Large requests are queued to the engine and processed by DMA, small ones
+ * are handled synchronously by PIO unless the device is owned by a DMA
+ * request, in which case they are queued behind it.
+ */
+static int sun4i_ss_cipher(struct skcipher_request *areq)
+{
+	struct crypto_skcipher *tfm = crypto_skcipher_reqtfm(areq);
+	struct sun4i_tfm_ctx *op = crypto_skcipher_ctx(tfm);
+	struct sun4i_ss_ctx *ss = op->ss;
+	int err;
+
+	if (sun4i_ss_can_dma(areq))
+		return crypto_transfer_skcipher_request_to_engine(ss->engine,
+								  areq);
+
+	err = sun4i_ss_cipher_poll(areq);
+	if (err == -EAGAIN)
+		return crypto_transfer_skcipher_request_to_engine(ss->engine,
+								  areq);
+	return err;
+}
+
 /* CBC AES */
 int sun4i_ss_cbc_aes_encrypt(struct skcipher_request *areq)
 {
@@ -325,7 +563,7 @@ int sun4i_ss_cbc_aes_encrypt(struct skcipher_request *areq)
 
 	rctx->mode = SS_OP_AES | SS_CBC | SS_ENABLED | SS_ENCRYPTION |
 		op->keymode;
-	return sun4i_ss_cipher_poll(areq);
+	return sun4i_ss_cipher(areq);
 }
 
 int sun4i_ss_cbc_aes_decrypt(struct skcipher_request *areq)
@@ -336,7 +574,7 @@ int sun4i_ss_cbc_aes_decrypt(struct skcipher_request *areq)
 
 	rctx->mode = SS_OP_AES | SS_CBC | SS_ENABLED | SS_DECRYPTION |
 		op->keymode;
-	return sun4i_ss_cipher_poll(areq);
+	return sun4i_ss_cipher(areq);
 }
 
 /* ECB AES */
@@ -348,7 +586,7 @@ int sun4i_ss_ecb_aes_encrypt(struct skcipher_request *areq)
 
 	rctx->mode = SS_OP_AES | SS_ECB | SS_ENABLED | SS_ENCRYPTION |
 		op->keymode;
-	return sun4i_ss_cipher_poll(areq);
+	return sun4i_ss_cipher(areq);
 }
 
 int sun4i_ss_ecb_aes_decrypt(struct skcipher_request *areq)
@@ -359,7 +597,7 @@ int sun4i_ss_ecb_aes_decrypt(struct skcipher_request *areq)
 
 	rctx->mode = SS_OP_AES | SS_ECB | SS_ENABLED | SS_DECRYPTION |
 		op->keymode;
-	return sun4i_ss_cipher_poll(areq);
+	return sun4i_ss_cipher(areq);
 }
 
 /* CBC DES */
@@ -371,7 +609,7 @@ int sun4i_ss_cbc_des_encrypt(struct skcipher_request *areq)
 
 	rctx->mode = SS_OP_DES | SS_CBC | SS_ENABLED | SS_ENCRYPTION |
 		op->keymode;
-	return sun4i_ss_cipher_poll(areq);
+	return sun4i_ss_cipher(areq);
 }
 
 int sun4i_ss_cbc_des_decrypt(struct skcipher_request *areq)
@@ -382,7 +620,7 @@ int sun4i_ss_cbc_des_decrypt(struct skcipher_request *areq)
 
 	rctx->mode = SS_OP_DES | SS_CBC | SS_ENABLED | SS_DECRYPTION |
 		op->keymode;
-	return sun4i_ss_cipher_poll(areq);
+	return sun4i_ss_cipher(areq);
 }
 
 /* ECB DES */
@@ -394,7 +632,7 @@ int sun4i_ss_ecb_des_encrypt(struct skcipher_request *areq)
 
 	rctx->mode = SS_OP_DES | SS_ECB | SS_ENABLED | SS_ENCRYPTION |
 		op->keymode;
-	return sun4i_ss_cipher_poll(areq);
+	return sun4i_ss_cipher(areq);
 }
 
 int sun4i_ss_ecb_des_decrypt(struct skcipher_request *areq)
@@ -405,7 +643,7 @@ int sun4i_ss_ecb_des_decrypt(struct skcipher_request *areq)
 
 	rctx->mode = SS_OP_DES | SS_ECB | SS_ENABLED | SS_DECRYPTION |
 		op->keymode;
-	return sun4i_ss_cipher_poll(areq);
+	return sun4i_ss_cipher(areq);
 }
 
 /* CBC 3DES */
@@ -417,7 +655,7 @@ int sun4i_ss_cbc_des3_encrypt(struct skcipher_request *areq)
 
 	rctx->mode = SS_OP_3DES | SS_CBC | SS_ENABLED | SS_ENCRYPTION |
 		op->keymode;
-	return sun4i_ss_cipher_poll(areq);
+	return sun4i_ss_cipher(areq);
 }
 
 int sun4i_ss_cbc_des3_decrypt(struct skcipher_request *areq)
@@ -428,7 +666,7 @@ int sun4i_ss_cbc_des3_decrypt(struct skcipher_request *areq)
 
 	rctx->mode = SS_OP_3DES | SS_CBC | SS_ENABLED | SS_DECRYPTION |
 		op->keymode;
-	return sun4i_ss_cipher_poll(areq);
+	return sun4i_ss_cipher(areq);
 }
 
 /* ECB 3DES */
@@ -440,7 +678,7 @@ int sun4i_ss_ecb_des3_encrypt(struct skcipher_request *areq)
 
 	rctx->mode = SS_OP_3DES | SS_ECB | SS_ENABLED | SS_ENCRYPTION |
 		op->keymode;
-	return sun4i_ss_cipher_poll(areq);
+	return sun4i_ss_cipher(areq);
 }
 
 int sun4i_ss_ecb_des3_decrypt(struct skcipher_request *areq)
@@ -451,7 +689,7 @@ int sun4i_ss_ecb_des3_decrypt(struct skcipher_request *areq)
 
 	rctx->mode = SS_OP_3DES | SS_ECB | SS_ENABLED | SS_DECRYPTION |
 		op->keymode;
-	return sun4i_ss_cipher_poll(areq);
+	return sun4i_ss_cipher(areq);
 }
 
 int sun4i_ss_cipher_init(struct crypto_tfm *tfm)
@@ -464,6 +702,7 @@ int sun4i_ss_cipher_init(struct crypto_tfm *tfm)
 	algt = container_of(tfm->__crt_alg, struct sun4i_ss_alg_template,
 			    alg.crypto.base);
 	op->ss = algt->ss;
+	op->enginectx.op.do_one_request = sun4i_ss_cipher_run;
 
 	crypto_skcipher_set_reqsize(__crypto_skcipher_cast(tfm),
 				    sizeof(struct sun4i_cipher_req_ctx));
@@ -23,6 +23,7 @@
 #include <linux/interrupt.h>
 #include <linux/delay.h>
 #include <linux/reset.h>
+#include <linux/seq_file.h>
 
 #include "sun4i-ss.h"
 
@@ -45,10 +46,12 @@ static struct sun4i_ss_alg_template ss_algs[] = {
 				.cra_driver_name = "md5-sun4i-ss",
 				.cra_priority = 300,
 				.cra_alignmask = 3,
+				.cra_flags = CRYPTO_ALG_NEED_FALLBACK | CRYPTO_ALG_ASYNC,
 				.cra_blocksize = MD5_HMAC_BLOCK_SIZE,
-				.cra_ctxsize = sizeof(struct sun4i_req_ctx),
+				.cra_ctxsize = sizeof(struct sun4i_tfm_ctx),
 				.cra_module = THIS_MODULE,
-				.cra_init = sun4i_hash_crainit
+				.cra_init = sun4i_hash_crainit,
+				.cra_exit = sun4i_hash_craexit,
 			}
 		}
 	}
@@ -71,10 +74,12 @@ static struct sun4i_ss_alg_template ss_algs[] = {
 				.cra_driver_name = "sha1-sun4i-ss",
 				.cra_priority = 300,
 				.cra_alignmask = 3,
+				.cra_flags = CRYPTO_ALG_NEED_FALLBACK | CRYPTO_ALG_ASYNC,
 				.cra_blocksize = SHA1_BLOCK_SIZE,
-				.cra_ctxsize = sizeof(struct sun4i_req_ctx),
+				.cra_ctxsize = sizeof(struct sun4i_tfm_ctx),
 				.cra_module = THIS_MODULE,
-				.cra_init = sun4i_hash_crainit
+				.cra_init = sun4i_hash_crainit,
+				.cra_exit = sun4i_hash_craexit,
 			}
 		}
 	}
@@ -92,7 +97,7 @@ static struct sun4i_ss_alg_template ss_algs[] = {
 			.cra_driver_name = "cbc-aes-sun4i-ss",
 			.cra_priority = 300,
 			.cra_blocksize = AES_BLOCK_SIZE,
-			.cra_flags = CRYPTO_ALG_KERN_DRIVER_ONLY,
+			.cra_flags = CRYPTO_ALG_KERN_DRIVER_ONLY | CRYPTO_ALG_ASYNC,
 			.cra_ctxsize = sizeof(struct sun4i_tfm_ctx),
 			.cra_module = THIS_MODULE,
 			.cra_alignmask = 3,
@@ -113,7 +118,7 @@ static struct sun4i_ss_alg_template ss_algs[] = {
 			.cra_driver_name = "ecb-aes-sun4i-ss",
 			.cra_priority = 300,
 			.cra_blocksize = AES_BLOCK_SIZE,
-			.cra_flags = CRYPTO_ALG_KERN_DRIVER_ONLY,
+			.cra_flags = CRYPTO_ALG_KERN_DRIVER_ONLY | CRYPTO_ALG_ASYNC,
 			.cra_ctxsize = sizeof(struct sun4i_tfm_ctx),
 			.cra_module = THIS_MODULE,
 			.cra_alignmask = 3,
@@ -134,7 +139,7 @@ static struct sun4i_ss_alg_template ss_algs[] = {
 			.cra_driver_name = "cbc-des-sun4i-ss",
 			.cra_priority = 300,
 			.cra_blocksize = DES_BLOCK_SIZE,
-			.cra_flags = CRYPTO_ALG_KERN_DRIVER_ONLY,
+			.cra_flags = CRYPTO_ALG_KERN_DRIVER_ONLY | CRYPTO_ALG_ASYNC,
 			.cra_ctxsize = sizeof(struct sun4i_req_ctx),
 			.cra_module = THIS_MODULE,
 			.cra_alignmask = 3,
@@ -154,7 +159,7 @@ static struct sun4i_ss_alg_template ss_algs[] = {
 			.cra_driver_name = "ecb-des-sun4i-ss",
 			.cra_priority = 300,
 			.cra_blocksize = DES_BLOCK_SIZE,
-			.cra_flags = CRYPTO_ALG_KERN_DRIVER_ONLY,
+			.cra_flags = CRYPTO_ALG_KERN_DRIVER_ONLY | CRYPTO_ALG_ASYNC,
 			.cra_ctxsize = sizeof(struct sun4i_req_ctx),
 			.cra_module = THIS_MODULE,
 			.cra_alignmask = 3,
@@ -175,7 +180,7 @@ static struct sun4i_ss_alg_template ss_algs[] = {
 			.cra_driver_name = "cbc-des3-sun4i-ss",
 			.cra_priority = 300,
 			.cra_blocksize = DES3_EDE_BLOCK_SIZE,
-			.cra_flags = CRYPTO_ALG_KERN_DRIVER_ONLY,
+			.cra_flags = CRYPTO_ALG_KERN_DRIVER_ONLY | CRYPTO_ALG_ASYNC,
 			.cra_ctxsize = sizeof(struct sun4i_req_ctx),
 			.cra_module = THIS_MODULE,
 			.cra_alignmask = 3,
@@ -196,6 +201,7 @@ static struct sun4i_ss_alg_template ss_algs[] = {
 			.cra_driver_name = "ecb-des3-sun4i-ss",
 			.cra_priority = 300,
 			.cra_blocksize = DES3_EDE_BLOCK_SIZE,
+			.cra_flags = CRYPTO_ALG_KERN_DRIVER_ONLY | CRYPTO_ALG_ASYNC,
 			.cra_ctxsize = sizeof(struct sun4i_req_ctx),
 			.cra_module = THIS_MODULE,
 			.cra_alignmask = 3,
@@ -222,6 +228,88 @@ static struct sun4i_ss_alg_template ss_algs[] = {
 #endif
 };
 
+/*
+ * The DMA channels are optional, without them (or without a DT describing
+ * them) all requests are handled synchronously by PIO.
+ */
+static int sun4i_ss_dma_init(struct sun4i_ss_ctx *ss)
+{
+	int err;
+
+	ss->dma_rx = dma_request_chan(ss->dev, "rx");
+	if (IS_ERR(ss->dma_rx)) {
+		err = PTR_ERR(ss->dma_rx);
+		ss->dma_rx = NULL;
+		if (err == -EPROBE_DEFER)
+			return err;
+		dev_info(ss->dev, "No DMA channels, using PIO only\n");
+		return 0;
+	}
+
+	ss->dma_tx = dma_request_chan(ss->dev, "tx");
+	if (IS_ERR(ss->dma_tx)) {
+		err = PTR_ERR(ss->dma_tx);
+		ss->dma_tx = NULL;
+		if (err == -EPROBE_DEFER)
+			goto error_rx;
+		dev_info(ss->dev, "No TX DMA channel, using PIO only\n");
+		err = 0;
+		goto error_rx;
+	}
+
+	ss->engine = crypto_engine_alloc_init(ss->dev, true);
+	if (!ss->engine) {
+		dev_err(ss->dev, "Cannot allocate crypto engine\n");
+		err = -ENOMEM;
+		goto error_tx;
+	}
+
+	err = crypto_engine_start(ss->engine);
+	if (err) {
+		dev_err(ss->dev, "Cannot start crypto engine\n");
+		goto error_engine;
+	}
+
+	return 0;
+error_engine:
+	crypto_engine_exit(ss->engine);
+	ss->engine = NULL;
+error_tx:
+	dma_release_channel(ss->dma_tx);
+	ss->dma_tx = NULL;
+error_rx:
+	dma_release_channel(ss->dma_rx);
+	ss->dma_rx = NULL;
+	return err;
+}
+
+static void sun4i_ss_dma_exit(struct sun4i_ss_ctx *ss)
+{
+	if (!ss->engine)
+		return;
+
+	crypto_engine_exit(ss->engine);
+	dma_release_channel(ss->dma_tx);
+	dma_release_channel(ss->dma_rx);
+}
+
+static int sun4i_ss_stats_show(struct seq_file *seq, void *v)
+{
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(ss_algs); i++) {
+		if (ss_algs[i].type != CRYPTO_ALG_TYPE_AHASH)
+			continue;
+		seq_printf(seq, "%s threshold=%u hw=%ld fallback=%ld\n",
+			   ss_algs[i].alg.hash.halg.base.cra_driver_name,
+			   ss_algs[i].hash_threshold,
+			   atomic_long_read(&ss_algs[i].stat_hw),
+			   atomic_long_read(&ss_algs[i].stat_fb));
+	}
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(sun4i_ss_stats);
+
 static int sun4i_ss_probe(struct platform_device *pdev)
 {
 	struct resource *res;
@@ -245,6 +333,7 @@ static int sun4i_ss_probe(struct platform_device *pdev)
 		dev_err(&pdev->dev, "Cannot request MMIO\n");
 		return PTR_ERR(ss->base);
 	}
+	ss->res = res;
 
 	ss->ssclk = devm_clk_get(&pdev->dev, "mod");
 	if (IS_ERR(ss->ssclk)) {
@@ -343,6 +432,10 @@ static int sun4i_ss_probe(struct platform_device *pdev)
 
 	spin_lock_init(&ss->slock);
 
+	err = sun4i_ss_dma_init(ss);
+	if (err)
+		goto error_dma;
+
 	for (i = 0; i < ARRAY_SIZE(ss_algs); i++) {
 		ss_algs[i].ss = ss;
 		switch (ss_algs[i].type) {
@@ -371,6 +464,15 @@ static int sun4i_ss_probe(struct platform_device *pdev)
 			break;
 		}
 	}
+
+	for (i = 0; i < ARRAY_SIZE(ss_algs); i++)
+		if (ss_algs[i].type == CRYPTO_ALG_TYPE_AHASH)
+			sun4i_hash_calibrate(&ss_algs[i]);
+
+	ss->dbgfs_dir = debugfs_create_dir(dev_name(&pdev->dev), NULL);
+	debugfs_create_file("stats", 0444, ss->dbgfs_dir, ss,
+			    &sun4i_ss_stats_fops);
+
 	platform_set_drvdata(pdev, ss);
 	return 0;
 error_alg:
@@ -388,6 +490,8 @@ static int sun4i_ss_probe(struct platform_device *pdev)
 			break;
 		}
 	}
+	sun4i_ss_dma_exit(ss);
+error_dma:
 	if (ss->reset)
 		reset_control_assert(ss->reset);
 error_clk:
@@ -402,6 +506,8 @@ static int sun4i_ss_remove(struct platform_device *pdev)
 	int i;
 	struct sun4i_ss_ctx *ss = platform_get_drvdata(pdev);
 
+	debugfs_remove_recursive(ss->dbgfs_dir);
+
 	for (i = 0; i < ARRAY_SIZE(ss_algs); i++) {
 		switch (ss_algs[i].type) {
 		case CRYPTO_ALG_TYPE_SKCIPHER:
@@ -416,6 +522,8 @@ static int sun4i_ss_remove(struct platform_device *pdev)
 		}
 	}
 
+	sun4i_ss_dma_exit(ss);
+
 	writel(0, ss->base + SS_CTL);
 	if (ss->reset)
 		reset_control_assert(ss->reset);
@@ -18,6 +18,8 @@
 /* This is a totally arbitrary value */
 #define SS_TIMEOUT 100
 
+static int sun4i_hash_run(struct crypto_engine *engine, void *async_req);
+
 int sun4i_hash_crainit(struct crypto_tfm *tfm)
 {
 	struct sun4i_tfm_ctx *op = crypto_tfm_ctx(tfm);
@@ -28,12 +30,27 @@ int sun4i_hash_crainit(struct crypto_tfm *tfm)
 
 	algt = container_of(alg, struct sun4i_ss_alg_template, alg.hash);
 	op->ss = algt->ss;
+	op->enginectx.op.do_one_request = sun4i_hash_run;
+
+	op->fallback_tfm = crypto_alloc_shash(crypto_tfm_alg_name(tfm), 0,
+					      CRYPTO_ALG_NEED_FALLBACK);
+	if (IS_ERR(op->fallback_tfm)) {
+		dev_err(op->ss->dev, "Fallback driver could not be loaded\n");
+		return PTR_ERR(op->fallback_tfm);
+	}
 
 	crypto_ahash_set_reqsize(__crypto_ahash_cast(tfm),
 				 sizeof(struct sun4i_req_ctx));
 	return 0;
 }
 
+void sun4i_hash_craexit(struct crypto_tfm *tfm)
+{
+	struct sun4i_tfm_ctx *op = crypto_tfm_ctx(tfm);
+
+	crypto_free_shash(op->fallback_tfm);
+}
+
 /* sun4i_hash_init: initialize request context */
 int sun4i_hash_init(struct ahash_request *areq)
 {
@@ -213,6 +230,12 @@ static int sun4i_hash(struct ahash_request *areq)
 
 	spin_lock_bh(&ss->slock);
 
+	/* the device is in use by a DMA request, let the engine queue us */
+	if (ss->dma_active) {
+		spin_unlock_bh(&ss->slock);
+		return -EAGAIN;
+	}
+
 	/*
 	 * if some data have been processed before,
 	 * we need to restore the partial hash state
@@ -483,12 +506,117 @@ static int sun4i_hash(struct ahash_request *areq)
 	return err;
 }
 
+/* called by the crypto engine for requests queued behind a DMA request */
+static int sun4i_hash_run(struct crypto_engine *engine, void *async_req)
+{
+	struct ahash_request *areq = ahash_request_cast(async_req);
+
+	crypto_finalize_hash_request(engine, areq, sun4i_hash(areq));
+	return 0;
+}
+
+/*
+ * sun4i_hash_fallback: process the request with the software implementation
+ *
+ * The partial state is moved from the request context to the fallback by
+ * export/import, both use the generic md5_state/sha1_state layout, and moved
+ * back if the hash is not finalized.
+ */
+static int sun4i_hash_fallback(struct ahash_request *areq)
+{
+	struct sun4i_req_ctx *op = ahash_request_ctx(areq);
+	struct crypto_ahash *tfm = crypto_ahash_reqtfm(areq);
+	struct sun4i_tfm_ctx *tfmctx = crypto_ahash_ctx(tfm);
+	struct ahash_alg *alg = __crypto_ahash_alg(tfm->base.__crt_alg);
+	SHASH_DESC_ON_STACK(desc, tfmctx->fallback_tfm);
+	union {
+		struct md5_state md5;
+		struct sha1_state sha1;
+	} state;
+	int flags = op->flags;
+	int err;
+
+	desc->tfm = tfmctx->fallback_tfm;
+	desc->flags = areq->base.flags & CRYPTO_TFM_REQ_MAY_SLEEP;
+
+	err = alg->export(areq, &state);
+	if (err)
+		return err;
+	err = crypto_shash_import(desc, &state);
+	if (err)
+		return err;
+
+	if (flags & SS_HASH_UPDATE) {
+		if (flags & SS_HASH_FINAL)
+			return shash_ahash_finup(areq, desc);
+		err = shash_ahash_update(areq, desc);
+	} else {
+		return crypto_shash_final(desc, areq->result);
+	}
+	if (err)
+		return err;
+
+	err = crypto_shash_export(desc, &state);
+	if (err)
+		return err;
+	return alg->import(areq, &state);
+}
+
+/*
+ * Route the request to the cheaper implementation, the device has a fixed
+ * cost (restoring the IV, FIFO handshake and reading back the digest) which
+ * dominates for small requests.
+ * Updates which only fill the wait buffer never touch the device and stay
+ * on the sun4i_hash() path.
+ */
+static bool sun4i_hash_need_fallback(struct ahash_request *areq)
+{
+	struct sun4i_req_ctx *op = ahash_request_ctx(areq);
+	struct crypto_ahash *tfm = crypto_ahash_reqtfm(areq);
+	struct sun4i_tfm_ctx *tfmctx = crypto_ahash_ctx(tfm);
+	struct ahash_alg *alg = __crypto_ahash_alg(tfm->base.__crt_alg);
+	struct sun4i_ss_alg_template *algt;
+	unsigned int len = op->len;
+	bool fallback;
+
+	algt = container_of(alg, struct sun4i_ss_alg_template, alg.hash);
+
+	if (op->flags & SS_HASH_UPDATE) {
+		if (areq->nbytes > UINT_MAX - len)
+			return false;
+		len += areq->nbytes;
+	}
+	if (len < 64 && !(op->flags & SS_HASH_FINAL))
+		return false;
+
+	fallback = len < algt->hash_threshold;
+	if (!tfmctx->calibrating)
+		atomic_long_inc(fallback ? &algt->stat_fb : &algt->stat_hw);
+	return fallback;
+}
+
+static int sun4i_hash_queue(struct ahash_request *areq)
+{
+	struct crypto_ahash *tfm = crypto_ahash_reqtfm(areq);
+	struct sun4i_tfm_ctx *tfmctx = crypto_ahash_ctx(tfm);
+	int err;
+
+	if (sun4i_hash_need_fallback(areq))
+		return sun4i_hash_fallback(areq);
+
+	err = sun4i_hash(areq);
+	if (err == -EAGAIN)
+		return crypto_transfer_hash_request_to_engine(tfmctx->ss->engine,
+							      areq);
+	return err;
+}
+
 int sun4i_hash_final(struct ahash_request *areq)
 {
 	struct sun4i_req_ctx *op = ahash_request_ctx(areq);
 
 	op->flags = SS_HASH_FINAL;
-	return sun4i_hash(areq);
+	return sun4i_hash_queue(areq);
 }
 
 int sun4i_hash_update(struct ahash_request *areq)
@@ -496,7 +624,7 @@ int sun4i_hash_update(struct ahash_request *areq)
 	struct sun4i_req_ctx *op = ahash_request_ctx(areq);
 
 	op->flags = SS_HASH_UPDATE;
-	return sun4i_hash(areq);
+	return sun4i_hash_queue(areq);
 }
 
 /* sun4i_hash_finup: finalize hashing operation after an update */
@@ -505,7 +633,7 @@ int sun4i_hash_finup(struct ahash_request *areq)
 	struct sun4i_req_ctx *op = ahash_request_ctx(areq);
 
 	op->flags = SS_HASH_UPDATE | SS_HASH_FINAL;
-	return sun4i_hash(areq);
+	return sun4i_hash_queue(areq);
 }
 
 /* combo of init/update/final functions */
@@ -519,5 +647,109 @@ int sun4i_hash_digest(struct ahash_request *areq)
 		return err;
 
 	op->flags = SS_HASH_UPDATE | SS_HASH_FINAL;
-	return sun4i_hash(areq);
+	return sun4i_hash_queue(areq);
+}
+
+#define SS_CALIBRATE_LOOPS 16
+
+static const unsigned int sun4i_hash_calibrate_sizes[] = {
+	16, 64, 256, 1024, 4096,
+};
+
+/*
+ * sun4i_hash_calibrate: find the request size where the device beats the
+ * software implementation
+ *
+ * Time SS_CALIBRATE_LOOPS digests of increasing sizes on both the device and
+ * the fallback, hash_threshold is set to the first size where the device is
+ * faster. On failure the threshold stays at 0 and the device is always used.
+ * Must be called after the algorithm is registered.
+ */
+void sun4i_hash_calibrate(struct sun4i_ss_alg_template *algt)
+{
+	struct sun4i_ss_ctx *ss = algt->ss;
+	const char *drv_name = algt->alg.hash.halg.base.cra_driver_name;
+	const char *name = algt->alg.hash.halg.base.cra_name;
+	u8 result[SHA1_DIGEST_SIZE];
+	struct sun4i_tfm_ctx *tfmctx;
+	struct crypto_ahash *tfm;
+	struct crypto_shash *fb;
+	struct ahash_request *req;
+	struct scatterlist sg;
+	DECLARE_CRYPTO_WAIT(wait);
+	s64 hw_ns, sw_ns;
+	unsigned int threshold = 0;
+	unsigned int i, j, len;
+	ktime_t start;
+	void *buf;
+	int err = 0;
+
+	len = sun4i_hash_calibrate_sizes[ARRAY_SIZE(sun4i_hash_calibrate_sizes) - 1];
+	buf = kzalloc(len, GFP_KERNEL);
+	if (!buf)
+		return;
+
+	tfm = crypto_alloc_ahash(drv_name, 0, 0);
+	if (IS_ERR(tfm)) {
+		err = PTR_ERR(tfm);
+		goto out_buf;
+	}
+	tfmctx = crypto_ahash_ctx(tfm);
+	tfmctx->calibrating = true;
+	fb = crypto_alloc_shash(name, 0, CRYPTO_ALG_NEED_FALLBACK);
+	if (IS_ERR(fb)) {
+		err = PTR_ERR(fb);
+		goto out_tfm;
+	}
+	req = ahash_request_alloc(tfm, GFP_KERNEL);
+	if (!req) {
+		err = -ENOMEM;
+		goto out_fb;
+	}
+	ahash_request_set_callback(req, CRYPTO_TFM_REQ_MAY_BACKLOG,
+				   crypto_req_done, &wait);
+
+	for (i = 0; i < ARRAY_SIZE(sun4i_hash_calibrate_sizes); i++) {
+		SHASH_DESC_ON_STACK(desc, fb);
+
+		len = sun4i_hash_calibrate_sizes[i];
+		sg_init_one(&sg, buf, len);
+		ahash_request_set_crypt(req, &sg, result, len);
+		desc->tfm = fb;
+		desc->flags = 0;
+
+		start = ktime_get();
+		for (j = 0; j < SS_CALIBRATE_LOOPS && !err; j++)
+			err = crypto_wait_req(crypto_ahash_digest(req), &wait);
+		hw_ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+
+		start = ktime_get();
+		for (j = 0; j < SS_CALIBRATE_LOOPS && !err; j++)
+			err = crypto_shash_digest(desc, buf, len, result);
+		sw_ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+
+		if (err)
+			break;
+		dev_dbg(ss->dev, "%s %u bytes: hw %lld ns sw %lld ns\n",
+			drv_name, len, hw_ns, sw_ns);
+		if (hw_ns <= sw_ns)
+			break;
+		threshold = len + 1;
+	}
+	if (!err && i == ARRAY_SIZE(sun4i_hash_calibrate_sizes))
+		threshold = UINT_MAX;
+
+	ahash_request_free(req);
+out_fb:
+	crypto_free_shash(fb);
+out_tfm:
+	crypto_free_ahash(tfm);
+out_buf:
+	kfree(buf);
+	if (err) {
+		dev_info(ss->dev, "Cannot calibrate %s err=%d\n", drv_name, err);
+		return;
+	}
+	algt->hash_threshold = threshold;
+	dev_dbg(ss->dev, "%s fallback threshold %u\n", drv_name, threshold);
 }
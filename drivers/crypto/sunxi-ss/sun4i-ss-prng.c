@@ -30,6 +30,12 @@ int sun4i_ss_prng_generate(struct crypto_rng *tfm, const u8 *src,
 
 	spin_lock_bh(&ss->slock);
 
+	/* the device is in use by a DMA request, SS_CTL must not be touched */
+	if (ss->dma_active) {
+		spin_unlock_bh(&ss->slock);
+		return -EBUSY;
+	}
+
 	writel(mode, ss->base + SS_CTL);
 
 	while (todo > 0) {
@@ -14,6 +14,7 @@
 
 #include <linux/clk.h>
 #include <linux/crypto.h>
+#include <linux/debugfs.h>
 #include <linux/io.h>
 #include <linux/module.h>
 #include <linux/of.h>
@@ -23,6 +24,9 @@
 #include <linux/scatterlist.h>
 #include <linux/interrupt.h>
 #include <linux/delay.h>
+#include <linux/dmaengine.h>
+#include <linux/dma-mapping.h>
+#include <crypto/engine.h>
 #include <crypto/md5.h>
 #include <crypto/skcipher.h>
 #include <crypto/sha.h>
@@ -50,6 +54,7 @@
 #define SS_IV3            0x30
 
 #define SS_FCSR           0x44
+#define SS_ICSR           0x48
 
 #define SS_MD0            0x4C
 #define SS_MD1            0x50
@@ -123,11 +128,26 @@
 #define SS_RX_DEFAULT	SS_RX_MAX
 #define SS_TX_MAX	33
 
+/* SS_FCSR FIFO trigger levels used in DMA mode, in words */
+#define SS_RXFIFO_EMP_TRIG(val)	(((val) & 0x1f) << 8)
+#define SS_TXFIFO_AVA_TRIG(val)	((val) & 0x1f)
+
 #define SS_RXFIFO_EMP_INT_PENDING	(1 << 10)
 #define SS_TXFIFO_AVA_INT_PENDING	(1 << 8)
 #define SS_RXFIFO_EMP_INT_ENABLE	(1 << 2)
 #define SS_TXFIFO_AVA_INT_ENABLE	(1 << 0)
 
+/* SS_ICSR DRQ enable - bit 4 */
+#define SS_ICS_DRQ_ENABLE		(1 << 4)
+
+/* DMA burst size in words, matching the FIFO trigger levels above */
+#define SS_DMA_BURST		4
+/*
+ * Requests smaller than this are handled by PIO, the cost of setting up
+ * both DMA channels is higher than pushing a few words through the FIFOs.
+ */
+#define SS_DMA_MIN_LEN		512
+
 #define SS_SEED_LEN 192
 #define SS_DATA_LEN 160
 
@@ -140,6 +160,11 @@ struct sun4i_ss_ctx {
 	struct device *dev;
 	struct resource *res;
 	spinlock_t slock; /* control the use of the device */
+	struct crypto_engine *engine;
+	struct dma_chan *dma_rx;
+	struct dma_chan *dma_tx;
+	bool dma_active; /* the device is owned by a DMA request, under slock */
+	struct dentry *dbgfs_dir;
 #ifdef CONFIG_CRYPTO_DEV_SUN4I_SS_PRNG
 	u32 seed[SS_SEED_LEN / BITS_PER_LONG];
 #endif
@@ -154,17 +179,30 @@ struct sun4i_ss_alg_template {
 		struct rng_alg rng;
 	} alg;
 	struct sun4i_ss_ctx *ss;
+	/*
+	 * Hash requests processing less bytes than hash_threshold are given
+	 * to the software fallback, 0 means always use the device.
+	 * It is computed by sun4i_hash_calibrate() at probe time.
+	 */
+	unsigned int hash_threshold;
+	atomic_long_t stat_hw;
+	atomic_long_t stat_fb;
 };
 
 struct sun4i_tfm_ctx {
+	struct crypto_engine_ctx enginectx; /* must be the first member */
 	u32 key[AES_MAX_KEY_SIZE / 4];/* divided by sizeof(u32) */
 	u32 keylen;
 	u32 keymode;
 	struct sun4i_ss_ctx *ss;
+	struct crypto_shash *fallback_tfm;
+	bool calibrating; /* requests are not accounted in the statistics */
 };
 
 struct sun4i_cipher_req_ctx {
 	u32 mode;
+	int src_nents;
+	int dst_nents;
 };
 
 struct sun4i_req_ctx {
@@ -177,6 +215,8 @@ struct sun4i_req_ctx {
 };
 
 int sun4i_hash_crainit(struct crypto_tfm *tfm);
+void sun4i_hash_craexit(struct crypto_tfm *tfm);
+void sun4i_hash_calibrate(struct sun4i_ss_alg_template *algt);
 int sun4i_hash_init(struct ahash_request *areq);
 int sun4i_hash_update(struct ahash_request *areq);
 int sun4i_hash_final(struct ahash_request *areq);
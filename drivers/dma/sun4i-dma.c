@@ -160,6 +160,9 @@ struct sun4i_dma_contract {
 	struct list_head		demands;
 	struct list_head		completed_demands;
 	int				is_cyclic;
+	/* Total length, and length of the promises still in demands */
+	size_t				len;
+	size_t				pending_len;
 };
 
 struct sun4i_dma_dev {
@@ -569,6 +572,18 @@ static struct sun4i_dma_contract *generate_dma_contract(void)
 	return contract;
 }
 
+/**
+ * Add a promise to a contract, keeping the lengths used for residue
+ * reporting up to date
+ */
+static void sun4i_dma_contract_add(struct sun4i_dma_contract *contract,
+				   struct sun4i_dma_promise *promise)
+{
+	list_add_tail(&promise->list, &contract->demands);
+	contract->len += promise->len;
+	contract->pending_len += promise->len;
+}
+
 /**
  * Get next promise on a cyclic transfer
  *
@@ -586,6 +601,7 @@ get_next_cyclic_promise(struct sun4i_dma_contract *contract)
 	if (!promise) {
 		list_splice_init(&contract->completed_demands,
 				 &contract->demands);
+		contract->pending_len = contract->len;
 		promise = list_first_entry(&contract->demands,
 					   struct sun4i_dma_promise, list);
 	}
@@ -655,7 +671,7 @@ sun4i_dma_prep_dma_memcpy(struct dma_chan *chan, dma_addr_t dest,
 	}
 
 	/* Fill the contract with our only promise */
-	list_add_tail(&promise->list, &contract->demands);
+	sun4i_dma_contract_add(contract, promise);
 
 	/* And add it to the vchan */
 	return vchan_tx_prep(&vchan->vc, &contract->vd, flags);
@@ -760,7 +776,7 @@ sun4i_dma_prep_dma_cyclic(struct dma_chan *chan, dma_addr_t buf, size_t len,
 		promise->cfg |= endpoints;
 
 		/* Then add it to the contract */
-		list_add_tail(&promise->list, &contract->demands);
+		sun4i_dma_contract_add(contract, promise);
 	}
 
 	/* And add it to the vchan */
@@ -853,7 +869,7 @@ sun4i_dma_prep_slave_sg(struct dma_chan *chan, struct scatterlist *sgl,
 		promise->para = para;
 
 		/* Then add it to the contract */
-		list_add_tail(&promise->list, &contract->demands);
+		sun4i_dma_contract_add(contract, promise);
 	}
 
 	/*
@@ -961,17 +977,16 @@ static enum dma_status sun4i_dma_tx_status(struct dma_chan *chan,
 		goto exit;
 	contract = to_sun4i_dma_contract(vd);
 
-	list_for_each_entry(promise, &contract->demands, list)
-		bytes += promise->len;
+	bytes = contract->pending_len;
 
 	/*
 	 * The hardware is configured to return the remaining byte
-	 * quantity. If possible, replace the first listed element's
-	 * full size with the actual remaining amount
+	 * quantity. If the first listed element is being processed,
+	 * replace its full size with the actual remaining amount
 	 */
 	promise = list_first_entry_or_null(&contract->demands,
 					   struct sun4i_dma_promise, list);
-	if (promise && pchan) {
+	if (promise && pchan && promise == vchan->processing) {
 		bytes -= promise->len;
 		if (pchan->is_dedicated)
 			bytes += readl(pchan->base + SUN4I_DDMA_BYTE_COUNT_REG);
@@ -1043,6 +1058,7 @@ static irqreturn_t sun4i_dma_interrupt(int irq, void *dev_id)
 			list_del(&vchan->processing->list);
 			list_add_tail(&vchan->processing->list,
 				      &contract->completed_demands);
+			contract->pending_len -= vchan->processing->len;
 
 			/*
 			 * Cyclic DMA transfers are special:
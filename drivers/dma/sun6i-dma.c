@@ -151,6 +151,9 @@ struct sun6i_dma_lli {
 	 * or freeing it).
 	 */
 	struct sun6i_dma_lli	*v_lli_next;
+
+	/* Bytes of the descriptor left after this item, CPU only as well */
+	size_t			remain;
 };
 
 
@@ -158,6 +161,10 @@ struct sun6i_desc {
 	struct virt_dma_desc	vd;
 	dma_addr_t		p_lli;
 	struct sun6i_dma_lli	*v_lli;
+
+	/* Total length, and the item last seen in flight */
+	size_t			len;
+	struct sun6i_dma_lli	*cur;
 };
 
 struct sun6i_pchan {
@@ -166,6 +173,16 @@ struct sun6i_pchan {
 	struct sun6i_vchan	*vchan;
 	struct sun6i_desc	*desc;
 	struct sun6i_desc	*done;
+
+	/*
+	 * Descriptors linked in hardware behind desc, and the last LLI
+	 * the controller will go through.
+	 */
+	struct list_head	chained;
+	struct sun6i_dma_lli	*tail;
+
+	/* Descriptor of the chain last seen in flight */
+	struct sun6i_desc	*cur;
 };
 
 struct sun6i_vchan {
@@ -309,28 +326,104 @@ static void sun6i_set_burst_length_h3(u32 *p_cfg, s8 src_burst, s8 dst_burst)
 		  DMA_CHAN_CFG_DST_BURST_H3(dst_burst);
 }
 
-static size_t sun6i_get_chan_size(struct sun6i_pchan *pchan)
+static struct sun6i_desc *sun6i_chain_next(struct sun6i_pchan *pchan,
+					   struct sun6i_desc *txd)
 {
-	struct sun6i_desc *txd = pchan->desc;
-	struct sun6i_dma_lli *lli;
-	size_t bytes;
+	if (txd == pchan->desc) {
+		if (list_empty(&pchan->chained))
+			return NULL;
+		txd = list_first_entry(&pchan->chained, struct sun6i_desc,
+				       vd.node);
+	} else {
+		if (list_is_last(&txd->vd.node, &pchan->chained))
+			return NULL;
+		txd = list_next_entry(txd, vd.node);
+	}
+
+	return txd;
+}
+
+/*
+ * Find the item of txd being transferred, pos being the address of the
+ * next LLI the controller will load. The search starts from the item
+ * found last time, so polling a running transfer costs a step or two
+ * whatever the length of the list.
+ */
+static struct sun6i_dma_lli *sun6i_desc_find_lli(struct sun6i_desc *txd,
+						 dma_addr_t pos)
+{
+	struct sun6i_dma_lli *lli = txd->cur;
+
+	do {
+		if (lli->p_lli_next == pos) {
+			txd->cur = lli;
+			return lli;
+		}
+		lli = lli->v_lli_next ? lli->v_lli_next : txd->v_lli;
+	} while (lli != txd->cur);
+
+	return NULL;
+}
+
+static size_t sun6i_get_chan_size(struct sun6i_pchan *pchan,
+				  dma_cookie_t cookie)
+{
+	struct sun6i_desc *txd, *cur = NULL;
+	struct sun6i_dma_lli *lli = NULL;
 	dma_addr_t pos;
+	size_t cnt;
+	bool done;
 
 	pos = readl(pchan->base + DMA_CHAN_LLI_ADDR);
-	bytes = readl(pchan->base + DMA_CHAN_CUR_CNT);
+	cnt = readl(pchan->base + DMA_CHAN_CUR_CNT);
+
+	/* Nothing has been loaded yet if pos is still the first item */
+	if (pchan->vchan->cyclic || pos != pchan->desc->p_lli) {
+		for (cur = pchan->cur; cur; cur = sun6i_chain_next(pchan, cur)) {
+			lli = sun6i_desc_find_lli(cur, pos);
+			if (lli) {
+				pchan->cur = cur;
+				break;
+			}
+		}
+	}
+
+	/* Descriptors before the one in flight are done */
+	done = cur != NULL;
+	for (txd = pchan->desc; txd; txd = sun6i_chain_next(pchan, txd)) {
+		if (txd == cur) {
+			if (txd->vd.tx.cookie == cookie)
+				return cnt + lli->remain;
+			done = false;
+		} else if (txd->vd.tx.cookie == cookie) {
+			return done ? 0 : txd->len;
+		}
+	}
+
+	return 0;
+}
+
+/*
+ * Fill in the lengths used for residue reporting, once all the items
+ * of txd are in place.
+ */
+static void sun6i_dma_index_desc(struct sun6i_desc *txd)
+{
+	struct sun6i_dma_lli *lli;
+
+	size_t remain;
 
-	if (pos == LLI_LAST_ITEM)
-		return bytes;
+	txd->len = 0;
+	for (lli = txd->v_lli; lli; lli = lli->v_lli_next)
+		txd->len += lli->len;
 
+	remain = txd->len;
 	for (lli = txd->v_lli; lli; lli = lli->v_lli_next) {
-		if (lli->p_lli_next == pos) {
-			for (lli = lli->v_lli_next; lli; lli = lli->v_lli_next)
-				bytes += lli->len;
-			break;
-		}
+		remain -= lli->len;
+		lli->remain = remain;
 	}
 
-	return bytes;
+	txd->cur = txd->v_lli;
 }
 
 static void *sun6i_dma_lli_add(struct sun6i_dma_lli *prev,
@@ -369,16 +462,12 @@ static inline void sun6i_dma_dump_lli(struct sun6i_vchan *vchan,
 		lli->len, lli->para, lli->p_lli_next);
 }
 
-static void sun6i_dma_free_desc(struct virt_dma_desc *vd)
+static void sun6i_dma_free_lli(struct sun6i_dma_dev *sdev,
+			       struct sun6i_desc *txd)
 {
-	struct sun6i_desc *txd = to_sun6i_desc(&vd->tx);
-	struct sun6i_dma_dev *sdev = to_sun6i_dma_dev(vd->tx.chan->device);
 	struct sun6i_dma_lli *v_lli, *v_next;
 	dma_addr_t p_lli, p_next;
 
-	if (unlikely(!txd))
-		return;
-
 	p_lli = txd->p_lli;
 	v_lli = txd->v_lli;
 
@@ -391,10 +480,86 @@ static void sun6i_dma_free_desc(struct virt_dma_desc *vd)
 		v_lli = v_next;
 		p_lli = p_next;
 	}
+}
 
+static void sun6i_dma_free_desc(struct virt_dma_desc *vd)
+{
+	struct sun6i_desc *txd = to_sun6i_desc(&vd->tx);
+	struct sun6i_dma_dev *sdev = to_sun6i_dma_dev(vd->tx.chan->device);
+
+	if (unlikely(!txd))
+		return;
+
+	sun6i_dma_free_lli(sdev, txd);
 	kfree(txd);
 }
 
+static struct sun6i_dma_lli *sun6i_dma_lli_tail(struct sun6i_desc *txd)
+{
+	struct sun6i_dma_lli *lli = txd->v_lli;
+
+	while (lli->v_lli_next)
+		lli = lli->v_lli_next;
+
+	return lli;
+}
+
+/*
+ * Link the issued descriptors of a vchan behind the tail of its physical
+ * channel, so that the controller goes through them without stopping.
+ * Only the hardware pointer of the tail is patched, the v_lli_next lists
+ * stay per descriptor.
+ *
+ * vc.lock must be held, and the controller must not have loaded the
+ * tail yet.
+ */
+static void sun6i_dma_chain_issued(struct sun6i_vchan *vchan)
+{
+	struct sun6i_pchan *pchan = vchan->phy;
+	struct virt_dma_desc *vd, *tmp;
+	struct sun6i_desc *txd;
+
+	list_for_each_entry_safe(vd, tmp, &vchan->vc.desc_issued, node) {
+		txd = to_sun6i_desc(&vd->tx);
+
+		list_move_tail(&vd->node, &pchan->chained);
+		pchan->tail->p_lli_next = txd->p_lli;
+		pchan->tail = sun6i_dma_lli_tail(txd);
+	}
+
+	/* The links must be in memory before the controller moves on */
+	wmb();
+}
+
+/*
+ * Extend the chain of a running channel with the newly issued
+ * descriptors. vc.lock must be held.
+ */
+static void sun6i_dma_append_issued(struct sun6i_vchan *vchan)
+{
+	struct sun6i_pchan *pchan = vchan->phy;
+	u32 paused;
+
+	if (vchan->cyclic || !pchan || !pchan->desc || pchan->done)
+		return;
+
+	paused = readl(pchan->base + DMA_CHAN_PAUSE) & DMA_CHAN_PAUSE_PAUSE;
+	if (!paused)
+		writel(DMA_CHAN_PAUSE_PAUSE, pchan->base + DMA_CHAN_PAUSE);
+
+	/*
+	 * Once the controller has loaded the tail, the next LLI address
+	 * reads back as LLI_LAST_ITEM and it is too late to extend the
+	 * chain. The descriptors then stay issued, and the tasklet starts
+	 * them after the queue interrupt.
+	 */
+	if (readl(pchan->base + DMA_CHAN_LLI_ADDR) != LLI_LAST_ITEM)
+		sun6i_dma_chain_issued(vchan);
+
+	if (!paused)
+		writel(DMA_CHAN_PAUSE_RESUME, pchan->base + DMA_CHAN_PAUSE);
+}
+
 static int sun6i_dma_start_desc(struct sun6i_vchan *vchan)
 {
 	struct sun6i_dma_dev *sdev = to_sun6i_dma_dev(vchan->vc.chan.device);
@@ -415,6 +580,12 @@ static int sun6i_dma_start_desc(struct sun6i_vchan *vchan)
 
 	pchan->desc = to_sun6i_desc(&desc->tx);
 	pchan->done = NULL;
+	pchan->tail = sun6i_dma_lli_tail(pchan->desc);
+	pchan->cur = pchan->desc;
+
+	/* Go through everything issued so far in one run */
+	if (!vchan->cyclic)
+		sun6i_dma_chain_issued(vchan);
 
 	sun6i_dma_dump_lli(vchan, pchan->desc->v_lli);
 
@@ -506,6 +677,7 @@ static void sun6i_dma_tasklet(unsigned long data)
 static irqreturn_t sun6i_dma_interrupt(int irq, void *dev_id)
 {
 	struct sun6i_dma_dev *sdev = dev_id;
+	struct virt_dma_desc *vd, *tmp;
 	struct sun6i_vchan *vchan;
 	struct sun6i_pchan *pchan;
 	int i, j, ret = IRQ_NONE;
@@ -530,6 +702,12 @@ static irqreturn_t sun6i_dma_interrupt(int irq, void *dev_id)
 				} else {
 					spin_lock(&vchan->vc.lock);
 					vchan_cookie_complete(&pchan->desc->vd);
+					list_for_each_entry_safe(vd, tmp,
+								 &pchan->chained,
+								 node) {
+						list_del(&vd->node);
+						vchan_cookie_complete(vd);
+					}
 					pchan->done = pchan->desc;
 					spin_unlock(&vchan->vc.lock);
 				}
@@ -597,6 +775,22 @@ static int set_config(struct sun6i_dma_dev *sdev,
 	return 0;
 }
 
+static u32 sun6i_dma_memcpy_cfg(struct sun6i_dma_dev *sdev)
+{
+	s8 burst = convert_burst(8);
+	s8 width = convert_buswidth(DMA_SLAVE_BUSWIDTH_4_BYTES);
+	u32 cfg;
+
+	cfg = DMA_CHAN_CFG_SRC_DRQ(DRQ_SDRAM) |
+		DMA_CHAN_CFG_DST_DRQ(DRQ_SDRAM) |
+		DMA_CHAN_CFG_SRC_WIDTH(width) |
+		DMA_CHAN_CFG_DST_WIDTH(width);
+
+	sdev->cfg->set_burst_length(&cfg, burst, burst);
+
+	return cfg;
+}
+
 static struct dma_async_tx_descriptor *sun6i_dma_prep_dma_memcpy(
 		struct dma_chan *chan, dma_addr_t dest, dma_addr_t src,
 		size_t len, unsigned long flags)
@@ -606,7 +800,6 @@ static struct dma_async_tx_descriptor *sun6i_dma_prep_dma_memcpy(
 	struct sun6i_dma_lli *v_lli;
 	struct sun6i_desc *txd;
 	dma_addr_t p_lli;
-	s8 burst, width;
 
 	dev_dbg(chan2dev(chan),
 		"%s; chan: %d, dest: %pad, src: %pad, len: %zu. flags: 0x%08lx\n",
@@ -629,22 +822,16 @@ static struct dma_async_tx_descriptor *sun6i_dma_prep_dma_memcpy(
 	v_lli->dst = dest;
 	v_lli->len = len;
 	v_lli->para = NORMAL_WAIT;
-
-	burst = convert_burst(8);
-	width = convert_buswidth(DMA_SLAVE_BUSWIDTH_4_BYTES);
-	v_lli->cfg = DMA_CHAN_CFG_SRC_DRQ(DRQ_SDRAM) |
-		DMA_CHAN_CFG_DST_DRQ(DRQ_SDRAM) |
+	v_lli->cfg = sun6i_dma_memcpy_cfg(sdev) |
 		DMA_CHAN_CFG_DST_LINEAR_MODE |
-		DMA_CHAN_CFG_SRC_LINEAR_MODE |
-		DMA_CHAN_CFG_SRC_WIDTH(width) |
-		DMA_CHAN_CFG_DST_WIDTH(width);
-
-	sdev->cfg->set_burst_length(&v_lli->cfg, burst, burst);
+		DMA_CHAN_CFG_SRC_LINEAR_MODE;
 
 	sun6i_dma_lli_add(NULL, v_lli, p_lli, txd);
 
 	sun6i_dma_dump_lli(vchan, v_lli);
 
+	sun6i_dma_index_desc(txd);
+
 	return vchan_tx_prep(&vchan->vc, &txd->vd, flags);
 
 err_txd_free:
@@ -652,6 +839,91 @@ static struct dma_async_tx_descriptor *sun6i_dma_prep_dma_memcpy(
 	return NULL;
 }
 
+/*
+ * Memory to memory scatter-gather copy, one LLI per chunk of each frame.
+ * A side that does not increment is set in IO mode.
+ */
+static struct dma_async_tx_descriptor *sun6i_dma_prep_interleaved(
+		struct dma_chan *chan, struct dma_interleaved_template *xt,
+		unsigned long flags)
+{
+	struct sun6i_dma_dev *sdev = to_sun6i_dma_dev(chan->device);
+	struct sun6i_vchan *vchan = to_sun6i_vchan(chan);
+	struct sun6i_dma_lli *v_lli, *prev = NULL;
+	struct data_chunk *chunk;
+	struct sun6i_desc *txd;
+	dma_addr_t p_lli, src, dst;
+	size_t f, c;
+	u32 lli_cfg;
+
+	if (xt->dir != DMA_MEM_TO_MEM || !xt->numf || !xt->frame_size)
+		return NULL;
+
+	dev_dbg(chan2dev(chan),
+		"%s; chan: %d, dest: %pad, src: %pad, frames: %zu x %zu. flags: 0x%08lx\n",
+		__func__, vchan->vc.chan.chan_id, &xt->dst_start,
+		&xt->src_start, xt->numf, xt->frame_size, flags);
+
+	lli_cfg = sun6i_dma_memcpy_cfg(sdev) |
+		(xt->src_inc ? DMA_CHAN_CFG_SRC_LINEAR_MODE :
+			       DMA_CHAN_CFG_SRC_IO_MODE) |
+		(xt->dst_inc ? DMA_CHAN_CFG_DST_LINEAR_MODE :
+			       DMA_CHAN_CFG_DST_IO_MODE);
+
+	txd = kzalloc(sizeof(*txd), GFP_NOWAIT);
+	if (!txd)
+		return NULL;
+
+	src = xt->src_start;
+	dst = xt->dst_start;
+
+	for (f = 0; f < xt->numf; f++) {
+		for (c = 0; c < xt->frame_size; c++) {
+			chunk = &xt->sgl[c];
+			if (!chunk->size)
+				continue;
+
+			v_lli = dma_pool_alloc(sdev->pool, GFP_NOWAIT, &p_lli);
+			if (!v_lli) {
+				dev_err(sdev->slave.dev,
+					"Failed to alloc lli memory\n");
+				goto err_lli_free;
+			}
+
+			v_lli->src = src;
+			v_lli->dst = dst;
+			v_lli->len = chunk->size;
+			v_lli->para = NORMAL_WAIT;
+			v_lli->cfg = lli_cfg;
+
+			if (xt->src_inc)
+				src += chunk->size +
+				       dmaengine_get_src_icg(xt, chunk);
+			if (xt->dst_inc)
+				dst += chunk->size +
+				       dmaengine_get_dst_icg(xt, chunk);
+
+			prev = sun6i_dma_lli_add(prev, v_lli, p_lli, txd);
+		}
+	}
+
+	if (!txd->v_lli)
+		goto err_txd_free;
+
+	for (prev = txd->v_lli; prev; prev = prev->v_lli_next)
+		sun6i_dma_dump_lli(vchan, prev);
+
+	sun6i_dma_index_desc(txd);
+
+	return vchan_tx_prep(&vchan->vc, &txd->vd, flags);
+
+err_lli_free:
+	sun6i_dma_free_lli(sdev, txd);
+err_txd_free:
+	kfree(txd);
+	return NULL;
+}
+
 static struct dma_async_tx_descriptor *sun6i_dma_prep_slave_sg(
 		struct dma_chan *chan, struct scatterlist *sgl,
 		unsigned int sg_len, enum dma_transfer_direction dir,
@@ -726,11 +998,12 @@ static struct dma_async_tx_descriptor *sun6i_dma_prep_slave_sg(
 	for (prev = txd->v_lli; prev; prev = prev->v_lli_next)
 		sun6i_dma_dump_lli(vchan, prev);
 
+	sun6i_dma_index_desc(txd);
+
 	return vchan_tx_prep(&vchan->vc, &txd->vd, flags);
 
 err_lli_free:
-	for (prev = txd->v_lli; prev; prev = prev->v_lli_next)
-		dma_pool_free(sdev->pool, prev, virt_to_phys(prev));
+	sun6i_dma_free_lli(sdev, txd);
 	kfree(txd);
 	return NULL;
 }
@@ -798,11 +1071,12 @@ static struct dma_async_tx_descriptor *sun6i_dma_prep_dma_cyclic(
 
 	vchan->cyclic = true;
 
+	sun6i_dma_index_desc(txd);
+
 	return vchan_tx_prep(&vchan->vc, &txd->vd, flags);
 
 err_lli_free:
-	for (prev = txd->v_lli; prev; prev = prev->v_lli_next)
-		dma_pool_free(sdev->pool, prev, virt_to_phys(prev));
+	sun6i_dma_free_lli(sdev, txd);
 	kfree(txd);
 	return NULL;
 }
@@ -892,10 +1166,14 @@ static int sun6i_dma_terminate_all(struct dma_chan *chan)
 		writel(DMA_CHAN_ENABLE_STOP, pchan->base + DMA_CHAN_ENABLE);
 		writel(DMA_CHAN_PAUSE_RESUME, pchan->base + DMA_CHAN_PAUSE);
 
+		list_splice_tail_init(&pchan->chained, &head);
+
 		vchan->phy = NULL;
 		pchan->vchan = NULL;
 		pchan->desc = NULL;
 		pchan->done = NULL;
+		pchan->tail = NULL;
+		pchan->cur = NULL;
 	}
 
 	spin_unlock_irqrestore(&vchan->vc.lock, flags);
@@ -911,7 +1189,6 @@ static enum dma_status sun6i_dma_tx_status(struct dma_chan *chan,
 {
 	struct sun6i_vchan *vchan = to_sun6i_vchan(chan);
 	struct sun6i_pchan *pchan = vchan->phy;
-	struct sun6i_dma_lli *lli;
 	struct virt_dma_desc *vd;
 	struct sun6i_desc *txd;
 	enum dma_status ret;
@@ -928,12 +1205,11 @@ static enum dma_status sun6i_dma_tx_status(struct dma_chan *chan,
 	txd = to_sun6i_desc(&vd->tx);
 
 	if (vd) {
-		for (lli = txd->v_lli; lli != NULL; lli = lli->v_lli_next)
-			bytes += lli->len;
+		bytes = txd->len;
 	} else if (!pchan || !pchan->desc) {
 		bytes = 0;
 	} else {
-		bytes = sun6i_get_chan_size(pchan);
+		bytes = sun6i_get_chan_size(pchan, cookie);
 	}
 
 	spin_unlock_irqrestore(&vchan->vc.lock, flags);
@@ -962,6 +1238,8 @@ static void sun6i_dma_issue_pending(struct dma_chan *chan)
 		}
 
 		spin_unlock(&sdev->lock);
+
+		sun6i_dma_append_issued(vchan);
 	} else {
 		dev_dbg(chan2dev(chan), "vchan %p: nothing to issue\n",
 			&vchan->vc);
@@ -1229,6 +1507,7 @@ static int sun6i_dma_probe(struct platform_device *pdev)
 	dma_cap_set(DMA_MEMCPY, sdc->slave.cap_mask);
 	dma_cap_set(DMA_SLAVE, sdc->slave.cap_mask);
 	dma_cap_set(DMA_CYCLIC, sdc->slave.cap_mask);
+	dma_cap_set(DMA_INTERLEAVE, sdc->slave.cap_mask);
 
 	INIT_LIST_HEAD(&sdc->slave.channels);
 	sdc->slave.device_free_chan_resources	= sun6i_dma_free_chan_resources;
@@ -1237,6 +1516,7 @@ static int sun6i_dma_probe(struct platform_device *pdev)
 	sdc->slave.device_prep_slave_sg		= sun6i_dma_prep_slave_sg;
 	sdc->slave.device_prep_dma_memcpy	= sun6i_dma_prep_dma_memcpy;
 	sdc->slave.device_prep_dma_cyclic	= sun6i_dma_prep_dma_cyclic;
+	sdc->slave.device_prep_interleaved_dma	= sun6i_dma_prep_interleaved;
 	sdc->slave.copy_align			= DMAENGINE_ALIGN_4_BYTES;
 	sdc->slave.device_config		= sun6i_dma_config;
 	sdc->slave.device_pause			= sun6i_dma_pause;
@@ -1290,6 +1570,7 @@ static int sun6i_dma_probe(struct platform_device *pdev)
 
 		pchan->idx = i;
 		pchan->base = sdc->base + 0x100 + i * 0x40;
+		INIT_LIST_HEAD(&pchan->chained);
 	}
 
 	for (i = 0; i < sdc->num_vchans; i++) {
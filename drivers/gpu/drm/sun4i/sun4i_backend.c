@@ -178,6 +178,16 @@ static int sun4i_backend_drm_format_to_layer(u32 format, u32 *mode)
 	return 0;
 }
 
+static bool sun4i_backend_format_is_supported(uint32_t format)
+{
+	u32 mode;
+
+	if (sun4i_backend_format_is_packed_yuv422(format))
+		return true;
+
+	return !sun4i_backend_drm_format_to_layer(format, &mode);
+}
+
 int sun4i_backend_update_layer_coord(struct sun4i_backend *backend,
 				     int layer, struct drm_plane *plane)
 {
@@ -431,7 +441,7 @@ static bool sun4i_backend_plane_uses_scaler(struct drm_plane_state *state)
 	return false;
 }
 
-static bool sun4i_backend_plane_uses_frontend(struct drm_plane_state *state)
+static bool sun4i_backend_plane_can_use_frontend(struct drm_plane_state *state)
 {
 	struct sun4i_layer *layer = plane_to_sun4i_layer(state->plane);
 	struct sun4i_backend *backend = layer->backend;
@@ -439,6 +449,18 @@ static bool sun4i_backend_plane_uses_frontend(struct drm_plane_state *state)
 	if (IS_ERR(backend->frontend))
 		return false;
 
+	return sun4i_frontend_format_is_supported(state->fb->format->format);
+}
+
+/*
+ * Planes that are scaled, or whose format can only be read by the
+ * frontend, have no other choice than going through it.
+ */
+static bool sun4i_backend_plane_needs_frontend(struct drm_plane_state *state)
+{
+	if (!sun4i_backend_format_is_supported(state->fb->format->format))
+		return true;
+
 	return sun4i_backend_plane_uses_scaler(state);
 }
 
@@ -480,7 +502,17 @@ static int sun4i_backend_atomic_check(struct sunxi_engine *engine,
 		struct drm_framebuffer *fb = plane_state->fb;
 		struct drm_format_name_buf format_name;
 
-		if (sun4i_backend_plane_uses_frontend(plane_state)) {
+		DRM_DEBUG_DRIVER("Plane FB format is %s\n",
+				 drm_get_format_name(fb->format->format,
+						     &format_name));
+
+		if (sun4i_backend_plane_needs_frontend(plane_state)) {
+			if (!sun4i_backend_plane_can_use_frontend(plane_state)) {
+				DRM_DEBUG_DRIVER("Plane %d needs a frontend, rejecting\n",
+						 plane->index);
+				return -EINVAL;
+			}
+
 			DRM_DEBUG_DRIVER("Using the frontend for plane %d\n",
 					 plane->index);
 
@@ -490,13 +522,14 @@ static int sun4i_backend_atomic_check(struct sunxi_engine *engine,
 			layer_state->uses_frontend = false;
 		}
 
-		DRM_DEBUG_DRIVER("Plane FB format is %s\n",
-				 drm_get_format_name(fb->format->format,
-						     &format_name));
 		if (fb->format->has_alpha || (plane_state->alpha != DRM_BLEND_ALPHA_OPAQUE))
 			num_alpha_planes++;
 
-		if (fb->format->is_yuv) {
+		/*
+		 * The frontend converts YUV to RGB, so only the planes
+		 * fetched directly take the backend YUV channel.
+		 */
+		if (fb->format->is_yuv && !layer_state->uses_frontend) {
 			DRM_DEBUG_DRIVER("Plane FB format is YUV\n");
 			num_yuv_planes++;
 		}
@@ -514,6 +547,33 @@ static int sun4i_backend_atomic_check(struct sunxi_engine *engine,
 	if (!num_planes)
 		return 0;
 
+	/*
+	 * The backend can only fetch a single YUV plane by itself. If
+	 * the frontend is still free at this point, offload the extra
+	 * YUV planes to it instead of rejecting the state, starting
+	 * from the topmost one.
+	 */
+	for (i = num_planes; i-- > 0;) {
+		struct drm_plane_state *p_state = plane_states[i];
+		struct sun4i_layer_state *s_state =
+			state_to_sun4i_layer_state(p_state);
+
+		if (num_yuv_planes <= SUN4I_BACKEND_NUM_YUV_PLANES ||
+		    num_frontend_planes >= SUN4I_BACKEND_NUM_FRONTEND_LAYERS)
+			break;
+
+		if (!p_state->fb->format->is_yuv || s_state->uses_frontend ||
+		    !sun4i_backend_plane_can_use_frontend(p_state))
+			continue;
+
+		DRM_DEBUG_DRIVER("Moving YUV plane %d to the frontend\n",
+				 p_state->plane->index);
+
+		s_state->uses_frontend = true;
+		num_frontend_planes++;
+		num_yuv_planes--;
+	}
+
 	/*
 	 * The hardware is a bit unusual here.
 	 *
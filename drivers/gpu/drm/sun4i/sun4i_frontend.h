@@ -22,17 +22,39 @@
 #define SUN4I_FRONTEND_BYPASS_CSC_EN			BIT(1)
 
 #define SUN4I_FRONTEND_BUF_ADDR0_REG		0x020
+#define SUN4I_FRONTEND_BUF_ADDR1_REG		0x024
+#define SUN4I_FRONTEND_BUF_ADDR2_REG		0x028
 
 #define SUN4I_FRONTEND_LINESTRD0_REG		0x040
+#define SUN4I_FRONTEND_LINESTRD1_REG		0x044
+#define SUN4I_FRONTEND_LINESTRD2_REG		0x048
 
 #define SUN4I_FRONTEND_INPUT_FMT_REG		0x04c
 #define SUN4I_FRONTEND_INPUT_FMT_DATA_MOD(mod)		((mod) << 8)
+#define SUN4I_FRONTEND_INPUT_FMT_DATA_MOD_PLANAR		(0 << 8)
+#define SUN4I_FRONTEND_INPUT_FMT_DATA_MOD_PACKED		(1 << 8)
+#define SUN4I_FRONTEND_INPUT_FMT_DATA_MOD_SEMIPLANAR		(2 << 8)
 #define SUN4I_FRONTEND_INPUT_FMT_DATA_FMT(fmt)		((fmt) << 4)
+#define SUN4I_FRONTEND_INPUT_FMT_DATA_FMT_YUV444		(0 << 4)
+#define SUN4I_FRONTEND_INPUT_FMT_DATA_FMT_YUV422		(1 << 4)
+#define SUN4I_FRONTEND_INPUT_FMT_DATA_FMT_YUV420		(2 << 4)
+#define SUN4I_FRONTEND_INPUT_FMT_DATA_FMT_YUV411		(3 << 4)
+#define SUN4I_FRONTEND_INPUT_FMT_DATA_FMT_RGB			(5 << 4)
 #define SUN4I_FRONTEND_INPUT_FMT_PS(ps)			(ps)
+#define SUN4I_FRONTEND_INPUT_FMT_PS_YUYV			0
+#define SUN4I_FRONTEND_INPUT_FMT_PS_UYVY			1
+#define SUN4I_FRONTEND_INPUT_FMT_PS_YVYU			2
+#define SUN4I_FRONTEND_INPUT_FMT_PS_VYUY			3
+#define SUN4I_FRONTEND_INPUT_FMT_PS_UV			0
+#define SUN4I_FRONTEND_INPUT_FMT_PS_VU			1
+#define SUN4I_FRONTEND_INPUT_FMT_PS_BGRX			0
+#define SUN4I_FRONTEND_INPUT_FMT_PS_XRGB			1
 
 #define SUN4I_FRONTEND_OUTPUT_FMT_REG		0x05c
 #define SUN4I_FRONTEND_OUTPUT_FMT_DATA_FMT(fmt)		(fmt)
 
+#define SUN4I_FRONTEND_CSC_COEF_REG(c)		(0x070 + (0x4 * (c)))
+
 #define SUN4I_FRONTEND_CH0_INSIZE_REG		0x100
 #define SUN4I_FRONTEND_INSIZE(h, w)			((((h) - 1) << 16) | (((w) - 1)))
 
@@ -71,10 +93,25 @@ struct drm_plane;
 struct regmap;
 struct reset_control;
 
+/**
+ * struct sun4i_frontend_data - per-SoC frontend quirks
+ * @has_coef_access_ctrl: the scaler coefficients can only be written once
+ *	the CPU has been given access to them through FRM_CTRL
+ * @has_coef_rdy: the scaler coefficients have to be latched by setting
+ *	COEF_RDY in FRM_CTRL once written
+ * @ch_phase: initial phase of the luma (0) and chroma (1) channels
+ */
+struct sun4i_frontend_data {
+	bool	has_coef_access_ctrl;
+	bool	has_coef_rdy;
+	u32	ch_phase[2];
+};
+
 struct sun4i_frontend {
 	struct list_head	list;
 	struct device		*dev;
 	struct device_node	*node;
+	const struct sun4i_frontend_data *data;
 
 	struct clk		*bus_clk;
 	struct clk		*mod_clk;
@@ -95,5 +132,6 @@ void sun4i_frontend_update_coord(struct sun4i_frontend *frontend,
 				 struct drm_plane *plane);
 int sun4i_frontend_update_formats(struct sun4i_frontend *frontend,
 				  struct drm_plane *plane, uint32_t out_fmt);
+bool sun4i_frontend_format_is_supported(uint32_t fmt);
 
 #endif /* _SUN4I_FRONTEND_H_ */
@@ -95,13 +95,18 @@ static void sun4i_backend_layer_atomic_update(struct drm_plane *plane,
 	struct sun4i_frontend *frontend = backend->frontend;
 
 	if (layer_state->uses_frontend) {
+		/*
+		 * Only keep the alpha channel if the input has one, the
+		 * frontend leaves it zeroed for the other formats.
+		 */
+		uint32_t fmt = plane->state->fb->format->has_alpha ?
+			DRM_FORMAT_ARGB8888 : DRM_FORMAT_XRGB8888;
+
 		sun4i_frontend_init(frontend);
 		sun4i_frontend_update_coord(frontend, plane);
 		sun4i_frontend_update_buffer(frontend, plane);
-		sun4i_frontend_update_formats(frontend, plane,
-					      DRM_FORMAT_ARGB8888);
-		sun4i_backend_update_layer_frontend(backend, layer->id,
-						    DRM_FORMAT_ARGB8888);
+		sun4i_frontend_update_formats(frontend, plane, fmt);
+		sun4i_backend_update_layer_frontend(backend, layer->id, fmt);
 		sun4i_frontend_enable(frontend);
 	} else {
 		sun4i_backend_update_layer_formats(backend, layer->id, plane);
@@ -127,10 +132,18 @@ static const struct drm_plane_funcs sun4i_backend_layer_funcs = {
 	.update_plane		= drm_atomic_helper_update_plane,
 };
 
+/*
+ * The planar and semi-planar YUV formats can only be fetched by the
+ * frontend, the backend atomic_check rejects them when it is missing.
+ */
 static const uint32_t sun4i_backend_layer_formats[] = {
 	DRM_FORMAT_ARGB8888,
 	DRM_FORMAT_ARGB4444,
 	DRM_FORMAT_ARGB1555,
+	DRM_FORMAT_NV12,
+	DRM_FORMAT_NV16,
+	DRM_FORMAT_NV21,
+	DRM_FORMAT_NV61,
 	DRM_FORMAT_RGBA5551,
 	DRM_FORMAT_RGBA4444,
 	DRM_FORMAT_RGB888,
@@ -138,7 +151,15 @@ static const uint32_t sun4i_backend_layer_formats[] = {
 	DRM_FORMAT_UYVY,
 	DRM_FORMAT_VYUY,
 	DRM_FORMAT_XRGB8888,
+	DRM_FORMAT_YUV411,
+	DRM_FORMAT_YUV420,
+	DRM_FORMAT_YUV422,
+	DRM_FORMAT_YUV444,
 	DRM_FORMAT_YUYV,
+	DRM_FORMAT_YVU411,
+	DRM_FORMAT_YVU420,
+	DRM_FORMAT_YVU422,
+	DRM_FORMAT_YVU444,
 	DRM_FORMAT_YVYU,
 };
 
@@ -20,6 +20,7 @@
 #include <drm/drm_plane_helper.h>
 
 #include <linux/component.h>
+#include <linux/debugfs.h>
 #include <linux/dma-mapping.h>
 #include <linux/of_device.h>
 #include <linux/of_graph.h>
@@ -359,6 +360,52 @@ static int sun8i_mixer_of_get_id(struct device_node *node)
 	return ret;
 }
 
+/*
+ * Check whether the scaler of the given channel needs the coefficient bank
+ * identified by key to be uploaded. Writing a full bank takes a few hundred
+ * register writes, so it is only done when the bank actually changes.
+ */
+bool sun8i_mixer_scaler_coef_load(struct sun8i_mixer *mixer, int channel,
+				  int key)
+{
+	struct sun8i_scaler_coef *coef;
+
+	if (WARN_ON(channel >= SUN8I_MIXER_MAX_CHANNELS))
+		return true;
+
+	coef = &mixer->coef[channel];
+	if (coef->loaded == key) {
+		coef->skipped++;
+		return false;
+	}
+
+	coef->loaded = key;
+	coef->uploads++;
+
+	return true;
+}
+
+/* Parent of the per-mixer debugfs directories */
+static struct dentry *sun8i_mixer_debugfs_root;
+
+static int sun8i_mixer_scaler_coef_show(struct seq_file *s, void *data)
+{
+	struct sun8i_mixer *mixer = s->private;
+	int i;
+
+	for (i = 0; i < mixer->cfg->vi_num + mixer->cfg->ui_num; i++) {
+		if (!(mixer->cfg->scaler_mask & BIT(i)))
+			continue;
+
+		seq_printf(s, "channel %d: bank %d uploads %u skipped %u\n",
+			   i, mixer->coef[i].loaded, mixer->coef[i].uploads,
+			   mixer->coef[i].skipped);
+	}
+
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(sun8i_mixer_scaler_coef);
+
 static int sun8i_mixer_bind(struct device *dev, struct device *master,
 			      void *data)
 {
@@ -405,6 +452,10 @@ static int sun8i_mixer_bind(struct device *dev, struct device *master,
 	if (!mixer->cfg)
 		return -EINVAL;
 
+	if (WARN_ON(mixer->cfg->vi_num + mixer->cfg->ui_num >
+		    SUN8I_MIXER_MAX_CHANNELS))
+		return -EINVAL;
+
 	res = platform_get_resource(pdev, IORESOURCE_MEM, 0);
 	regs = devm_ioremap_resource(dev, res);
 	if (IS_ERR(regs))
@@ -485,6 +536,15 @@ static int sun8i_mixer_bind(struct device *dev, struct device *master,
 	regmap_update_bits(mixer->engine.regs, SUN8I_MIXER_BLEND_PIPE_CTL,
 			   SUN8I_MIXER_BLEND_PIPE_CTL_EN_MSK, 0);
 
+	/* The scaler coefficients are not covered by the reset above */
+	for (i = 0; i < SUN8I_MIXER_MAX_CHANNELS; i++)
+		mixer->coef[i].loaded = -1;
+
+	mixer->debugfs = debugfs_create_dir(dev_name(dev),
+					    sun8i_mixer_debugfs_root);
+	debugfs_create_file("scaler_coef", 0444, mixer->debugfs, mixer,
+			    &sun8i_mixer_scaler_coef_fops);
+
 	return 0;
 
 err_disable_bus_clk:
@@ -499,6 +559,7 @@ static void sun8i_mixer_unbind(struct device *dev, struct device *master,
 {
 	struct sun8i_mixer *mixer = dev_get_drvdata(dev);
 
+	debugfs_remove_recursive(mixer->debugfs);
 	list_del(&mixer->engine.list);
 
 	clk_disable_unprepare(mixer->mod_clk);
@@ -606,7 +667,27 @@ static struct platform_driver sun8i_mixer_platform_driver = {
 		.of_match_table	= sun8i_mixer_of_table,
 	},
 };
-module_platform_driver(sun8i_mixer_platform_driver);
+
+static int __init sun8i_mixer_init(void)
+{
+	int ret;
+
+	sun8i_mixer_debugfs_root = debugfs_create_dir("sun8i-mixer", NULL);
+
+	ret = platform_driver_register(&sun8i_mixer_platform_driver);
+	if (ret)
+		debugfs_remove_recursive(sun8i_mixer_debugfs_root);
+
+	return ret;
+}
+module_init(sun8i_mixer_init);
+
+static void __exit sun8i_mixer_exit(void)
+{
+	platform_driver_unregister(&sun8i_mixer_platform_driver);
+	debugfs_remove_recursive(sun8i_mixer_debugfs_root);
+}
+module_exit(sun8i_mixer_exit);
 
 MODULE_AUTHOR("Icenowy Zheng <icenowy@aosc.io>");
 MODULE_DESCRIPTION("Allwinner DE2 Mixer driver");
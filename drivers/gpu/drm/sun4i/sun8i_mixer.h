@@ -17,6 +17,8 @@
 #include "sun8i_csc.h"
 #include "sunxi_engine.h"
 
+#define SUN8I_MIXER_MAX_CHANNELS		4
+
 #define SUN8I_MIXER_SIZE(w, h)			(((h) - 1) << 16 | ((w) - 1))
 #define SUN8I_MIXER_COORD(x, y)			((y) << 16 | (x))
 
@@ -136,6 +138,19 @@ struct sun8i_mixer_cfg {
 	unsigned long	mod_rate;
 };
 
+/**
+ * struct sun8i_scaler_coef - scaler coefficient bank state of a channel
+ * @loaded: key of the bank currently in the coefficient registers, or -1
+ *	if their content is unknown
+ * @uploads: number of times a bank was written to the registers
+ * @skipped: number of updates which found the requested bank already loaded
+ */
+struct sun8i_scaler_coef {
+	int		loaded;
+	u32		uploads;
+	u32		skipped;
+};
+
 struct sun8i_mixer {
 	struct sunxi_engine		engine;
 
@@ -145,6 +160,10 @@ struct sun8i_mixer {
 
 	struct clk			*bus_clk;
 	struct clk			*mod_clk;
+
+	struct sun8i_scaler_coef	coef[SUN8I_MIXER_MAX_CHANNELS];
+
+	struct dentry			*debugfs;
 };
 
 static inline struct sun8i_mixer *
@@ -154,4 +173,6 @@ engine_to_sun8i_mixer(struct sunxi_engine *engine)
 }
 
 const struct de2_fmt_info *sun8i_mixer_format_info(u32 format);
+bool sun8i_mixer_scaler_coef_load(struct sun8i_mixer *mixer, int channel,
+				  int key);
 #endif /* _SUN8I_MIXER_H_ */
@@ -136,7 +136,7 @@ void sun8i_ui_scaler_setup(struct sun8i_mixer *mixer, int layer,
 {
 	int vi_cnt = mixer->cfg->vi_num;
 	u32 insize, outsize;
-	int i, offset;
+	int i, index, offset;
 
 	if (WARN_ON(layer < vi_cnt))
 		return;
@@ -163,8 +163,12 @@ void sun8i_ui_scaler_setup(struct sun8i_mixer *mixer, int layer,
 		     SUN8I_SCALER_GSU_HPHASE(vi_cnt, layer), hphase);
 	regmap_write(mixer->engine.regs,
 		     SUN8I_SCALER_GSU_VPHASE(vi_cnt, layer), vphase);
-	offset = sun8i_ui_scaler_coef_index(hscale) *
-			SUN8I_UI_SCALER_COEFF_COUNT;
+
+	index = sun8i_ui_scaler_coef_index(hscale);
+	if (!sun8i_mixer_scaler_coef_load(mixer, vi_cnt + layer, index))
+		return;
+
+	offset = index * SUN8I_UI_SCALER_COEFF_COUNT;
 	for (i = 0; i < SUN8I_UI_SCALER_COEFF_COUNT; i++)
 		regmap_write(mixer->engine.regs,
 			     SUN8I_SCALER_GSU_HCOEFF(vi_cnt, layer, i),
@@ -857,14 +857,24 @@ static int sun8i_vi_scaler_coef_index(unsigned int step)
 	}
 }
 
-static void sun8i_vi_scaler_set_coeff(struct regmap *map, int layer,
+static void sun8i_vi_scaler_set_coeff(struct sun8i_mixer *mixer, int layer,
 				      u32 hstep, u32 vstep,
 				      const struct drm_format_info *format)
 {
+	struct regmap *map = mixer->engine.regs;
 	const u32 *ch_left, *ch_right, *cy;
-	int offset, i;
+	int index, offset, i;
+	bool subsampled;
 
-	if (format->hsub == 1 && format->vsub == 1) {
+	subsampled = format->hsub != 1 || format->vsub != 1;
+	index = sun8i_vi_scaler_coef_index(hstep);
+
+	/* bank key: table index plus which chroma tables are in use */
+	if (!sun8i_mixer_scaler_coef_load(mixer, layer,
+					  index | subsampled << 8))
+		return;
+
+	if (!subsampled) {
 		ch_left = lan3coefftab32_left;
 		ch_right = lan3coefftab32_right;
 		cy = lan2coefftab32;
@@ -874,8 +884,7 @@ static void sun8i_vi_scaler_set_coeff(struct regmap *map, int layer,
 		cy = bicubic4coefftab32;
 	}
 
-	offset = sun8i_vi_scaler_coef_index(hstep) *
-			SUN8I_VI_SCALER_COEFF_COUNT;
+	offset = index * SUN8I_VI_SCALER_COEFF_COUNT;
 	for (i = 0; i < SUN8I_VI_SCALER_COEFF_COUNT; i++) {
 		regmap_write(map, SUN8I_SCALER_VSU_YHCOEFF0(layer, i),
 			     lan3coefftab32_left[offset + i]);
@@ -887,8 +896,6 @@ static void sun8i_vi_scaler_set_coeff(struct regmap *map, int layer,
 			     ch_right[offset + i]);
 	}
 
-	offset = sun8i_vi_scaler_coef_index(hstep) *
-			SUN8I_VI_SCALER_COEFF_COUNT;
 	for (i = 0; i < SUN8I_VI_SCALER_COEFF_COUNT; i++) {
 		regmap_write(map, SUN8I_SCALER_VSU_YVCOEFF(layer, i),
 			     lan2coefftab32[offset + i]);
@@ -966,6 +973,6 @@ void sun8i_vi_scaler_setup(struct sun8i_mixer *mixer, int layer,
 		     SUN8I_SCALER_VSU_CHPHASE(layer), chphase);
 	regmap_write(mixer->engine.regs,
 		     SUN8I_SCALER_VSU_CVPHASE(layer), cvphase);
-	sun8i_vi_scaler_set_coeff(mixer->engine.regs, layer,
+	sun8i_vi_scaler_set_coeff(mixer, layer,
 				  hscale, vscale, format);
 }
@@ -219,6 +219,18 @@
 #define SDXC_IDMAC_DES0_CES	BIT(30) /* card error summary */
 #define SDXC_IDMAC_DES0_OWN	BIT(31) /* 1-idma owns it, 0-host owns it */
 
+/*
+ * Two descriptor rings, so that the next request can be prepared while
+ * the current one is in flight.
+ */
+#define SDXC_IDMA_NR_RINGS	2
+#define SDXC_IDMA_MAX_RING_PAGES	16
+
+/* data->host_cookie values */
+#define SDXC_COOKIE_UNMAPPED	0
+#define SDXC_COOKIE_PRE_MAPPED	1	/* mapped by pre_req */
+#define SDXC_COOKIE_MAPPED	2	/* mapped by request */
+
 #define SDXC_CLK_400K		0
 #define SDXC_CLK_25M		1
 #define SDXC_CLK_50M		2
@@ -236,6 +248,15 @@
 
 #define SDXC_CAL_TIMEOUT	3	/* in seconds, 3s is enough*/
 
+/*
+ * Each descriptor covers one scatterlist segment, so the ring size bounds
+ * the number of segments, and thus the size, of a request. Two pages give
+ * 2 MiB requests even when every segment is a single page.
+ */
+static unsigned int idma_ring_pages = 2;
+module_param(idma_ring_pages, uint, 0444);
+MODULE_PARM_DESC(idma_ring_pages, "pages of IDMA descriptors per ring (1-16)");
+
 struct sunxi_mmc_clk_delay {
 	u32 output;
 	u32 sample;
@@ -289,7 +310,10 @@ struct sunxi_mmc_host {
 	/* dma */
 	dma_addr_t	sg_dma;
 	void		*sg_cpu;
+	size_t		ring_size;
 	bool		wait_dma;
+	/* data described in each descriptor ring, NULL when free */
+	struct mmc_data	*ring_data[SDXC_IDMA_NR_RINGS];
 
 	struct mmc_request *mrq;
 	struct mmc_request *manual_stop_mrq;
@@ -355,11 +379,49 @@ static int sunxi_mmc_init_host(struct sunxi_mmc_host *host)
 	return 0;
 }
 
+/* The ring helpers must be called with host->lock held */
+static int sunxi_mmc_find_ring(struct sunxi_mmc_host *host,
+			       struct mmc_data *data)
+{
+	int i;
+
+	for (i = 0; i < SDXC_IDMA_NR_RINGS; i++)
+		if (host->ring_data[i] == data)
+			return i;
+
+	return -ENOENT;
+}
+
+static int sunxi_mmc_get_ring(struct sunxi_mmc_host *host,
+			      struct mmc_data *data)
+{
+	int ring = sunxi_mmc_find_ring(host, NULL);
+
+	if (ring >= 0)
+		host->ring_data[ring] = data;
+
+	return ring;
+}
+
+static void sunxi_mmc_put_ring(struct sunxi_mmc_host *host,
+			       struct mmc_data *data)
+{
+	int ring = sunxi_mmc_find_ring(host, data);
+
+	if (ring >= 0)
+		host->ring_data[ring] = NULL;
+}
+
+static dma_addr_t sunxi_mmc_ring_dma(struct sunxi_mmc_host *host, int ring)
+{
+	return host->sg_dma + ring * host->ring_size;
+}
+
 static void sunxi_mmc_init_idma_des(struct sunxi_mmc_host *host,
-				    struct mmc_data *data)
+				    struct mmc_data *data, int ring)
 {
-	struct sunxi_idma_des *pdes = (struct sunxi_idma_des *)host->sg_cpu;
-	dma_addr_t next_desc = host->sg_dma;
+	struct sunxi_idma_des *pdes = host->sg_cpu + ring * host->ring_size;
+	dma_addr_t next_desc = sunxi_mmc_ring_dma(host, ring);
 	int i, max_len = (1 << host->cfg->idma_des_size_bits);
 
 	for (i = 0; i < data->sg_len; i++) {
@@ -392,11 +454,15 @@ static void sunxi_mmc_init_idma_des(struct sunxi_mmc_host *host,
 }
 
 static int sunxi_mmc_map_dma(struct sunxi_mmc_host *host,
-			     struct mmc_data *data)
+			     struct mmc_data *data, int cookie)
 {
 	u32 i, dma_len;
 	struct scatterlist *sg;
 
+	/* Already done by pre_req */
+	if (data->host_cookie == SDXC_COOKIE_PRE_MAPPED)
+		return 0;
+
 	dma_len = dma_map_sg(mmc_dev(host->mmc), data->sg, data->sg_len,
 			     mmc_get_dma_dir(data));
 	if (dma_len == 0) {
@@ -409,19 +475,42 @@ static int sunxi_mmc_map_dma(struct sunxi_mmc_host *host,
 			dev_err(mmc_dev(host->mmc),
 				"unaligned scatterlist: os %x length %d\n",
 				sg->offset, sg->length);
+			dma_unmap_sg(mmc_dev(host->mmc), data->sg,
+				     data->sg_len, mmc_get_dma_dir(data));
 			return -EINVAL;
 		}
 	}
 
+	data->host_cookie = cookie;
+
 	return 0;
 }
 
-static void sunxi_mmc_start_dma(struct sunxi_mmc_host *host,
+static void sunxi_mmc_unmap_dma(struct sunxi_mmc_host *host,
 				struct mmc_data *data)
 {
+	dma_unmap_sg(mmc_dev(host->mmc), data->sg, data->sg_len,
+		     mmc_get_dma_dir(data));
+	data->host_cookie = SDXC_COOKIE_UNMAPPED;
+}
+
+/* Must be called with host->lock held */
+static int sunxi_mmc_start_dma(struct sunxi_mmc_host *host,
+			       struct mmc_data *data)
+{
+	int ring;
 	u32 rval;
 
-	sunxi_mmc_init_idma_des(host, data);
+	/* Use the descriptors built by pre_req if there are some */
+	ring = sunxi_mmc_find_ring(host, data);
+	if (ring < 0) {
+		ring = sunxi_mmc_get_ring(host, data);
+		if (ring < 0)
+			return -EBUSY;
+		sunxi_mmc_init_idma_des(host, data, ring);
+	}
+
+	mmc_writel(host, REG_DLBA, sunxi_mmc_ring_dma(host, ring));
 
 	rval = mmc_readl(host, REG_GCTRL);
 	rval |= SDXC_DMA_ENABLE_BIT;
@@ -436,6 +525,8 @@ static void sunxi_mmc_start_dma(struct sunxi_mmc_host *host,
 
 	mmc_writel(host, REG_DMAC,
 		   SDXC_IDMAC_FIX_BURST | SDXC_IDMAC_IDMA_ON);
+
+	return 0;
 }
 
 static void sunxi_mmc_send_manual_stop(struct sunxi_mmc_host *host,
@@ -548,8 +639,11 @@ static irqreturn_t sunxi_mmc_finalize_request(struct sunxi_mmc_host *host)
 		mmc_writel(host, REG_GCTRL, rval);
 		rval |= SDXC_FIFO_RESET;
 		mmc_writel(host, REG_GCTRL, rval);
-		dma_unmap_sg(mmc_dev(host->mmc), data->sg, data->sg_len,
-			     mmc_get_dma_dir(data));
+
+		sunxi_mmc_put_ring(host, data);
+		/* pre_req mappings are undone by post_req */
+		if (data->host_cookie == SDXC_COOKIE_MAPPED)
+			sunxi_mmc_unmap_dma(host, data);
 	}
 
 	mmc_writel(host, REG_RINTR, 0xffff);
@@ -1011,7 +1105,7 @@ static void sunxi_mmc_request(struct mmc_host *mmc, struct mmc_request *mrq)
 	}
 
 	if (data) {
-		ret = sunxi_mmc_map_dma(host, data);
+		ret = sunxi_mmc_map_dma(host, data, SDXC_COOKIE_MAPPED);
 		if (ret < 0) {
 			dev_err(mmc_dev(mmc), "map DMA failed\n");
 			cmd->error = ret;
@@ -1063,9 +1157,8 @@ static void sunxi_mmc_request(struct mmc_host *mmc, struct mmc_request *mrq)
 	if (host->mrq || host->manual_stop_mrq) {
 		spin_unlock_irqrestore(&host->lock, iflags);
 
-		if (data)
-			dma_unmap_sg(mmc_dev(mmc), data->sg, data->sg_len,
-				     mmc_get_dma_dir(data));
+		if (data && data->host_cookie == SDXC_COOKIE_MAPPED)
+			sunxi_mmc_unmap_dma(host, data);
 
 		dev_err(mmc_dev(mmc), "request already pending\n");
 		mrq->cmd->error = -EBUSY;
@@ -1076,7 +1169,20 @@ static void sunxi_mmc_request(struct mmc_host *mmc, struct mmc_request *mrq)
 	if (data) {
 		mmc_writel(host, REG_BLKSZ, data->blksz);
 		mmc_writel(host, REG_BCNTR, data->blksz * data->blocks);
-		sunxi_mmc_start_dma(host, data);
+		ret = sunxi_mmc_start_dma(host, data);
+		if (ret) {
+			/* Both rings are held by prepared requests */
+			spin_unlock_irqrestore(&host->lock, iflags);
+
+			if (data->host_cookie == SDXC_COOKIE_MAPPED)
+				sunxi_mmc_unmap_dma(host, data);
+
+			dev_err(mmc_dev(mmc), "no free descriptor ring\n");
+			cmd->error = ret;
+			data->error = ret;
+			mmc_request_done(mmc, mrq);
+			return;
+		}
 	}
 
 	host->mrq = mrq;
@@ -1088,6 +1194,55 @@ static void sunxi_mmc_request(struct mmc_host *mmc, struct mmc_request *mrq)
 	spin_unlock_irqrestore(&host->lock, iflags);
 }
 
+/*
+ * Map the next request and build its descriptors in the spare ring while
+ * the current one is in flight.
+ */
+static void sunxi_mmc_pre_req(struct mmc_host *mmc, struct mmc_request *mrq)
+{
+	struct sunxi_mmc_host *host = mmc_priv(mmc);
+	struct mmc_data *data = mrq->data;
+	unsigned long iflags;
+	int ring;
+
+	if (!data)
+		return;
+
+	data->host_cookie = SDXC_COOKIE_UNMAPPED;
+
+	if (sunxi_mmc_map_dma(host, data, SDXC_COOKIE_PRE_MAPPED))
+		return;
+
+	spin_lock_irqsave(&host->lock, iflags);
+	ring = sunxi_mmc_get_ring(host, data);
+	spin_unlock_irqrestore(&host->lock, iflags);
+
+	/*
+	 * No spare ring: the descriptors will be built by request, in the
+	 * ring released by the request currently in flight.
+	 */
+	if (ring >= 0)
+		sunxi_mmc_init_idma_des(host, data, ring);
+}
+
+static void sunxi_mmc_post_req(struct mmc_host *mmc, struct mmc_request *mrq,
+			       int err)
+{
+	struct sunxi_mmc_host *host = mmc_priv(mmc);
+	struct mmc_data *data = mrq->data;
+	unsigned long iflags;
+
+	if (!data || data->host_cookie == SDXC_COOKIE_UNMAPPED)
+		return;
+
+	/* The ring is still held if the request was never started */
+	spin_lock_irqsave(&host->lock, iflags);
+	sunxi_mmc_put_ring(host, data);
+	spin_unlock_irqrestore(&host->lock, iflags);
+
+	sunxi_mmc_unmap_dma(host, data);
+}
+
 static int sunxi_mmc_card_busy(struct mmc_host *mmc)
 {
 	struct sunxi_mmc_host *host = mmc_priv(mmc);
@@ -1097,6 +1252,8 @@ static int sunxi_mmc_card_busy(struct mmc_host *mmc)
 
 static const struct mmc_host_ops sunxi_mmc_ops = {
 	.request	 = sunxi_mmc_request,
+	.pre_req	 = sunxi_mmc_pre_req,
+	.post_req	 = sunxi_mmc_post_req,
 	.set_ios	 = sunxi_mmc_set_ios,
 	.get_ro		 = mmc_gpio_get_ro,
 	.get_cd		 = mmc_gpio_get_cd,
@@ -1343,7 +1500,10 @@ static int sunxi_mmc_probe(struct platform_device *pdev)
 	if (ret)
 		goto error_free_host;
 
-	host->sg_cpu = dma_alloc_coherent(&pdev->dev, PAGE_SIZE,
+	host->ring_size = clamp_t(unsigned int, idma_ring_pages, 1,
+				  SDXC_IDMA_MAX_RING_PAGES) * PAGE_SIZE;
+	host->sg_cpu = dma_alloc_coherent(&pdev->dev,
+					  SDXC_IDMA_NR_RINGS * host->ring_size,
 					  &host->sg_dma, GFP_KERNEL);
 	if (!host->sg_cpu) {
 		dev_err(&pdev->dev, "Failed to allocate DMA descriptor mem\n");
@@ -1378,7 +1538,7 @@ static int sunxi_mmc_probe(struct platform_device *pdev)
 	mmc->ops		= &sunxi_mmc_ops;
 	mmc->max_blk_count	= 8192;
 	mmc->max_blk_size	= 4096;
-	mmc->max_segs		= PAGE_SIZE / sizeof(struct sunxi_idma_des);
+	mmc->max_segs		= host->ring_size / sizeof(struct sunxi_idma_des);
 	mmc->max_seg_size	= (1 << host->cfg->idma_des_size_bits);
 	mmc->max_req_size	= mmc->max_seg_size * mmc->max_segs;
 	/* 400kHz ~ 52MHz */
@@ -1414,7 +1574,8 @@ static int sunxi_mmc_probe(struct platform_device *pdev)
 	return 0;
 
 error_free_dma:
-	dma_free_coherent(&pdev->dev, PAGE_SIZE, host->sg_cpu, host->sg_dma);
+	dma_free_coherent(&pdev->dev, SDXC_IDMA_NR_RINGS * host->ring_size,
+			  host->sg_cpu, host->sg_dma);
 error_free_host:
 	mmc_free_host(mmc);
 	return ret;
@@ -1429,7 +1590,8 @@ static int sunxi_mmc_remove(struct platform_device *pdev)
 	pm_runtime_force_suspend(&pdev->dev);
 	disable_irq(host->irq);
 	sunxi_mmc_disable(host);
-	dma_free_coherent(&pdev->dev, PAGE_SIZE, host->sg_cpu, host->sg_dma);
+	dma_free_coherent(&pdev->dev, SDXC_IDMA_NR_RINGS * host->ring_size,
+			  host->sg_cpu, host->sg_dma);
 	mmc_free_host(mmc);
 
 	return 0;
@@ -193,6 +193,10 @@ struct sunxi_nand_hw_ecc {
  * @clk_rate:		clk_rate required for this NAND chip
  * @timing_cfg		TIMING_CFG register value for this NAND chip
  * @selected:		current active CS
+ * @cache_page:		page being loaded in the page register during a
+ *			sequential cache read, -1 when not in cache read mode
+ * @last_page:		last page read on the selected CS, used to detect
+ *			sequential reads
  * @nsels:		number of CS lines required by the NAND chip
  * @sels:		array of CS lines descriptions
  */
@@ -203,6 +207,8 @@ struct sunxi_nand_chip {
 	u32 timing_cfg;
 	u32 timing_ctl;
 	int selected;
+	int cache_page;
+	int last_page;
 	int addr_cycles;
 	u32 addr[2];
 	int cmd_cycles;
@@ -420,6 +426,86 @@ static int sunxi_nfc_dev_ready(struct mtd_info *mtd)
 	return !!(readl(nfc->regs + NFC_REG_ST) & mask);
 }
 
+static int sunxi_nfc_cache_read_cmd(struct mtd_info *mtd, u8 cmd)
+{
+	struct nand_chip *nand = mtd_to_nand(mtd);
+	struct sunxi_nfc *nfc = to_sunxi_nfc(nand->controller);
+	int ret;
+
+	ret = sunxi_nfc_wait_cmd_fifo_empty(nfc);
+	if (ret)
+		return ret;
+
+	writel(NFC_SEND_CMD1 | cmd, nfc->regs + NFC_REG_CMD);
+
+	ret = sunxi_nfc_wait_events(nfc, NFC_CMD_INT_FLAG, true, 0);
+	if (ret)
+		return ret;
+
+	/* Wait tWB before checking the R/B line */
+	ndelay(100);
+	nand_wait_ready(mtd);
+
+	return 0;
+}
+
+/*
+ * Leave the sequential cache read mode, so that the array is idle and
+ * any command can be issued. The page register content moves to the
+ * cache register, where nobody will read it.
+ */
+static void sunxi_nfc_cache_read_end(struct mtd_info *mtd)
+{
+	struct sunxi_nand_chip *sunxi_nand = to_sunxi_nand(mtd_to_nand(mtd));
+
+	if (sunxi_nand->cache_page < 0)
+		return;
+
+	sunxi_nand->cache_page = -1;
+	sunxi_nfc_cache_read_cmd(mtd, NAND_CMD_READCACHEEND);
+}
+
+/*
+ * Load a page in the cache register before reading it out.
+ *
+ * Once two consecutive pages have been read, READ CACHE SEQUENTIAL is
+ * used so that the NAND loads page + 1 in its array while page is
+ * transferred and corrected. The next read of page + 1 then only has to
+ * wait for the cache register swap instead of a full tR. The chain stops
+ * at the end of the block, and any other command first leaves the cache
+ * mode through sunxi_nfc_cache_read_end().
+ */
+static void sunxi_nfc_read_page_op(struct mtd_info *mtd, int page)
+{
+	struct nand_chip *nand = mtd_to_nand(mtd);
+	struct sunxi_nand_chip *sunxi_nand = to_sunxi_nand(nand);
+	int ppb = 1 << (nand->phys_erase_shift - nand->page_shift);
+	bool more = (page + 1) % ppb;
+
+	if (sunxi_nand->cache_page == page) {
+		sunxi_nand->cache_page = more ? page + 1 : -1;
+		if (!sunxi_nfc_cache_read_cmd(mtd, more ?
+					      NAND_CMD_READCACHESEQ :
+					      NAND_CMD_READCACHEEND))
+			goto out;
+
+		sunxi_nand->cache_page = -1;
+	}
+
+	nand_read_page_op(nand, page, 0, NULL, 0);
+
+	if (more && sunxi_nand->last_page == page - 1 &&
+	    nand->parameters.supports_read_cache && nand->dev_ready) {
+		if (!sunxi_nfc_cache_read_cmd(mtd, NAND_CMD_READCACHESEQ))
+			sunxi_nand->cache_page = page + 1;
+		else
+			nand_read_page_op(nand, page, 0, NULL, 0);
+	}
+
+out:
+	sunxi_nand->last_page = page;
+}
+
 static void sunxi_nfc_select_chip(struct mtd_info *mtd, int chip)
 {
 	struct nand_chip *nand = mtd_to_nand(mtd);
@@ -434,6 +520,9 @@ static void sunxi_nfc_select_chip(struct mtd_info *mtd, int chip)
 	if (chip == sunxi_nand->selected)
 		return;
 
+	sunxi_nfc_cache_read_end(mtd);
+	sunxi_nand->last_page = -1;
+
 	ctl = readl(nfc->regs + NFC_REG_CTL) &
 	      ~(NFC_PAGE_SHIFT_MSK | NFC_CE_SEL_MSK | NFC_RB_SEL_MSK | NFC_EN);
 
@@ -598,6 +687,10 @@ static void sunxi_nfc_cmd_ctrl(struct mtd_info *mtd, int dat,
 	}
 
 	if (ctrl & NAND_CLE) {
+		/* Only column changes are allowed in cache read mode */
+		if (dat != NAND_CMD_RNDOUT && dat != NAND_CMD_RNDOUTSTART)
+			sunxi_nfc_cache_read_end(mtd);
+
 		sunxi_nand->cmd[sunxi_nand->cmd_cycles++] = dat;
 	} else if (ctrl & NAND_ALE) {
 		sunxi_nand->addr[sunxi_nand->addr_cycles / 4] |=
@@ -1198,7 +1291,7 @@ static int sunxi_nfc_hw_ecc_read_page(struct mtd_info *mtd,
 	int ret, i, cur_off = 0;
 	bool raw_mode = false;
 
-	nand_read_page_op(chip, page, 0, NULL, 0);
+	sunxi_nfc_read_page_op(mtd, page);
 
 	sunxi_nfc_hw_ecc_enable(mtd);
 
@@ -1233,7 +1326,7 @@ static int sunxi_nfc_hw_ecc_read_page_dma(struct mtd_info *mtd,
 {
 	int ret;
 
-	nand_read_page_op(chip, page, 0, NULL, 0);
+	sunxi_nfc_read_page_op(mtd, page);
 
 	ret = sunxi_nfc_hw_ecc_read_chunks_dma(mtd, buf, oob_required, page,
 					       chip->ecc.steps);
@@ -1253,7 +1346,7 @@ static int sunxi_nfc_hw_ecc_read_subpage(struct mtd_info *mtd,
 	int ret, i, cur_off = 0;
 	unsigned int max_bitflips = 0;
 
-	nand_read_page_op(chip, page, 0, NULL, 0);
+	sunxi_nfc_read_page_op(mtd, page);
 
 	sunxi_nfc_hw_ecc_enable(mtd);
 
@@ -1286,7 +1379,7 @@ static int sunxi_nfc_hw_ecc_read_subpage_dma(struct mtd_info *mtd,
 	int nchunks = DIV_ROUND_UP(data_offs + readlen, chip->ecc.size);
 	int ret;
 
-	nand_read_page_op(chip, page, 0, NULL, 0);
+	sunxi_nfc_read_page_op(mtd, page);
 
 	ret = sunxi_nfc_hw_ecc_read_chunks_dma(mtd, buf, false, page, nchunks);
 	if (ret >= 0)
@@ -1888,6 +1981,8 @@ static int sunxi_nand_chip_init(struct device *dev, struct sunxi_nfc *nfc,
 
 	chip->nsels = nsels;
 	chip->selected = -1;
+	chip->cache_page = -1;
+	chip->last_page = -1;
 
 	for (i = 0; i < nsels; i++) {
 		ret = of_property_read_u32_index(np, "reg", i, &tmp);
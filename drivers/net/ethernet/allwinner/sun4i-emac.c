@@ -13,6 +13,7 @@
  */
 
 #include <linux/clk.h>
+#include <linux/dmaengine.h>
 #include <linux/etherdevice.h>
 #include <linux/ethtool.h>
 #include <linux/gpio.h>
@@ -37,6 +38,9 @@
 
 #define EMAC_MAX_FRAME_LEN	0x0600
 
+/* Frames at least this long are moved out of the RX FIFO by DMA */
+#define EMAC_DMA_MIN_LEN	0x0200
+
 #define EMAC_DEFAULT_MSG_ENABLE 0x0000
 static int debug = -1;     /* defaults above */;
 module_param(debug, int, 0);
@@ -47,6 +51,11 @@ static int watchdog = 5000;
 module_param(watchdog, int, 0400);
 MODULE_PARM_DESC(watchdog, "transmit timeout in milliseconds");
 
+/* Maximum number of frames received per NAPI poll */
+static int rx_budget = NAPI_POLL_WEIGHT;
+module_param(rx_budget, int, 0400);
+MODULE_PARM_DESC(rx_budget, "frames received per poll before re-enabling the RX interrupt (1-64)");
+
 /* EMAC register address locking.
  *
  * The EMAC uses an address register to control where data written
@@ -77,11 +86,19 @@ struct emac_board_info {
 	void __iomem		*membase;
 	u32			msg_enable;
 	struct net_device	*ndev;
-	struct sk_buff		*skb_last;
+	struct napi_struct	napi;
 	u16			tx_fifo_stat;
+	unsigned int		tx_len[2];
 
 	int			emacrx_completed_flag;
 
+	/* RX DMA, at most one frame in flight */
+	struct dma_chan		*rx_chan;
+	phys_addr_t		emac_rx_fifo;
+	struct sk_buff		*rx_dma_skb;
+	dma_addr_t		rx_dma_buf;
+	unsigned int		rx_dma_len;
+
 	struct device_node	*phy_node;
 	unsigned int		link;
 	unsigned int		speed;
@@ -401,7 +418,8 @@ static void emac_init_device(struct net_device *dev)
 
 	/* enable RX/TX0/RX Hlevel interrup */
 	reg_val = readl(db->membase + EMAC_INT_CTL_REG);
-	reg_val |= (0xf << 0) | (0x01 << 8);
+	reg_val |= EMAC_INT_CTL_TX_EN | EMAC_INT_CTL_TX_ABRT_EN |
+		   EMAC_INT_CTL_RX_EN;
 	writel(reg_val, db->membase + EMAC_INT_CTL_REG);
 
 	spin_unlock_irqrestore(&db->lock, flags);
@@ -422,6 +440,9 @@ static void emac_timeout(struct net_device *dev)
 	netif_stop_queue(dev);
 	emac_reset(db);
 	emac_init_device(dev);
+	/* Both TX channels are lost with the reset */
+	db->tx_fifo_stat = 0;
+	netdev_reset_queue(dev);
 	/* We can accept TX packets again */
 	netif_trans_update(dev);
 	netif_wake_queue(dev);
@@ -453,6 +474,9 @@ static int emac_start_xmit(struct sk_buff *skb, struct net_device *dev)
 			skb->data, skb->len);
 	dev->stats.tx_bytes += skb->len;
 
+	db->tx_len[channel] = skb->len;
+	netdev_sent_queue(dev, skb->len);
+
 	db->tx_fifo_stat |= 1 << channel;
 	/* TX control: First packet immediately send, second packet queue */
 	if (channel == 0) {
@@ -494,12 +518,19 @@ static int emac_start_xmit(struct sk_buff *skb, struct net_device *dev)
 static void emac_tx_done(struct net_device *dev, struct emac_board_info *db,
 			  unsigned int tx_status)
 {
+	unsigned int pkts_compl = 0, bytes_compl = 0;
+	int channel;
+
 	/* One packet sent complete */
+	for (channel = 0; channel < 2; channel++) {
+		if (!(tx_status & db->tx_fifo_stat & (1 << channel)))
+			continue;
+		pkts_compl++;
+		bytes_compl += db->tx_len[channel];
+	}
 	db->tx_fifo_stat &= ~(tx_status & 3);
-	if (3 == (tx_status & 3))
-		dev->stats.tx_packets += 2;
-	else
-		dev->stats.tx_packets++;
+	dev->stats.tx_packets += pkts_compl;
+	netdev_completed_queue(dev, pkts_compl, bytes_compl);
 
 	if (netif_msg_tx_done(db))
 		dev_dbg(db->dev, "tx done, NSR %02x\n", tx_status);
@@ -507,55 +538,111 @@ static void emac_tx_done(struct net_device *dev, struct emac_board_info *db,
 	netif_wake_queue(dev);
 }
 
+/* Must be called with db->lock held */
+static void emac_rx_dma_disable(struct emac_board_info *db)
+{
+	unsigned int reg_val;
+
+	reg_val = readl(db->membase + EMAC_RX_CTL_REG);
+	reg_val &= ~EMAC_RX_CTL_DMA_EN;
+	writel(reg_val, db->membase + EMAC_RX_CTL_REG);
+}
+
+static void emac_dma_done_callback(void *arg)
+{
+	struct emac_board_info *db = arg;
+	struct net_device *dev = db->ndev;
+	struct sk_buff *skb = db->rx_dma_skb;
+	unsigned long flags;
+
+	dma_unmap_single(db->dev, db->rx_dma_buf, db->rx_dma_len,
+			 DMA_FROM_DEVICE);
+
+	spin_lock_irqsave(&db->lock, flags);
+	emac_rx_dma_disable(db);
+	db->rx_dma_skb = NULL;
+	spin_unlock_irqrestore(&db->lock, flags);
+
+	dev->stats.rx_bytes += skb->len + 4;
+
+	/* Pass to upper layer */
+	skb->protocol = eth_type_trans(skb, dev);
+	netif_rx(skb);
+	dev->stats.rx_packets++;
+
+	/* Go on with the frames received meanwhile */
+	napi_schedule(&db->napi);
+}
+
+/* Start moving a frame out of the RX FIFO by DMA, with db->lock held.
+ * The frame is given to the stack by emac_dma_done_callback().
+ */
+static int emac_dma_inblk_32bit(struct emac_board_info *db,
+				struct sk_buff *skb, void *rdptr,
+				unsigned int count)
+{
+	struct dma_async_tx_descriptor *desc;
+	unsigned int reg_val;
+	dma_addr_t rxbuf;
+
+	count = round_up(count, 4);
+	rxbuf = dma_map_single(db->dev, rdptr, count, DMA_FROM_DEVICE);
+	if (dma_mapping_error(db->dev, rxbuf))
+		return -ENOMEM;
+
+	desc = dmaengine_prep_slave_single(db->rx_chan, rxbuf, count,
+					   DMA_DEV_TO_MEM,
+					   DMA_PREP_INTERRUPT | DMA_CTRL_ACK);
+	if (!desc) {
+		dma_unmap_single(db->dev, rxbuf, count, DMA_FROM_DEVICE);
+		return -EIO;
+	}
+
+	db->rx_dma_skb = skb;
+	db->rx_dma_buf = rxbuf;
+	db->rx_dma_len = count;
+	desc->callback = emac_dma_done_callback;
+	desc->callback_param = db;
+
+	reg_val = readl(db->membase + EMAC_RX_CTL_REG);
+	reg_val |= EMAC_RX_CTL_DMA_EN;
+	writel(reg_val, db->membase + EMAC_RX_CTL_REG);
+
+	dmaengine_submit(desc);
+	dma_async_issue_pending(db->rx_chan);
+
+	return 0;
+}
+
 /* Received a packet and pass to upper layer
+ * Returns the number of frames handled, at most budget.
  */
-static void emac_rx(struct net_device *dev)
+static int emac_rx(struct net_device *dev, int budget)
 {
 	struct emac_board_info *db = netdev_priv(dev);
 	struct sk_buff *skb;
 	u8 *rdptr;
 	bool good_packet;
-	static int rxlen_last;
+	unsigned long flags;
 	unsigned int reg_val;
 	u32 rxhdr, rxstatus, rxcount, rxlen;
+	int received = 0;
 
 	/* Check packet ready or not */
-	while (1) {
-		/* race warning: the first packet might arrive with
-		 * the interrupts disabled, but the second will fix
-		 * it
-		 */
+	while (received < budget && !db->rx_dma_skb) {
+		skb = NULL;
+
+		/* holders of db->lock must always block IRQs */
+		spin_lock_irqsave(&db->lock, flags);
+
 		rxcount = readl(db->membase + EMAC_RX_FBC_REG);
 
 		if (netif_msg_rx_status(db))
 			dev_dbg(db->dev, "RXCount: %x\n", rxcount);
 
-		if ((db->skb_last != NULL) && (rxlen_last > 0)) {
-			dev->stats.rx_bytes += rxlen_last;
-
-			/* Pass to upper layer */
-			db->skb_last->protocol = eth_type_trans(db->skb_last,
-								dev);
-			netif_rx(db->skb_last);
-			dev->stats.rx_packets++;
-			db->skb_last = NULL;
-			rxlen_last = 0;
-
-			reg_val = readl(db->membase + EMAC_RX_CTL_REG);
-			reg_val &= ~EMAC_RX_CTL_DMA_EN;
-			writel(reg_val, db->membase + EMAC_RX_CTL_REG);
-		}
-
 		if (!rxcount) {
-			db->emacrx_completed_flag = 1;
-			reg_val = readl(db->membase + EMAC_INT_CTL_REG);
-			reg_val |= (0xf << 0) | (0x01 << 8);
-			writel(reg_val, db->membase + EMAC_INT_CTL_REG);
-
-			/* had one stuck? */
-			rxcount = readl(db->membase + EMAC_RX_FBC_REG);
-			if (!rxcount)
-				return;
+			spin_unlock_irqrestore(&db->lock, flags);
+			break;
 		}
 
 		reg_val = readl(db->membase + EMAC_RX_IO_DATA_REG);
@@ -580,13 +667,9 @@ static void emac_rx(struct net_device *dev)
 			reg_val = readl(db->membase + EMAC_CTL_REG);
 			writel(reg_val | EMAC_CTL_RX_EN,
 			       db->membase + EMAC_CTL_REG);
-			reg_val = readl(db->membase + EMAC_INT_CTL_REG);
-			reg_val |= (0xf << 0) | (0x01 << 8);
-			writel(reg_val, db->membase + EMAC_INT_CTL_REG);
 
-			db->emacrx_completed_flag = 1;
-
-			return;
+			spin_unlock_irqrestore(&db->lock, flags);
+			break;
 		}
 
 		/* A packet ready now  & Get status/length */
@@ -630,8 +713,12 @@ static void emac_rx(struct net_device *dev)
 		/* Move data from EMAC */
 		if (good_packet) {
 			skb = netdev_alloc_skb(dev, rxlen + 4);
-			if (!skb)
+			if (!skb) {
+				dev->stats.rx_dropped++;
+				spin_unlock_irqrestore(&db->lock, flags);
+				received++;
 				continue;
+			}
 			skb_reserve(skb, 2);
 			rdptr = skb_put(skb, rxlen - 4);
 
@@ -639,16 +726,70 @@ static void emac_rx(struct net_device *dev)
 			if (netif_msg_rx_status(db))
 				dev_dbg(db->dev, "RxLen %x\n", rxlen);
 
+			if (db->rx_chan && rxlen >= EMAC_DMA_MIN_LEN &&
+			    !emac_dma_inblk_32bit(db, skb, rdptr, rxlen)) {
+				/* the DMA now owns the FIFO until it is done */
+				spin_unlock_irqrestore(&db->lock, flags);
+				received++;
+				break;
+			}
+
 			emac_inblk_32bit(db->membase + EMAC_RX_IO_DATA_REG,
 					rdptr, rxlen);
 			dev->stats.rx_bytes += rxlen;
+		}
 
+		spin_unlock_irqrestore(&db->lock, flags);
+
+		if (skb) {
 			/* Pass to upper layer */
 			skb->protocol = eth_type_trans(skb, dev);
-			netif_rx(skb);
+			napi_gro_receive(&db->napi, skb);
 			dev->stats.rx_packets++;
 		}
+		received++;
 	}
+
+	return received;
+}
+
+static int emac_poll(struct napi_struct *napi, int budget)
+{
+	struct emac_board_info *db = container_of(napi,
+						  struct emac_board_info,
+						  napi);
+	unsigned long flags;
+	unsigned int reg_val;
+	int work_done;
+
+	work_done = emac_rx(db->ndev, budget);
+	if (work_done >= budget)
+		return work_done;
+
+	if (!napi_complete_done(napi, work_done))
+		return work_done;
+
+	/* A DMA transfer is in flight, its callback will reschedule us */
+	if (db->rx_dma_skb)
+		return work_done;
+
+	spin_lock_irqsave(&db->lock, flags);
+	db->emacrx_completed_flag = 1;
+	reg_val = readl(db->membase + EMAC_INT_CTL_REG);
+	writel(reg_val | EMAC_INT_CTL_RX_EN, db->membase + EMAC_INT_CTL_REG);
+
+	/* race warning: a packet might have arrived before the interrupt
+	 * was enabled, poll again if so
+	 */
+	if (readl(db->membase + EMAC_RX_FBC_REG) && napi_schedule_prep(napi)) {
+		db->emacrx_completed_flag = 0;
+		writel(reg_val & ~EMAC_INT_CTL_RX_EN,
+		       db->membase + EMAC_INT_CTL_REG);
+		__napi_schedule(napi);
+	}
+	spin_unlock_irqrestore(&db->lock, flags);
+
+	return work_done;
 }
 
 static irqreturn_t emac_interrupt(int irq, void *dev_id)
@@ -676,26 +817,28 @@ static irqreturn_t emac_interrupt(int irq, void *dev_id)
 	if (netif_msg_intr(db))
 		dev_dbg(db->dev, "emac interrupt %02x\n", int_status);
 
-	/* Received the coming packet */
-	if ((int_status & 0x100) && (db->emacrx_completed_flag == 1)) {
-		/* carrier lost */
+	/* Received the coming packet, the RX interrupt stays masked
+	 * until the poll is done
+	 */
+	if ((int_status & EMAC_INT_STA_RX_COMPLETE) &&
+	    (db->emacrx_completed_flag == 1)) {
 		db->emacrx_completed_flag = 0;
-		emac_rx(dev);
+		napi_schedule(&db->napi);
 	}
 
 	/* Transmit Interrupt check */
-	if (int_status & (0x01 | 0x02))
+	if (int_status & EMAC_INT_STA_TX_COMPLETE)
 		emac_tx_done(dev, db, int_status);
 
-	if (int_status & (0x04 | 0x08))
+	if (int_status & EMAC_INT_STA_TX_ABRT)
 		netdev_info(dev, " ab : %x\n", int_status);
 
 	/* Re-enable interrupt mask */
-	if (db->emacrx_completed_flag == 1) {
-		reg_val = readl(db->membase + EMAC_INT_CTL_REG);
-		reg_val |= (0xf << 0) | (0x01 << 8);
-		writel(reg_val, db->membase + EMAC_INT_CTL_REG);
-	}
+	reg_val = readl(db->membase + EMAC_INT_CTL_REG);
+	reg_val |= EMAC_INT_CTL_TX_EN | EMAC_INT_CTL_TX_ABRT_EN;
+	if (db->emacrx_completed_flag == 1)
+		reg_val |= EMAC_INT_CTL_RX_EN;
+	writel(reg_val, db->membase + EMAC_INT_CTL_REG);
 	spin_unlock_irqrestore(&db->lock, flags);
 
 	return IRQ_HANDLED;
@@ -729,10 +872,15 @@ static int emac_open(struct net_device *dev)
 
 	/* Initialize EMAC board */
 	emac_reset(db);
+	db->tx_fifo_stat = 0;
+	db->emacrx_completed_flag = 1;
+	netdev_reset_queue(dev);
+	napi_enable(&db->napi);
 	emac_init_device(dev);
 
 	ret = emac_mdio_probe(dev);
 	if (ret < 0) {
+		napi_disable(&db->napi);
 		free_irq(dev->irq, dev);
 		netdev_err(dev, "cannot probe MDIO bus\n");
 		return ret;
@@ -783,6 +931,18 @@ static int emac_stop(struct net_device *ndev)
 
 	free_irq(ndev->irq, ndev);
 
+	napi_disable(&db->napi);
+
+	if (db->rx_chan) {
+		dmaengine_terminate_sync(db->rx_chan);
+		if (db->rx_dma_skb) {
+			dma_unmap_single(db->dev, db->rx_dma_buf,
+					 db->rx_dma_len, DMA_FROM_DEVICE);
+			dev_kfree_skb(db->rx_dma_skb);
+			db->rx_dma_skb = NULL;
+		}
+	}
+
 	return 0;
 }
 
@@ -828,11 +988,44 @@ static int emac_probe(struct platform_device *pdev)
 
 	spin_lock_init(&db->lock);
 
+	db->rx_chan = dma_request_chan(&pdev->dev, "rx");
+	if (IS_ERR(db->rx_chan)) {
+		ret = PTR_ERR(db->rx_chan);
+		db->rx_chan = NULL;
+		if (ret == -EPROBE_DEFER)
+			goto out;
+		dev_info(&pdev->dev, "no RX DMA channel, using PIO only\n");
+		ret = 0;
+	}
+
 	db->membase = of_iomap(np, 0);
 	if (!db->membase) {
 		dev_err(&pdev->dev, "failed to remap registers\n");
 		ret = -ENOMEM;
-		goto out;
+		goto out_dma;
+	}
+
+	if (db->rx_chan) {
+		struct dma_slave_config conf = {};
+		struct resource *regs;
+
+		regs = platform_get_resource(pdev, IORESOURCE_MEM, 0);
+		db->emac_rx_fifo = regs->start + EMAC_RX_IO_DATA_REG;
+
+		conf.direction = DMA_DEV_TO_MEM;
+		conf.src_addr = db->emac_rx_fifo;
+		conf.src_addr_width = DMA_SLAVE_BUSWIDTH_4_BYTES;
+		conf.dst_addr_width = DMA_SLAVE_BUSWIDTH_4_BYTES;
+		conf.src_maxburst = 4;
+		conf.dst_maxburst = 4;
+
+		ret = dmaengine_slave_config(db->rx_chan, &conf);
+		if (ret) {
+			dev_warn(&pdev->dev, "cannot configure RX DMA, using PIO only\n");
+			dma_release_channel(db->rx_chan);
+			db->rx_chan = NULL;
+			ret = 0;
+		}
 	}
 
 	/* fill in parameters for net-dev structure */
@@ -888,6 +1081,8 @@ static int emac_probe(struct platform_device *pdev)
 	ndev->netdev_ops = &emac_netdev_ops;
 	ndev->watchdog_timeo = msecs_to_jiffies(watchdog);
 	ndev->ethtool_ops = &emac_ethtool_ops;
+	netif_napi_add(ndev, &db->napi, emac_poll,
+		       clamp(rx_budget, 1, NAPI_POLL_WEIGHT));
 
 	platform_set_drvdata(pdev, ndev);
 
@@ -898,7 +1093,7 @@ static int emac_probe(struct platform_device *pdev)
 	if (ret) {
 		dev_err(&pdev->dev, "Registering netdev failed!\n");
 		ret = -ENODEV;
-		goto out_release_sram;
+		goto out_napi_del;
 	}
 
 	dev_info(&pdev->dev, "%s: at %p, IRQ %d MAC: %pM\n",
@@ -906,12 +1101,17 @@ static int emac_probe(struct platform_device *pdev)
 
 	return 0;
 
+out_napi_del:
+	netif_napi_del(&db->napi);
 out_release_sram:
 	sunxi_sram_release(&pdev->dev);
 out_clk_disable_unprepare:
 	clk_disable_unprepare(db->clk);
 out_iounmap:
 	iounmap(db->membase);
+out_dma:
+	if (db->rx_chan)
+		dma_release_channel(db->rx_chan);
 out:
 	dev_err(db->dev, "not found (%d).\n", ret);
 
@@ -926,6 +1126,9 @@ static int emac_remove(struct platform_device *pdev)
 	struct emac_board_info *db = netdev_priv(ndev);
 
 	unregister_netdev(ndev);
+	netif_napi_del(&db->napi);
+	if (db->rx_chan)
+		dma_release_channel(db->rx_chan);
 	sunxi_sram_release(&pdev->dev);
 	clk_disable_unprepare(db->clk);
 	iounmap(db->membase);
@@ -23,12 +23,15 @@
 #define DRV_MODULE_VERSION	"Jan_2016"
 
 #include <linux/clk.h>
+#include <linux/hrtimer.h>
+#include <linux/net_dim.h>
 #include <linux/stmmac.h>
 #include <linux/phy.h>
 #include <linux/pci.h>
 #include "common.h"
 #include <linux/ptp_clock_kernel.h>
 #include <linux/reset.h>
+#include <net/xdp.h>
 
 struct stmmac_resources {
 	void __iomem *addr;
@@ -38,12 +41,24 @@ struct stmmac_resources {
 	int irq;
 };
 
+/* What a TX ring entry holds, so the completion path knows how to
+ * release it.
+ */
+enum stmmac_txbuf_type {
+	STMMAC_TXBUF_T_SKB,
+	STMMAC_TXBUF_T_XDP_TX,
+	STMMAC_TXBUF_T_XDP_NDO,
+	STMMAC_TXBUF_T_XSK_TX,
+};
+
 struct stmmac_tx_info {
 	dma_addr_t buf;
 	bool map_as_page;
 	unsigned len;
 	bool last_segment;
 	bool is_jumbo;
+	enum stmmac_txbuf_type buf_type;
+	struct xdp_frame *xdpf;
 };
 
 /* Frequently used values are kept adjacent for cache effect */
@@ -59,20 +74,53 @@ struct stmmac_tx_queue {
 	dma_addr_t dma_tx_phy;
 	u32 tx_tail_addr;
 	u32 mss;
+	struct xdp_umem *xsk_umem;
+	/* TX mitigation: IC bit every coal_frames, else the timer */
+	u32 tx_count_frames;
+	u32 coal_frames;
+	u32 coal_timer;
+	struct hrtimer txtimer;
+	/* Adaptive coalescing */
+	struct net_dim dim;
+	u16 dim_events;
+	u64 dim_packets;
+	u64 dim_bytes;
 };
 
+/* An RX page is carved into buffers of priv->rx_truesize bytes; the slot
+ * moves on to the next one whenever the current buffer leaves with the page.
+ */
+struct stmmac_rx_buffer {
+	struct page *page;
+	dma_addr_t addr;
+	unsigned int page_offset;
+	unsigned int pagecnt_bias;
+};
+
+/* Pages still referenced by the stack when they leave the RX ring */
+#define STMMAC_RX_RECYCLE_SIZE	(DMA_RX_SIZE / 4)
+
 struct stmmac_rx_queue {
 	u32 queue_index;
 	struct stmmac_priv *priv_data;
 	struct dma_extended_desc *dma_erx;
 	struct dma_desc *dma_rx ____cacheline_aligned_in_smp;
-	struct sk_buff **rx_skbuff;
-	dma_addr_t *rx_skbuff_dma;
+	struct stmmac_rx_buffer *buf_pool;
+	struct stmmac_rx_buffer *recycle;
+	unsigned int recycle_head;
+	unsigned int recycle_count;
 	unsigned int cur_rx;
 	unsigned int dirty_rx;
 	u32 rx_zeroc_thresh;
 	dma_addr_t dma_rx_phy;
 	u32 rx_tail_addr;
+	struct xdp_rxq_info xdp_rxq;
+	/* Adaptive coalescing */
+	u32 coal_usecs;
+	struct net_dim dim;
+	u16 dim_events;
+	u64 dim_packets;
+	u64 dim_bytes;
 	struct napi_struct napi ____cacheline_aligned_in_smp;
 };
 
@@ -109,18 +157,21 @@ struct stmmac_pps_cfg {
 
 struct stmmac_priv {
 	/* Frequently used values are kept adjacent for cache effect */
-	u32 tx_count_frames;
 	u32 tx_coal_frames;
 	u32 tx_coal_timer;
+	bool tx_dim_enabled;
+	bool rx_dim_enabled;
 
 	int tx_coalesce;
 	int hwts_tx_en;
 	bool tx_path_in_lpi_mode;
-	struct timer_list txtimer;
 	bool tso;
 
 	unsigned int dma_buf_sz;
+	unsigned int rx_page_order;
+	unsigned int rx_truesize;
 	unsigned int rx_copybreak;
+	struct bpf_prog *xdp_prog;
 	u32 rx_riwt;
 	int hwts_rx_en;
 
@@ -206,6 +257,9 @@ int stmmac_mdio_unregister(struct net_device *ndev);
 int stmmac_mdio_register(struct net_device *ndev);
 int stmmac_mdio_reset(struct mii_bus *mii);
 void stmmac_set_ethtool_ops(struct net_device *netdev);
+u32 stmmac_usec2riwt(u32 usec, struct stmmac_priv *priv);
+void stmmac_set_coalesce_mode(struct stmmac_priv *priv, bool adaptive_rx,
+			      bool adaptive_tx);
 
 void stmmac_ptp_register(struct stmmac_priv *priv);
 void stmmac_ptp_unregister(struct stmmac_priv *priv);
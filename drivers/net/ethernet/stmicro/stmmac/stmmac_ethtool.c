@@ -97,6 +97,10 @@ static const struct stmmac_stats stmmac_gstrings_stats[] = {
 	STMMAC_STAT(tx_clean),
 	STMMAC_STAT(tx_set_ic_bit),
 	STMMAC_STAT(irq_receive_pmt_irq_n),
+	/* RX page recycling */
+	STMMAC_STAT(rx_page_reuse),
+	STMMAC_STAT(rx_page_recycle_hit),
+	STMMAC_STAT(rx_page_recycle_miss),
 	/* MMC info */
 	STMMAC_STAT(mmc_tx_irq_n),
 	STMMAC_STAT(mmc_rx_irq_n),
@@ -713,7 +717,7 @@ static int stmmac_ethtool_op_set_eee(struct net_device *dev,
 	return phy_ethtool_set_eee(dev->phydev, edata);
 }
 
-static u32 stmmac_usec2riwt(u32 usec, struct stmmac_priv *priv)
+u32 stmmac_usec2riwt(u32 usec, struct stmmac_priv *priv)
 {
 	unsigned long clk = clk_get_rate(priv->plat->stmmac_clk);
 
@@ -744,6 +748,9 @@ static int stmmac_get_coalesce(struct net_device *dev,
 	if (priv->use_riwt)
 		ec->rx_coalesce_usecs = stmmac_riwt2usec(priv->rx_riwt, priv);
 
+	ec->use_adaptive_rx_coalesce = priv->rx_dim_enabled;
+	ec->use_adaptive_tx_coalesce = priv->tx_dim_enabled;
+
 	return 0;
 }
 
@@ -757,7 +764,6 @@ static int stmmac_set_coalesce(struct net_device *dev,
 	/* Check not supported parameters  */
 	if ((ec->rx_max_coalesced_frames) || (ec->rx_coalesce_usecs_irq) ||
 	    (ec->rx_max_coalesced_frames_irq) || (ec->tx_coalesce_usecs_irq) ||
-	    (ec->use_adaptive_rx_coalesce) || (ec->use_adaptive_tx_coalesce) ||
 	    (ec->pkt_rate_low) || (ec->rx_coalesce_usecs_low) ||
 	    (ec->rx_max_coalesced_frames_low) || (ec->tx_coalesce_usecs_high) ||
 	    (ec->tx_max_coalesced_frames_low) || (ec->pkt_rate_high) ||
@@ -786,11 +792,22 @@ static int stmmac_set_coalesce(struct net_device *dev,
 	else if (!priv->use_riwt)
 		return -EOPNOTSUPP;
 
-	/* Only copy relevant parameters, ignore all others. */
+	/* Only copy relevant parameters, ignore all others. The static
+	 * values are kept while adaptive coalescing is on, and are used
+	 * again once it is turned off.
+	 */
 	priv->tx_coal_frames = ec->tx_max_coalesced_frames;
 	priv->tx_coal_timer = ec->tx_coalesce_usecs;
 	priv->rx_riwt = rx_riwt;
-	stmmac_rx_watchdog(priv, priv->ioaddr, priv->rx_riwt, rx_cnt);
+
+	if (netif_running(dev)) {
+		stmmac_set_coalesce_mode(priv, ec->use_adaptive_rx_coalesce,
+					 ec->use_adaptive_tx_coalesce);
+	} else {
+		stmmac_rx_watchdog(priv, priv->ioaddr, priv->rx_riwt, rx_cnt);
+		priv->rx_dim_enabled = ec->use_adaptive_rx_coalesce;
+		priv->tx_dim_enabled = ec->use_adaptive_tx_coalesce;
+	}
 
 	return 0;
 }
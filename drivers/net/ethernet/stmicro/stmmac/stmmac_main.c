@@ -40,12 +40,15 @@
 #include <linux/slab.h>
 #include <linux/prefetch.h>
 #include <linux/pinctrl/consumer.h>
+#include <linux/bpf.h>
+#include <linux/bpf_trace.h>
 #ifdef CONFIG_DEBUG_FS
 #include <linux/debugfs.h>
 #include <linux/seq_file.h>
 #endif /* CONFIG_DEBUG_FS */
 #include <linux/net_tstamp.h>
 #include <net/pkt_cls.h>
+#include <net/xdp_sock.h>
 #include "stmmac_ptp.h"
 #include "stmmac.h"
 #include <linux/reset.h>
@@ -94,6 +97,17 @@ MODULE_PARM_DESC(buf_sz, "DMA buffer size");
 
 #define	STMMAC_RX_COPYBREAK	256
 
+/* Every RX buffer reserves room in front of the frame so that an XDP
+ * program can push headers and the frame can be turned into an skb or an
+ * xdp_frame in place.
+ */
+#define STMMAC_RX_HEADROOM	XDP_PACKET_HEADROOM
+
+#define STMMAC_XDP_PASS		0
+#define STMMAC_XDP_CONSUMED	BIT(0)
+#define STMMAC_XDP_TX		BIT(1)
+#define STMMAC_XDP_REDIRECT	BIT(2)
+
 static const u32 default_msg_level = (NETIF_MSG_DRV | NETIF_MSG_PROBE |
 				      NETIF_MSG_LINK | NETIF_MSG_IFUP |
 				      NETIF_MSG_IFDOWN | NETIF_MSG_TIMER);
@@ -118,7 +132,7 @@ static int stmmac_init_fs(struct net_device *dev);
 static void stmmac_exit_fs(struct net_device *dev);
 #endif
 
-#define STMMAC_COAL_TIMER(x) (jiffies + usecs_to_jiffies(x))
+#define STMMAC_COAL_TIMER(x) (ns_to_ktime((x) * NSEC_PER_USEC))
 
 /**
  * stmmac_verify_args - verify the driver parameters.
@@ -1157,6 +1171,59 @@ static void stmmac_clear_descriptors(struct stmmac_priv *priv)
 		stmmac_clear_tx_descriptors(priv, queue);
 }
 
+static inline unsigned int stmmac_rx_map_size(struct stmmac_priv *priv)
+{
+	return PAGE_SIZE << priv->rx_page_order;
+}
+
+/**
+ * stmmac_alloc_rx_page - allocate and map one RX page
+ * @priv: driver private structure
+ * @buf: RX buffer to fill
+ * @flags: gfp flag
+ * Description: the driver takes a large bias of references on the page and
+ * gives one of them away with each buffer passed up the stack, so that
+ * page_ref_count() tells whether any of its buffers are still in use.
+ */
+static int stmmac_alloc_rx_page(struct stmmac_priv *priv,
+				struct stmmac_rx_buffer *buf, gfp_t flags)
+{
+	struct page *page;
+	dma_addr_t addr;
+
+	page = __dev_alloc_pages(flags, priv->rx_page_order);
+	if (!page)
+		return -ENOMEM;
+
+	addr = dma_map_page(priv->device, page, 0, stmmac_rx_map_size(priv),
+			    DMA_FROM_DEVICE);
+	if (dma_mapping_error(priv->device, addr)) {
+		__free_pages(page, priv->rx_page_order);
+		return -EINVAL;
+	}
+
+	page_ref_add(page, USHRT_MAX - 1);
+
+	buf->page = page;
+	buf->addr = addr;
+	buf->page_offset = 0;
+	buf->pagecnt_bias = USHRT_MAX;
+
+	return 0;
+}
+
+/* Unmap a page and drop the references the driver still holds on it. The
+ * frames have already been synced for the CPU, so skip the sync here.
+ */
+static void stmmac_release_rx_page(struct stmmac_priv *priv,
+				   struct stmmac_rx_buffer *buf)
+{
+	dma_unmap_page_attrs(priv->device, buf->addr, stmmac_rx_map_size(priv),
+			     DMA_FROM_DEVICE, DMA_ATTR_SKIP_CPU_SYNC);
+	__page_frag_cache_drain(buf->page, buf->pagecnt_bias);
+	buf->page = NULL;
+}
+
 /**
  * stmmac_init_rx_buffers - init the RX descriptor buffer.
  * @priv: driver private structure
@@ -1171,25 +1238,17 @@ static int stmmac_init_rx_buffers(struct stmmac_priv *priv, struct dma_desc *p,
 				  int i, gfp_t flags, u32 queue)
 {
 	struct stmmac_rx_queue *rx_q = &priv->rx_queue[queue];
-	struct sk_buff *skb;
+	struct stmmac_rx_buffer *buf = &rx_q->buf_pool[i];
+	int ret;
 
-	skb = __netdev_alloc_skb_ip_align(priv->dev, priv->dma_buf_sz, flags);
-	if (!skb) {
-		netdev_err(priv->dev,
-			   "%s: Rx init fails; skb is NULL\n", __func__);
-		return -ENOMEM;
-	}
-	rx_q->rx_skbuff[i] = skb;
-	rx_q->rx_skbuff_dma[i] = dma_map_single(priv->device, skb->data,
-						priv->dma_buf_sz,
-						DMA_FROM_DEVICE);
-	if (dma_mapping_error(priv->device, rx_q->rx_skbuff_dma[i])) {
-		netdev_err(priv->dev, "%s: DMA mapping error\n", __func__);
-		dev_kfree_skb_any(skb);
-		return -EINVAL;
+	ret = stmmac_alloc_rx_page(priv, buf, flags);
+	if (ret) {
+		netdev_err(priv->dev, "%s: Rx init fails (%d)\n", __func__, ret);
+		return ret;
 	}
 
-	stmmac_set_desc_addr(priv, p, rx_q->rx_skbuff_dma[i]);
+	stmmac_set_desc_addr(priv, p, buf->addr + buf->page_offset +
+			     STMMAC_RX_HEADROOM);
 
 	if (priv->dma_buf_sz == BUF_SIZE_16KiB)
 		stmmac_init_desc3(priv, p);
@@ -1206,13 +1265,10 @@ static int stmmac_init_rx_buffers(struct stmmac_priv *priv, struct dma_desc *p,
 static void stmmac_free_rx_buffer(struct stmmac_priv *priv, u32 queue, int i)
 {
 	struct stmmac_rx_queue *rx_q = &priv->rx_queue[queue];
+	struct stmmac_rx_buffer *buf = &rx_q->buf_pool[i];
 
-	if (rx_q->rx_skbuff[i]) {
-		dma_unmap_single(priv->device, rx_q->rx_skbuff_dma[i],
-				 priv->dma_buf_sz, DMA_FROM_DEVICE);
-		dev_kfree_skb_any(rx_q->rx_skbuff[i]);
-	}
-	rx_q->rx_skbuff[i] = NULL;
+	if (buf->page)
+		stmmac_release_rx_page(priv, buf);
 }
 
 /**
@@ -1238,12 +1294,21 @@ static void stmmac_free_tx_buffer(struct stmmac_priv *priv, u32 queue, int i)
 					 DMA_TO_DEVICE);
 	}
 
+	if (tx_q->tx_skbuff_dma[i].xdpf) {
+		xdp_return_frame(tx_q->tx_skbuff_dma[i].xdpf);
+		tx_q->tx_skbuff_dma[i].xdpf = NULL;
+		tx_q->tx_skbuff_dma[i].buf = 0;
+		tx_q->tx_skbuff_dma[i].map_as_page = false;
+	}
+
 	if (tx_q->tx_skbuff[i]) {
 		dev_kfree_skb_any(tx_q->tx_skbuff[i]);
 		tx_q->tx_skbuff[i] = NULL;
 		tx_q->tx_skbuff_dma[i].buf = 0;
 		tx_q->tx_skbuff_dma[i].map_as_page = false;
 	}
+
+	tx_q->tx_skbuff_dma[i].buf_type = STMMAC_TXBUF_T_SKB;
 }
 
 /**
@@ -1271,10 +1336,16 @@ static int init_dma_rx_desc_rings(struct net_device *dev, gfp_t flags)
 		bfsize = stmmac_set_bfsize(dev->mtu, priv->dma_buf_sz);
 
 	priv->dma_buf_sz = bfsize;
+	/* Make room for at least two buffers per page, so that a page can
+	 * go on receiving while a frame it holds is still up the stack.
+	 */
+	priv->rx_truesize = SKB_DATA_ALIGN(STMMAC_RX_HEADROOM + bfsize) +
+			    SKB_DATA_ALIGN(sizeof(struct skb_shared_info));
+	priv->rx_page_order = get_order(2 * priv->rx_truesize);
 
 	/* RX INITIALIZATION */
 	netif_dbg(priv, probe, priv->dev,
-		  "SKB addresses:\nskb\t\tskb data\tdma data\n");
+		  "RX buffer addresses:\npage\t\tdma data\n");
 
 	for (queue = 0; queue < rx_count; queue++) {
 		struct stmmac_rx_queue *rx_q = &priv->rx_queue[queue];
@@ -1296,9 +1367,9 @@ static int init_dma_rx_desc_rings(struct net_device *dev, gfp_t flags)
 			if (ret)
 				goto err_init_rx_buffers;
 
-			netif_dbg(priv, probe, priv->dev, "[%p]\t[%p]\t[%x]\n",
-				  rx_q->rx_skbuff[i], rx_q->rx_skbuff[i]->data,
-				  (unsigned int)rx_q->rx_skbuff_dma[i]);
+			netif_dbg(priv, probe, priv->dev, "[%p]\t[%x]\n",
+				  rx_q->buf_pool[i].page,
+				  (unsigned int)rx_q->buf_pool[i].addr);
 		}
 
 		rx_q->cur_rx = 0;
@@ -1380,6 +1451,8 @@ static int init_dma_tx_desc_rings(struct net_device *dev)
 			tx_q->tx_skbuff_dma[i].map_as_page = false;
 			tx_q->tx_skbuff_dma[i].len = 0;
 			tx_q->tx_skbuff_dma[i].last_segment = false;
+			tx_q->tx_skbuff_dma[i].buf_type = STMMAC_TXBUF_T_SKB;
+			tx_q->tx_skbuff_dma[i].xdpf = NULL;
 			tx_q->tx_skbuff[i] = NULL;
 		}
 
@@ -1427,10 +1500,18 @@ static int init_dma_desc_rings(struct net_device *dev, gfp_t flags)
  */
 static void dma_free_rx_skbufs(struct stmmac_priv *priv, u32 queue)
 {
+	struct stmmac_rx_queue *rx_q = &priv->rx_queue[queue];
 	int i;
 
 	for (i = 0; i < DMA_RX_SIZE; i++)
 		stmmac_free_rx_buffer(priv, queue, i);
+
+	while (rx_q->recycle_count) {
+		stmmac_release_rx_page(priv, &rx_q->recycle[rx_q->recycle_head]);
+		rx_q->recycle_head = STMMAC_GET_ENTRY(rx_q->recycle_head,
+						      STMMAC_RX_RECYCLE_SIZE);
+		rx_q->recycle_count--;
+	}
 }
 
 /**
@@ -1440,10 +1521,19 @@ static void dma_free_rx_skbufs(struct stmmac_priv *priv, u32 queue)
  */
 static void dma_free_tx_skbufs(struct stmmac_priv *priv, u32 queue)
 {
+	struct stmmac_tx_queue *tx_q = &priv->tx_queue[queue];
+	u32 xsk_frames = 0;
 	int i;
 
-	for (i = 0; i < DMA_TX_SIZE; i++)
+	for (i = 0; i < DMA_TX_SIZE; i++) {
+		if (tx_q->tx_skbuff_dma[i].buf_type == STMMAC_TXBUF_T_XSK_TX)
+			xsk_frames++;
 		stmmac_free_tx_buffer(priv, queue, i);
+	}
+
+	/* Hand the dropped zero-copy frames back to user space */
+	if (tx_q->xsk_umem && xsk_frames)
+		xsk_umem_complete_tx(tx_q->xsk_umem, xsk_frames);
 }
 
 /**
@@ -1472,8 +1562,11 @@ static void free_dma_rx_desc_resources(struct stmmac_priv *priv)
 					  sizeof(struct dma_extended_desc),
 					  rx_q->dma_erx, rx_q->dma_rx_phy);
 
-		kfree(rx_q->rx_skbuff_dma);
-		kfree(rx_q->rx_skbuff);
+		if (xdp_rxq_info_is_reg(&rx_q->xdp_rxq))
+			xdp_rxq_info_unreg(&rx_q->xdp_rxq);
+
+		kfree(rx_q->recycle);
+		kfree(rx_q->buf_pool);
 	}
 }
 
@@ -1529,18 +1622,26 @@ static int alloc_dma_rx_desc_resources(struct stmmac_priv *priv)
 		rx_q->queue_index = queue;
 		rx_q->priv_data = priv;
 
-		rx_q->rx_skbuff_dma = kmalloc_array(DMA_RX_SIZE,
-						    sizeof(dma_addr_t),
-						    GFP_KERNEL);
-		if (!rx_q->rx_skbuff_dma)
+		rx_q->buf_pool = kcalloc(DMA_RX_SIZE, sizeof(*rx_q->buf_pool),
+					 GFP_KERNEL);
+		if (!rx_q->buf_pool)
 			goto err_dma;
 
-		rx_q->rx_skbuff = kmalloc_array(DMA_RX_SIZE,
-						sizeof(struct sk_buff *),
-						GFP_KERNEL);
-		if (!rx_q->rx_skbuff)
+		rx_q->recycle = kcalloc(STMMAC_RX_RECYCLE_SIZE,
+					sizeof(*rx_q->recycle), GFP_KERNEL);
+		if (!rx_q->recycle)
+			goto err_dma;
+
+		ret = xdp_rxq_info_reg(&rx_q->xdp_rxq, priv->dev, queue);
+		if (ret)
 			goto err_dma;
 
+		ret = xdp_rxq_info_reg_mem_model(&rx_q->xdp_rxq,
+						 MEM_TYPE_PAGE_SHARED, NULL);
+		if (ret)
+			goto err_dma;
+		ret = -ENOMEM;
+
 		if (priv->extend_desc) {
 			rx_q->dma_erx = dma_zalloc_coherent(priv->device,
 							    DMA_RX_SIZE *
@@ -1847,6 +1948,7 @@ static void stmmac_tx_clean(struct stmmac_priv *priv, u32 queue)
 {
 	struct stmmac_tx_queue *tx_q = &priv->tx_queue[queue];
 	unsigned int bytes_compl = 0, pkts_compl = 0;
+	unsigned int xsk_frames = 0;
 	unsigned int entry;
 
 	netif_tx_lock(priv->dev);
@@ -1908,6 +2010,15 @@ static void stmmac_tx_clean(struct stmmac_priv *priv, u32 queue)
 		tx_q->tx_skbuff_dma[entry].last_segment = false;
 		tx_q->tx_skbuff_dma[entry].is_jumbo = false;
 
+		if (tx_q->tx_skbuff_dma[entry].xdpf) {
+			xdp_return_frame(tx_q->tx_skbuff_dma[entry].xdpf);
+			tx_q->tx_skbuff_dma[entry].xdpf = NULL;
+		} else if (tx_q->tx_skbuff_dma[entry].buf_type ==
+			   STMMAC_TXBUF_T_XSK_TX) {
+			xsk_frames++;
+		}
+		tx_q->tx_skbuff_dma[entry].buf_type = STMMAC_TXBUF_T_SKB;
+
 		if (likely(skb != NULL)) {
 			pkts_compl++;
 			bytes_compl += skb->len;
@@ -1921,9 +2032,23 @@ static void stmmac_tx_clean(struct stmmac_priv *priv, u32 queue)
 	}
 	tx_q->dirty_tx = entry;
 
+	if (xsk_frames)
+		xsk_umem_complete_tx(tx_q->xsk_umem, xsk_frames);
+
 	netdev_tx_completed_queue(netdev_get_tx_queue(priv->dev, queue),
 				  pkts_compl, bytes_compl);
 
+	if (priv->tx_dim_enabled && pkts_compl) {
+		struct net_dim_sample dim_sample;
+
+		tx_q->dim_events++;
+		tx_q->dim_packets += pkts_compl;
+		tx_q->dim_bytes += bytes_compl;
+		net_dim_sample(tx_q->dim_events, tx_q->dim_packets,
+			       tx_q->dim_bytes, &dim_sample);
+		net_dim(&tx_q->dim, dim_sample);
+	}
+
 	if (unlikely(netif_tx_queue_stopped(netdev_get_tx_queue(priv->dev,
 								queue))) &&
 	    stmmac_tx_avail(priv, queue) > STMMAC_TX_THRESH) {
@@ -2233,38 +2358,234 @@ static int stmmac_init_dma_engine(struct stmmac_priv *priv)
 	return ret;
 }
 
+/* TX rings are serviced from every RX NAPI context: use the one of the
+ * same channel if there is one.
+ */
+static struct napi_struct *stmmac_tx_napi(struct stmmac_priv *priv, u32 queue)
+{
+	if (queue >= priv->plat->rx_queues_to_use)
+		queue = 0;
+
+	return &priv->rx_queue[queue].napi;
+}
+
 /**
  * stmmac_tx_timer - mitigation sw timer for tx.
- * @data: data pointer
+ * @t: hrtimer of the TX queue
  * Description:
- * This is the timer handler to directly invoke the stmmac_tx_clean.
+ * This is the timer handler to schedule the NAPI context that cleans the
+ * TX queue; stmmac_tx_clean() cannot run from hard interrupt context.
  */
-static void stmmac_tx_timer(struct timer_list *t)
+static enum hrtimer_restart stmmac_tx_timer(struct hrtimer *t)
 {
-	struct stmmac_priv *priv = from_timer(priv, t, txtimer);
-	u32 tx_queues_count = priv->plat->tx_queues_to_use;
+	struct stmmac_tx_queue *tx_q =
+		container_of(t, struct stmmac_tx_queue, txtimer);
+
+	napi_schedule(stmmac_tx_napi(tx_q->priv_data, tx_q->queue_index));
+
+	return HRTIMER_NORESTART;
+}
+
+static void stmmac_tx_timer_arm(struct stmmac_priv *priv, u32 queue)
+{
+	struct stmmac_tx_queue *tx_q = &priv->tx_queue[queue];
+
+	hrtimer_start(&tx_q->txtimer, STMMAC_COAL_TIMER(tx_q->coal_timer),
+		      HRTIMER_MODE_REL);
+}
+
+/* The RI watchdog is shared by all the RX channels on most cores, so it
+ * follows the queue that currently asks for the most moderation.
+ */
+static void stmmac_dim_update_riwt(struct stmmac_priv *priv)
+{
+	u32 rx_cnt = priv->plat->rx_queues_to_use;
+	u32 usecs = 0;
 	u32 queue;
+	u32 riwt;
 
-	/* let's scan all the tx queues */
-	for (queue = 0; queue < tx_queues_count; queue++)
-		stmmac_tx_clean(priv, queue);
+	for (queue = 0; queue < rx_cnt; queue++)
+		usecs = max(usecs, priv->rx_queue[queue].coal_usecs);
+
+	riwt = clamp_t(u32, stmmac_usec2riwt(usecs, priv), MIN_DMA_RIWT,
+		       MAX_DMA_RIWT);
+	stmmac_rx_watchdog(priv, priv->ioaddr, riwt, rx_cnt);
+}
+
+static void stmmac_rx_dim_work(struct work_struct *work)
+{
+	struct net_dim *dim = container_of(work, struct net_dim, work);
+	struct stmmac_rx_queue *rx_q =
+		container_of(dim, struct stmmac_rx_queue, dim);
+	struct net_dim_cq_moder moder =
+		net_dim_get_rx_moderation(dim->mode, dim->profile_ix);
+
+	rx_q->coal_usecs = moder.usec;
+	stmmac_dim_update_riwt(rx_q->priv_data);
+
+	dim->state = NET_DIM_START_MEASURE;
+}
+
+static void stmmac_tx_dim_work(struct work_struct *work)
+{
+	struct net_dim *dim = container_of(work, struct net_dim, work);
+	struct stmmac_tx_queue *tx_q =
+		container_of(dim, struct stmmac_tx_queue, dim);
+	struct net_dim_cq_moder moder =
+		net_dim_get_tx_moderation(dim->mode, dim->profile_ix);
+
+	WRITE_ONCE(tx_q->coal_frames, moder.pkts);
+	WRITE_ONCE(tx_q->coal_timer, moder.usec);
+
+	dim->state = NET_DIM_START_MEASURE;
+}
+
+static void stmmac_dim_reset(struct net_dim *dim)
+{
+	memset(&dim->prev_stats, 0, sizeof(dim->prev_stats));
+	dim->state = NET_DIM_START_MEASURE;
+	dim->tune_state = NET_DIM_GOING_RIGHT;
+	dim->profile_ix = NET_DIM_DEF_PROFILE_CQE;
+	dim->steps_right = 0;
+	dim->steps_left = 0;
+	dim->tired = 0;
+}
+
+/* Adaptive queues start from the default moderation profile; the others
+ * go back to the values set through ethtool. Nothing may sample the rates
+ * meanwhile: either the NAPI contexts are not running yet or they are
+ * disabled by stmmac_set_coalesce_mode().
+ */
+static void __stmmac_set_coalesce_mode(struct stmmac_priv *priv,
+				       bool adaptive_rx, bool adaptive_tx)
+{
+	u32 rx_cnt = priv->plat->rx_queues_to_use;
+	u32 tx_cnt = priv->plat->tx_queues_to_use;
+	struct net_dim_cq_moder moder;
+	u32 queue;
+
+	/* Stop the tuning before touching the values it owns */
+	priv->rx_dim_enabled = false;
+	priv->tx_dim_enabled = false;
+
+	for (queue = 0; queue < tx_cnt; queue++) {
+		struct stmmac_tx_queue *tx_q = &priv->tx_queue[queue];
+
+		cancel_work_sync(&tx_q->dim.work);
+		stmmac_dim_reset(&tx_q->dim);
+
+		if (adaptive_tx) {
+			moder = net_dim_get_def_tx_moderation(tx_q->dim.mode);
+			WRITE_ONCE(tx_q->coal_frames, moder.pkts);
+			WRITE_ONCE(tx_q->coal_timer, moder.usec);
+		} else {
+			WRITE_ONCE(tx_q->coal_frames, priv->tx_coal_frames);
+			WRITE_ONCE(tx_q->coal_timer, priv->tx_coal_timer);
+		}
+	}
+
+	for (queue = 0; queue < rx_cnt; queue++) {
+		struct stmmac_rx_queue *rx_q = &priv->rx_queue[queue];
+
+		cancel_work_sync(&rx_q->dim.work);
+		stmmac_dim_reset(&rx_q->dim);
+
+		moder = net_dim_get_def_rx_moderation(rx_q->dim.mode);
+		rx_q->coal_usecs = moder.usec;
+	}
+
+	if (priv->use_riwt) {
+		if (adaptive_rx)
+			stmmac_dim_update_riwt(priv);
+		else
+			stmmac_rx_watchdog(priv, priv->ioaddr, priv->rx_riwt,
+					   rx_cnt);
+	}
+
+	priv->tx_dim_enabled = adaptive_tx;
+	priv->rx_dim_enabled = adaptive_rx && priv->use_riwt;
+}
+
+/**
+ * stmmac_set_coalesce_mode - switch between static and adaptive coalescing
+ * @priv: driver private structure
+ * @adaptive_rx: retune the RI watchdog from the RX packet rate
+ * @adaptive_tx: retune the TX frame threshold and timer from the TX rate
+ * Description:
+ * Called on a running interface. The NAPI contexts, which feed net_dim for
+ * both directions, are quiesced so that no moderation update can be
+ * scheduled behind the switch.
+ */
+void stmmac_set_coalesce_mode(struct stmmac_priv *priv, bool adaptive_rx,
+			      bool adaptive_tx)
+{
+	u32 rx_cnt = priv->plat->rx_queues_to_use;
+	u32 queue;
+
+	stmmac_disable_all_queues(priv);
+	__stmmac_set_coalesce_mode(priv, adaptive_rx, adaptive_tx);
+	stmmac_enable_all_queues(priv);
+
+	/* Catch up with the TX timers which fired while NAPI was off */
+	local_bh_disable();
+	for (queue = 0; queue < rx_cnt; queue++)
+		napi_schedule(&priv->rx_queue[queue].napi);
+	local_bh_enable();
 }
 
 /**
- * stmmac_init_tx_coalesce - init tx mitigation options.
+ * stmmac_init_coalesce - init tx and rx mitigation options.
  * @priv: driver private structure
  * Description:
  * This inits the transmit coalesce parameters: i.e. timer rate,
  * timer handler and default threshold used for enabling the
- * interrupt on completion bit.
+ * interrupt on completion bit, and the adaptive moderation state.
  */
-static void stmmac_init_tx_coalesce(struct stmmac_priv *priv)
+static void stmmac_init_coalesce(struct stmmac_priv *priv)
 {
+	u32 rx_cnt = priv->plat->rx_queues_to_use;
+	u32 tx_cnt = priv->plat->tx_queues_to_use;
+	u32 queue;
+
 	priv->tx_coal_frames = STMMAC_TX_FRAMES;
 	priv->tx_coal_timer = STMMAC_COAL_TX_TIMER;
-	timer_setup(&priv->txtimer, stmmac_tx_timer, 0);
-	priv->txtimer.expires = STMMAC_COAL_TIMER(priv->tx_coal_timer);
-	add_timer(&priv->txtimer);
+
+	for (queue = 0; queue < tx_cnt; queue++) {
+		struct stmmac_tx_queue *tx_q = &priv->tx_queue[queue];
+
+		tx_q->tx_count_frames = 0;
+		hrtimer_init(&tx_q->txtimer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+		tx_q->txtimer.function = stmmac_tx_timer;
+
+		INIT_WORK(&tx_q->dim.work, stmmac_tx_dim_work);
+		tx_q->dim.mode = NET_DIM_CQ_PERIOD_MODE_START_FROM_CQE;
+	}
+
+	for (queue = 0; queue < rx_cnt; queue++) {
+		struct stmmac_rx_queue *rx_q = &priv->rx_queue[queue];
+
+		INIT_WORK(&rx_q->dim.work, stmmac_rx_dim_work);
+		rx_q->dim.mode = NET_DIM_CQ_PERIOD_MODE_START_FROM_CQE;
+	}
+
+	__stmmac_set_coalesce_mode(priv, priv->rx_dim_enabled,
+				   priv->tx_dim_enabled);
+}
+
+/* Stop the TX timers and any pending moderation update */
+static void stmmac_stop_coalesce(struct stmmac_priv *priv)
+{
+	u32 rx_cnt = priv->plat->rx_queues_to_use;
+	u32 tx_cnt = priv->plat->tx_queues_to_use;
+	u32 queue;
+
+	for (queue = 0; queue < tx_cnt; queue++) {
+		hrtimer_cancel(&priv->tx_queue[queue].txtimer);
+		cancel_work_sync(&priv->tx_queue[queue].dim.work);
+	}
+
+	for (queue = 0; queue < rx_cnt; queue++)
+		cancel_work_sync(&priv->rx_queue[queue].dim.work);
 }
 
 static void stmmac_set_rings_length(struct stmmac_priv *priv)
@@ -2635,7 +2956,7 @@ static int stmmac_open(struct net_device *dev)
 		goto init_error;
 	}
 
-	stmmac_init_tx_coalesce(priv);
+	stmmac_init_coalesce(priv);
 
 	if (dev->phydev)
 		phy_start(dev->phydev);
@@ -2688,7 +3009,7 @@ static int stmmac_open(struct net_device *dev)
 	if (dev->phydev)
 		phy_stop(dev->phydev);
 
-	del_timer_sync(&priv->txtimer);
+	stmmac_stop_coalesce(priv);
 	stmmac_hw_teardown(dev);
 init_error:
 	free_dma_desc_resources(priv);
@@ -2722,7 +3043,7 @@ static int stmmac_release(struct net_device *dev)
 
 	stmmac_disable_all_queues(priv);
 
-	del_timer_sync(&priv->txtimer);
+	stmmac_stop_coalesce(priv);
 
 	/* Free the IRQ lines */
 	free_irq(dev->irq, dev);
@@ -2936,12 +3257,11 @@ static netdev_tx_t stmmac_tso_xmit(struct sk_buff *skb, struct net_device *dev)
 	priv->xstats.tx_tso_nfrags += nfrags;
 
 	/* Manage tx mitigation */
-	priv->tx_count_frames += nfrags + 1;
-	if (likely(priv->tx_coal_frames > priv->tx_count_frames)) {
-		mod_timer(&priv->txtimer,
-			  STMMAC_COAL_TIMER(priv->tx_coal_timer));
+	tx_q->tx_count_frames += nfrags + 1;
+	if (likely(READ_ONCE(tx_q->coal_frames) > tx_q->tx_count_frames)) {
+		stmmac_tx_timer_arm(priv, queue);
 	} else {
-		priv->tx_count_frames = 0;
+		tx_q->tx_count_frames = 0;
 		stmmac_set_tx_ic(priv, desc);
 		priv->xstats.tx_set_ic_bit++;
 	}
@@ -3146,12 +3466,11 @@ static netdev_tx_t stmmac_xmit(struct sk_buff *skb, struct net_device *dev)
 	 * This approach takes care about the fragments: desc is the first
 	 * element in case of no SG.
 	 */
-	priv->tx_count_frames += nfrags + 1;
-	if (likely(priv->tx_coal_frames > priv->tx_count_frames)) {
-		mod_timer(&priv->txtimer,
-			  STMMAC_COAL_TIMER(priv->tx_coal_timer));
+	tx_q->tx_count_frames += nfrags + 1;
+	if (likely(READ_ONCE(tx_q->coal_frames) > tx_q->tx_count_frames)) {
+		stmmac_tx_timer_arm(priv, queue);
 	} else {
-		priv->tx_count_frames = 0;
+		tx_q->tx_count_frames = 0;
 		stmmac_set_tx_ic(priv, desc);
 		priv->xstats.tx_set_ic_bit++;
 	}
@@ -3240,6 +3559,370 @@ static inline int stmmac_rx_threshold_count(struct stmmac_rx_queue *rx_q)
 	return 1;
 }
 
+/* Give a buffer back to the device, dropping whatever the CPU (or an XDP
+ * program) may have dirtied in its first @len bytes.
+ */
+static void stmmac_rx_reuse_page(struct stmmac_priv *priv,
+				 struct stmmac_rx_buffer *buf,
+				 unsigned int len)
+{
+	dma_sync_single_range_for_device(priv->device, buf->addr,
+					 buf->page_offset + STMMAC_RX_HEADROOM,
+					 len, DMA_FROM_DEVICE);
+}
+
+/* True when no other buffer of the page is held outside the ring. The
+ * count can only drop behind our back, so checking before a buffer is
+ * handed out is safe.
+ */
+static bool stmmac_rx_page_reusable(struct stmmac_rx_buffer *buf)
+{
+	return page_ref_count(buf->page) == buf->pagecnt_bias;
+}
+
+/* Pages from a remote node or the reserves are not held on to */
+static bool stmmac_rx_page_keep(struct page *page)
+{
+	return page_to_nid(page) == numa_mem_id() && !page_is_pfmemalloc(page);
+}
+
+/* Park a page until the stack gives its buffers back, letting go of the
+ * oldest parked page when the pool is full.
+ */
+static void stmmac_rx_recycle_put(struct stmmac_priv *priv,
+				  struct stmmac_rx_queue *rx_q,
+				  struct stmmac_rx_buffer *buf)
+{
+	unsigned int tail;
+
+	if (unlikely(rx_q->recycle_count == STMMAC_RX_RECYCLE_SIZE)) {
+		stmmac_release_rx_page(priv, &rx_q->recycle[rx_q->recycle_head]);
+		rx_q->recycle_head = STMMAC_GET_ENTRY(rx_q->recycle_head,
+						      STMMAC_RX_RECYCLE_SIZE);
+		rx_q->recycle_count--;
+	}
+
+	tail = (rx_q->recycle_head + rx_q->recycle_count) &
+	       (STMMAC_RX_RECYCLE_SIZE - 1);
+	rx_q->recycle[tail] = *buf;
+	rx_q->recycle_count++;
+
+	buf->page = NULL;
+}
+
+/* Pages come back roughly in the order they were parked, so only the
+ * oldest one is looked at.
+ */
+static bool stmmac_rx_recycle_get(struct stmmac_priv *priv,
+				  struct stmmac_rx_queue *rx_q,
+				  struct stmmac_rx_buffer *buf)
+{
+	struct stmmac_rx_buffer *head = &rx_q->recycle[rx_q->recycle_head];
+
+	if (!rx_q->recycle_count ||
+	    page_ref_count(head->page) != head->pagecnt_bias)
+		return false;
+
+	*buf = *head;
+	head->page = NULL;
+	rx_q->recycle_head = STMMAC_GET_ENTRY(rx_q->recycle_head,
+					      STMMAC_RX_RECYCLE_SIZE);
+	rx_q->recycle_count--;
+
+	/* The stack may have written anywhere in the buffer */
+	buf->page_offset = 0;
+	stmmac_rx_reuse_page(priv, buf, priv->dma_buf_sz);
+
+	return true;
+}
+
+/**
+ * stmmac_rx_buffer_handed - a buffer has left the ring with its frame
+ * @priv: driver private structure
+ * @rx_q: RX queue the buffer belongs to
+ * @buf: RX buffer
+ * @reuse: result of stmmac_rx_page_reusable() before the frame left
+ * Description: if the rest of the page is free the slot moves on to the
+ * next buffer in it, otherwise the page is parked in the recycle pool and
+ * the slot is left empty for stmmac_rx_refill(). Pages which should not be
+ * kept are released instead of being parked.
+ */
+static void stmmac_rx_buffer_handed(struct stmmac_priv *priv,
+				    struct stmmac_rx_queue *rx_q,
+				    struct stmmac_rx_buffer *buf, bool reuse)
+{
+	buf->pagecnt_bias--;
+
+	if (unlikely(!stmmac_rx_page_keep(buf->page))) {
+		stmmac_release_rx_page(priv, buf);
+		return;
+	}
+
+	/* Restock the references before the bias runs out */
+	if (unlikely(buf->pagecnt_bias == 1)) {
+		page_ref_add(buf->page, USHRT_MAX - 1);
+		buf->pagecnt_bias = USHRT_MAX;
+	}
+
+	if (!reuse) {
+		stmmac_rx_recycle_put(priv, rx_q, buf);
+		return;
+	}
+
+	buf->page_offset += priv->rx_truesize;
+	if (buf->page_offset + priv->rx_truesize > stmmac_rx_map_size(priv))
+		buf->page_offset = 0;
+
+	stmmac_rx_reuse_page(priv, buf, priv->dma_buf_sz);
+	priv->xstats.rx_page_reuse++;
+}
+
+static u32 stmmac_xdp_get_tx_queue(struct stmmac_priv *priv, int cpu)
+{
+	return cpu % priv->plat->tx_queues_to_use;
+}
+
+/* XDP shares the TX rings with the stack: leave it enough descriptors for
+ * a maximally fragmented skb so that stmmac_xmit() never finds the ring
+ * full while the queue is awake, and keep off a ring that is stopped or
+ * that stmmac_tx_clean() has frozen.
+ */
+static bool stmmac_xdp_tx_avail(struct stmmac_priv *priv, u32 queue)
+{
+	struct netdev_queue *nq = netdev_get_tx_queue(priv->dev, queue);
+
+	if (unlikely(netif_xmit_frozen_or_drv_stopped(nq)))
+		return false;
+
+	return stmmac_tx_avail(priv, queue) > MAX_SKB_FRAGS + 1;
+}
+
+static void stmmac_xdp_prepare_desc(struct stmmac_priv *priv, u32 queue,
+				    struct dma_desc *desc, dma_addr_t dma,
+				    unsigned int len)
+{
+	struct stmmac_tx_queue *tx_q = &priv->tx_queue[queue];
+
+	stmmac_set_desc_addr(priv, desc, dma);
+
+	tx_q->tx_count_frames++;
+	if (likely(READ_ONCE(tx_q->coal_frames) > tx_q->tx_count_frames)) {
+		stmmac_tx_timer_arm(priv, queue);
+	} else {
+		tx_q->tx_count_frames = 0;
+		stmmac_set_tx_ic(priv, desc);
+		priv->xstats.tx_set_ic_bit++;
+	}
+
+	/* Single descriptor frame: set the OWN bit too */
+	stmmac_prepare_tx_desc(priv, desc, 1, len, 0, priv->mode, 1, true,
+			       len);
+}
+
+static void stmmac_xdp_kick_tx(struct stmmac_priv *priv, u32 queue)
+{
+	struct stmmac_tx_queue *tx_q = &priv->tx_queue[queue];
+
+	/* The OWN bits must be visible before the DMA is woken up */
+	wmb();
+
+	stmmac_enable_dma_transmission(priv, priv->ioaddr);
+	stmmac_set_tx_tail_ptr(priv, priv->ioaddr, tx_q->tx_tail_addr, queue);
+}
+
+/**
+ * stmmac_xdp_xmit_xdpf - queue an xdp_frame on a TX ring
+ * @priv: driver private structure
+ * @queue: TX queue index
+ * @xdpf: frame to send
+ * @buf_type: STMMAC_TXBUF_T_XDP_TX or STMMAC_TXBUF_T_XDP_NDO
+ * Description: the caller holds the TX queue lock. The frame gets its own
+ * mapping even on XDP_TX: the RX mapping stays with the page, which the
+ * ring keeps receiving into while the frame is in flight.
+ */
+static int stmmac_xdp_xmit_xdpf(struct stmmac_priv *priv, u32 queue,
+				struct xdp_frame *xdpf,
+				enum stmmac_txbuf_type buf_type)
+{
+	struct stmmac_tx_queue *tx_q = &priv->tx_queue[queue];
+	unsigned int entry = tx_q->cur_tx;
+	struct stmmac_tx_info *tx_info;
+	struct dma_desc *desc;
+	dma_addr_t dma;
+
+	if (unlikely(!stmmac_xdp_tx_avail(priv, queue)))
+		return STMMAC_XDP_CONSUMED;
+
+	/* Jumbo frames would need more than one descriptor */
+	if (priv->plat->enh_desc &&
+	    stmmac_is_jumbo_frm(priv, xdpf->len, priv->plat->enh_desc))
+		return STMMAC_XDP_CONSUMED;
+
+	if (likely(priv->extend_desc))
+		desc = (struct dma_desc *)(tx_q->dma_etx + entry);
+	else
+		desc = tx_q->dma_tx + entry;
+
+	tx_info = &tx_q->tx_skbuff_dma[entry];
+
+	dma = dma_map_single(priv->device, xdpf->data, xdpf->len,
+			     DMA_TO_DEVICE);
+	if (dma_mapping_error(priv->device, dma))
+		return STMMAC_XDP_CONSUMED;
+
+	tx_info->buf = dma;
+	tx_info->len = xdpf->len;
+	tx_info->map_as_page = false;
+	tx_info->buf_type = buf_type;
+	tx_info->xdpf = xdpf;
+	tx_info->last_segment = true;
+	tx_info->is_jumbo = false;
+
+	stmmac_xdp_prepare_desc(priv, queue, desc, dma, xdpf->len);
+
+	priv->dev->stats.tx_bytes += xdpf->len;
+	tx_q->cur_tx = STMMAC_GET_ENTRY(entry, DMA_TX_SIZE);
+
+	return STMMAC_XDP_TX;
+}
+
+static int stmmac_xdp_xmit_back(struct stmmac_priv *priv,
+				struct xdp_buff *xdp)
+{
+	struct xdp_frame *xdpf = convert_to_xdp_frame(xdp);
+	int cpu = smp_processor_id();
+	struct netdev_queue *nq;
+	u32 queue;
+	int res;
+
+	if (unlikely(!xdpf))
+		return STMMAC_XDP_CONSUMED;
+
+	queue = stmmac_xdp_get_tx_queue(priv, cpu);
+	nq = netdev_get_tx_queue(priv->dev, queue);
+
+	__netif_tx_lock(nq, cpu);
+	/* Avoids TX time-out as we are sharing with slow path */
+	txq_trans_update(nq);
+
+	res = stmmac_xdp_xmit_xdpf(priv, queue, xdpf, STMMAC_TXBUF_T_XDP_TX);
+
+	__netif_tx_unlock(nq);
+
+	return res;
+}
+
+/**
+ * stmmac_run_xdp - run the XDP program on a received frame
+ * @priv: driver private structure
+ * @prog: XDP program
+ * @xdp: frame descriptor, updated by the program
+ * Description: on STMMAC_XDP_TX and STMMAC_XDP_REDIRECT the frame now
+ * belongs to its target; on STMMAC_XDP_CONSUMED it stays in the ring.
+ */
+static int stmmac_run_xdp(struct stmmac_priv *priv,
+			  struct bpf_prog *prog, struct xdp_buff *xdp)
+{
+	u32 act;
+	int res;
+
+	act = bpf_prog_run_xdp(prog, xdp);
+	switch (act) {
+	case XDP_PASS:
+		return STMMAC_XDP_PASS;
+	case XDP_TX:
+		res = stmmac_xdp_xmit_back(priv, xdp);
+		if (res == STMMAC_XDP_CONSUMED)
+			goto out_failure;
+		return res;
+	case XDP_REDIRECT:
+		if (xdp_do_redirect(priv->dev, xdp, prog) < 0)
+			goto out_failure;
+		return STMMAC_XDP_REDIRECT;
+	default:
+		bpf_warn_invalid_xdp_action(act);
+		/* fall through */
+	case XDP_ABORTED:
+out_failure:
+		trace_xdp_exception(priv->dev, prog, act);
+		/* fall through */
+	case XDP_DROP:
+		return STMMAC_XDP_CONSUMED;
+	}
+}
+
+/**
+ * stmmac_xsk_xmit - send frames from an AF_XDP socket in zero-copy mode
+ * @priv: driver private structure
+ * @queue: TX queue index
+ * @budget: maximum number of frames to send
+ * Description: the frames are transmitted straight from the umem, which
+ * was DMA mapped when it was bound to the queue.
+ * Return: true when the socket has nothing left to send.
+ */
+static bool stmmac_xsk_xmit(struct stmmac_priv *priv, u32 queue,
+			    unsigned int budget)
+{
+	struct stmmac_tx_queue *tx_q = &priv->tx_queue[queue];
+	struct netdev_queue *nq = netdev_get_tx_queue(priv->dev, queue);
+	struct xdp_umem *umem = tx_q->xsk_umem;
+	bool work_done = true;
+	unsigned int sent = 0;
+	dma_addr_t dma;
+	u32 len;
+
+	__netif_tx_lock(nq, smp_processor_id());
+	/* Avoids TX time-out as we are sharing with slow path */
+	txq_trans_update(nq);
+
+	for (; budget > 0; budget--) {
+		unsigned int entry = tx_q->cur_tx;
+		struct stmmac_tx_info *tx_info;
+		struct dma_desc *desc;
+
+		if (unlikely(!stmmac_xdp_tx_avail(priv, queue) ||
+			     !netif_carrier_ok(priv->dev))) {
+			work_done = false;
+			break;
+		}
+
+		if (!xsk_umem_consume_tx(umem, &dma, &len))
+			break;
+
+		if (likely(priv->extend_desc))
+			desc = (struct dma_desc *)(tx_q->dma_etx + entry);
+		else
+			desc = tx_q->dma_tx + entry;
+
+		dma_sync_single_for_device(priv->device, dma, len,
+					   DMA_BIDIRECTIONAL);
+
+		/* The umem mapping outlives the entry: nothing to unmap */
+		tx_info = &tx_q->tx_skbuff_dma[entry];
+		tx_info->buf = 0;
+		tx_info->len = 0;
+		tx_info->map_as_page = false;
+		tx_info->last_segment = true;
+		tx_info->is_jumbo = false;
+		tx_info->buf_type = STMMAC_TXBUF_T_XSK_TX;
+
+		stmmac_xdp_prepare_desc(priv, queue, desc, dma, len);
+
+		priv->dev->stats.tx_bytes += len;
+		tx_q->cur_tx = STMMAC_GET_ENTRY(entry, DMA_TX_SIZE);
+		sent++;
+	}
+
+	if (sent) {
+		stmmac_xdp_kick_tx(priv, queue);
+		xsk_umem_consume_tx_done(umem);
+	}
+
+	__netif_tx_unlock(nq);
+
+	return budget > 0 && work_done;
+}
+
 /**
  * stmmac_rx_refill - refill used skb preallocated buffers
  * @priv: driver private structure
@@ -3253,9 +3936,8 @@ static inline void stmmac_rx_refill(struct stmmac_priv *priv, u32 queue)
 	int dirty = stmmac_rx_dirty(priv, queue);
 	unsigned int entry = rx_q->dirty_rx;
 
-	int bfsize = priv->dma_buf_sz;
-
 	while (dirty-- > 0) {
+		struct stmmac_rx_buffer *buf = &rx_q->buf_pool[entry];
 		struct dma_desc *p;
 
 		if (priv->extend_desc)
@@ -3263,40 +3945,41 @@ static inline void stmmac_rx_refill(struct stmmac_priv *priv, u32 queue)
 		else
 			p = rx_q->dma_rx + entry;
 
-		if (likely(!rx_q->rx_skbuff[entry])) {
-			struct sk_buff *skb;
-
-			skb = netdev_alloc_skb_ip_align(priv->dev, bfsize);
-			if (unlikely(!skb)) {
-				/* so for a while no zero-copy! */
-				rx_q->rx_zeroc_thresh = STMMAC_RX_THRESH;
-				if (unlikely(net_ratelimit()))
-					dev_err(priv->device,
-						"fail to alloc skb entry %d\n",
-						entry);
-				break;
-			}
-
-			rx_q->rx_skbuff[entry] = skb;
-			rx_q->rx_skbuff_dma[entry] =
-			    dma_map_single(priv->device, skb->data, bfsize,
-					   DMA_FROM_DEVICE);
-			if (dma_mapping_error(priv->device,
-					      rx_q->rx_skbuff_dma[entry])) {
-				netdev_err(priv->dev, "Rx DMA map failed\n");
-				dev_kfree_skb(skb);
-				break;
+		if (likely(!buf->page)) {
+			if (stmmac_rx_recycle_get(priv, rx_q, buf)) {
+				priv->xstats.rx_page_recycle_hit++;
+			} else {
+				int ret = stmmac_alloc_rx_page(priv, buf,
+							       GFP_ATOMIC);
+
+				if (unlikely(ret)) {
+					/* so for a while no zero-copy! */
+					rx_q->rx_zeroc_thresh = STMMAC_RX_THRESH;
+					if (unlikely(net_ratelimit()))
+						dev_err(priv->device,
+							"fail to alloc page entry %d (%d)\n",
+							entry, ret);
+					break;
+				}
+				priv->xstats.rx_page_recycle_miss++;
 			}
 
-			stmmac_set_desc_addr(priv, p, rx_q->rx_skbuff_dma[entry]);
-			stmmac_refill_desc3(priv, rx_q, p);
-
 			if (rx_q->rx_zeroc_thresh > 0)
 				rx_q->rx_zeroc_thresh--;
 
 			netif_dbg(priv, rx_status, priv->dev,
 				  "refill entry #%d\n", entry);
 		}
+
+		/* Buffers that were copied out or dropped by XDP stay in the
+		 * ring, and the others may have moved within their page; the
+		 * write-back format of some cores clobbers the buffer address
+		 * anyway, so always program it again.
+		 */
+		stmmac_set_desc_addr(priv, p, buf->addr + buf->page_offset +
+				     STMMAC_RX_HEADROOM);
+		stmmac_refill_desc3(priv, rx_q, p);
+
 		dma_wmb();
 
 		stmmac_set_rx_owner(priv, p, priv->use_riwt);
@@ -3321,11 +4004,11 @@ static int stmmac_rx(struct stmmac_priv *priv, int limit, u32 queue)
 	struct stmmac_rx_queue *rx_q = &priv->rx_queue[queue];
 	unsigned int entry = rx_q->cur_rx;
 	int coe = priv->hw->rx_csum;
+	struct bpf_prog *xdp_prog;
 	unsigned int next_entry;
+	unsigned int xdp_status = 0;
 	unsigned int count = 0;
-	bool xmac;
-
-	xmac = priv->plat->has_gmac4 || priv->plat->has_xgmac;
+	struct xdp_buff xdp;
 
 	if (netif_msg_rx_status(priv)) {
 		void *rx_head;
@@ -3338,6 +4021,11 @@ static int stmmac_rx(struct stmmac_priv *priv, int limit, u32 queue)
 
 		stmmac_display_ring(priv, rx_head, DMA_RX_SIZE, true);
 	}
+
+	rcu_read_lock();
+	xdp_prog = READ_ONCE(priv->xdp_prog);
+	xdp.rxq = &rx_q->xdp_rxq;
+
 	while (count < limit) {
 		int status;
 		struct dma_desc *p;
@@ -3371,29 +4059,23 @@ static int stmmac_rx(struct stmmac_priv *priv, int limit, u32 queue)
 			stmmac_rx_extended_status(priv, &priv->dev->stats,
 					&priv->xstats, rx_q->dma_erx + entry);
 		if (unlikely(status == discard_frame)) {
+			/* DESC2 & DESC3 may have been overwritten by the
+			 * device with a timestamp value; stmmac_rx_refill()
+			 * programs them again so the buffer can be reused.
+			 */
 			priv->dev->stats.rx_errors++;
-			if (priv->hwts_rx_en && !priv->extend_desc) {
-				/* DESC2 & DESC3 will be overwritten by device
-				 * with timestamp value, hence reinitialize
-				 * them in stmmac_rx_refill() function so that
-				 * device can reuse it.
-				 */
-				dev_kfree_skb_any(rx_q->rx_skbuff[entry]);
-				rx_q->rx_skbuff[entry] = NULL;
-				dma_unmap_single(priv->device,
-						 rx_q->rx_skbuff_dma[entry],
-						 priv->dma_buf_sz,
-						 DMA_FROM_DEVICE);
-			}
 		} else {
+			struct stmmac_rx_buffer *buf = &rx_q->buf_pool[entry];
+			unsigned int sync_len;
 			struct sk_buff *skb;
 			int frame_len;
 			unsigned int des;
+			bool reuse;
 
 			stmmac_get_desc_addr(priv, p, &des);
 			frame_len = stmmac_get_rx_frame_len(priv, p, coe);
 
-			/*  If frame length is greater than skb buffer size
+			/*  If frame length is greater than the buffer size
 			 *  (preallocated during init) then the packet is
 			 *  ignored
 			 */
@@ -3423,16 +4105,63 @@ static int stmmac_rx(struct stmmac_priv *priv, int limit, u32 queue)
 					   frame_len, status);
 			}
 
-			/* The zero-copy is always used for all the sizes
-			 * in case of GMAC4 because it needs
-			 * to refill the used descriptors, always.
+			if (unlikely(!buf->page)) {
+				netdev_err(priv->dev,
+					   "%s: Inconsistent Rx chain\n",
+					   priv->dev->name);
+				priv->dev->stats.rx_dropped++;
+				break;
+			}
+
+			/* Only the received bytes are handed to the CPU */
+			sync_len = frame_len;
+			dma_sync_single_range_for_cpu(priv->device, buf->addr,
+						      buf->page_offset +
+						      STMMAC_RX_HEADROOM,
+						      sync_len,
+						      DMA_FROM_DEVICE);
+
+			reuse = stmmac_rx_page_reusable(buf);
+
+			xdp.data_hard_start = page_address(buf->page) +
+					      buf->page_offset;
+			xdp.data = xdp.data_hard_start + STMMAC_RX_HEADROOM;
+			xdp_set_data_meta_invalid(&xdp);
+			xdp.data_end = xdp.data + frame_len;
+
+			if (xdp_prog) {
+				int res;
+
+				res = stmmac_run_xdp(priv, xdp_prog, &xdp);
+				if (res != STMMAC_XDP_PASS) {
+					if (res == STMMAC_XDP_CONSUMED)
+						stmmac_rx_reuse_page(priv, buf,
+								     sync_len);
+					else
+						stmmac_rx_buffer_handed(priv,
+									rx_q,
+									buf,
+									reuse);
+					xdp_status |= res;
+					priv->dev->stats.rx_packets++;
+					priv->dev->stats.rx_bytes += frame_len;
+					rx_q->dim_bytes += frame_len;
+					entry = next_entry;
+					continue;
+				}
+				frame_len = xdp.data_end - xdp.data;
+			}
+
+			/* Small frames, and any frame while the ring is short
+			 * of pages, are copied so that the page stays in place.
 			 */
-			if (unlikely(!xmac &&
-				     ((frame_len < priv->rx_copybreak) ||
-				     stmmac_rx_threshold_count(rx_q)))) {
+			if (unlikely((frame_len < priv->rx_copybreak) ||
+				     stmmac_rx_threshold_count(rx_q))) {
 				skb = netdev_alloc_skb_ip_align(priv->dev,
 								frame_len);
 				if (unlikely(!skb)) {
+					stmmac_rx_reuse_page(priv, buf,
+							     sync_len);
 					if (net_ratelimit())
 						dev_warn(priv->device,
 							 "packet dropped\n");
@@ -3440,38 +4169,29 @@ static int stmmac_rx(struct stmmac_priv *priv, int limit, u32 queue)
 					break;
 				}
 
-				dma_sync_single_for_cpu(priv->device,
-							rx_q->rx_skbuff_dma
-							[entry], frame_len,
-							DMA_FROM_DEVICE);
-				skb_copy_to_linear_data(skb,
-							rx_q->
-							rx_skbuff[entry]->data,
+				skb_copy_to_linear_data(skb, xdp.data,
 							frame_len);
-
 				skb_put(skb, frame_len);
-				dma_sync_single_for_device(priv->device,
-							   rx_q->rx_skbuff_dma
-							   [entry], frame_len,
-							   DMA_FROM_DEVICE);
+				stmmac_rx_reuse_page(priv, buf, sync_len);
 			} else {
-				skb = rx_q->rx_skbuff[entry];
+				skb = build_skb(xdp.data_hard_start,
+						priv->rx_truesize);
 				if (unlikely(!skb)) {
-					netdev_err(priv->dev,
-						   "%s: Inconsistent Rx chain\n",
-						   priv->dev->name);
+					stmmac_rx_reuse_page(priv, buf,
+							     sync_len);
+					if (net_ratelimit())
+						dev_warn(priv->device,
+							 "packet dropped\n");
 					priv->dev->stats.rx_dropped++;
 					break;
 				}
-				prefetch(skb->data - NET_IP_ALIGN);
-				rx_q->rx_skbuff[entry] = NULL;
-				rx_q->rx_zeroc_thresh++;
+				prefetch(xdp.data);
+				stmmac_rx_buffer_handed(priv, rx_q, buf, reuse);
+				if (!buf->page)
+					rx_q->rx_zeroc_thresh++;
 
+				skb_reserve(skb, xdp.data - xdp.data_hard_start);
 				skb_put(skb, frame_len);
-				dma_unmap_single(priv->device,
-						 rx_q->rx_skbuff_dma[entry],
-						 priv->dma_buf_sz,
-						 DMA_FROM_DEVICE);
 			}
 
 			if (netif_msg_pktdata(priv)) {
@@ -3495,13 +4215,23 @@ static int stmmac_rx(struct stmmac_priv *priv, int limit, u32 queue)
 
 			priv->dev->stats.rx_packets++;
 			priv->dev->stats.rx_bytes += frame_len;
+			rx_q->dim_bytes += frame_len;
 		}
 		entry = next_entry;
 	}
+	rcu_read_unlock();
+
+	if (xdp_status & STMMAC_XDP_TX)
+		stmmac_xdp_kick_tx(priv, stmmac_xdp_get_tx_queue(priv,
+							smp_processor_id()));
+
+	if (xdp_status & STMMAC_XDP_REDIRECT)
+		xdp_do_flush_map();
 
 	stmmac_rx_refill(priv, queue);
 
 	priv->xstats.rx_pkt_n += count;
+	rx_q->dim_packets += count;
 
 	return count;
 }
@@ -3521,16 +4251,35 @@ static int stmmac_poll(struct napi_struct *napi, int budget)
 	struct stmmac_priv *priv = rx_q->priv_data;
 	u32 tx_count = priv->plat->tx_queues_to_use;
 	u32 chan = rx_q->queue_index;
+	bool xsk_done = true;
 	int work_done = 0;
 	u32 queue;
 
 	priv->xstats.napi_poll++;
 
 	/* check all the queues */
-	for (queue = 0; queue < tx_count; queue++)
+	for (queue = 0; queue < tx_count; queue++) {
 		stmmac_tx_clean(priv, queue);
 
+		if (priv->tx_queue[queue].xsk_umem)
+			xsk_done &= stmmac_xsk_xmit(priv, queue, budget);
+	}
+
 	work_done = stmmac_rx(priv, budget, rx_q->queue_index);
+
+	if (priv->rx_dim_enabled) {
+		struct net_dim_sample dim_sample;
+
+		rx_q->dim_events++;
+		net_dim_sample(rx_q->dim_events, rx_q->dim_packets,
+			       rx_q->dim_bytes, &dim_sample);
+		net_dim(&rx_q->dim, dim_sample);
+	}
+
+	/* Keep polling while an AF_XDP socket still has frames to send */
+	if (!xsk_done)
+		return budget;
+
 	if (work_done < budget) {
 		napi_complete_done(napi, work_done);
 		stmmac_enable_dma_irq(priv, priv->ioaddr, chan);
@@ -4053,6 +4802,199 @@ static void stmmac_exit_fs(struct net_device *dev)
 }
 #endif /* CONFIG_DEBUG_FS */
 
+static int stmmac_xdp_setup(struct net_device *dev, struct bpf_prog *prog)
+{
+	struct stmmac_priv *priv = netdev_priv(dev);
+	struct bpf_prog *old_prog;
+
+	/* Every RX buffer already has XDP headroom: just swap the program,
+	 * stmmac_rx() picks it up at the next poll.
+	 */
+	old_prog = xchg(&priv->xdp_prog, prog);
+	if (old_prog)
+		bpf_prog_put(old_prog);
+
+	return 0;
+}
+
+static int stmmac_xsk_umem_dma_map(struct stmmac_priv *priv,
+				   struct xdp_umem *umem)
+{
+	unsigned int i, j;
+	dma_addr_t dma;
+
+	for (i = 0; i < umem->npgs; i++) {
+		dma = dma_map_page_attrs(priv->device, umem->pgs[i], 0,
+					 PAGE_SIZE, DMA_BIDIRECTIONAL,
+					 DMA_ATTR_SKIP_CPU_SYNC);
+		if (dma_mapping_error(priv->device, dma))
+			goto out_unmap;
+
+		umem->pages[i].dma = dma;
+	}
+
+	return 0;
+
+out_unmap:
+	for (j = 0; j < i; j++) {
+		dma_unmap_page_attrs(priv->device, umem->pages[j].dma,
+				     PAGE_SIZE, DMA_BIDIRECTIONAL,
+				     DMA_ATTR_SKIP_CPU_SYNC);
+		umem->pages[j].dma = 0;
+	}
+
+	return -ENOMEM;
+}
+
+static void stmmac_xsk_umem_dma_unmap(struct stmmac_priv *priv,
+				      struct xdp_umem *umem)
+{
+	unsigned int i;
+
+	for (i = 0; i < umem->npgs; i++) {
+		dma_unmap_page_attrs(priv->device, umem->pages[i].dma,
+				     PAGE_SIZE, DMA_BIDIRECTIONAL,
+				     DMA_ATTR_SKIP_CPU_SYNC);
+		umem->pages[i].dma = 0;
+	}
+}
+
+/**
+ * stmmac_xsk_umem_setup - bind or unbind an AF_XDP umem to a queue
+ * @dev: device pointer
+ * @umem: umem to bind, NULL to unbind
+ * @qid: queue index
+ * Description: transmission is zero-copy, straight from the umem. There is
+ * no zero-copy receive: the RX rings keep their own pages and frames reach
+ * the socket through XDP_REDIRECT, which copies them into the umem. The
+ * interface is restarted so that no descriptor refers to the umem while
+ * it is being (un)mapped.
+ */
+static int stmmac_xsk_umem_setup(struct net_device *dev,
+				 struct xdp_umem *umem, u16 qid)
+{
+	struct stmmac_priv *priv = netdev_priv(dev);
+	bool running = netif_running(dev);
+	struct stmmac_tx_queue *tx_q;
+	int ret = 0;
+
+	if (qid >= priv->plat->tx_queues_to_use)
+		return -EINVAL;
+
+	tx_q = &priv->tx_queue[qid];
+	if (umem && tx_q->xsk_umem)
+		return -EBUSY;
+	if (!umem && !tx_q->xsk_umem)
+		return -EINVAL;
+
+	if (running)
+		dev_close(dev);
+
+	if (umem) {
+		ret = stmmac_xsk_umem_dma_map(priv, umem);
+		if (!ret)
+			tx_q->xsk_umem = umem;
+	} else {
+		stmmac_xsk_umem_dma_unmap(priv, tx_q->xsk_umem);
+		tx_q->xsk_umem = NULL;
+	}
+
+	if (running) {
+		int err = dev_open(dev);
+
+		if (err) {
+			netdev_err(dev, "%s: failed to reopen (%d)\n",
+				   __func__, err);
+			ret = ret ? : err;
+		}
+	}
+
+	return ret;
+}
+
+static int stmmac_bpf(struct net_device *dev, struct netdev_bpf *bpf)
+{
+	struct stmmac_priv *priv = netdev_priv(dev);
+
+	switch (bpf->command) {
+	case XDP_SETUP_PROG:
+		return stmmac_xdp_setup(dev, bpf->prog);
+	case XDP_QUERY_PROG:
+		bpf->prog_id = priv->xdp_prog ? priv->xdp_prog->aux->id : 0;
+		return 0;
+	case XDP_QUERY_XSK_UMEM:
+		if (bpf->xsk.queue_id >= priv->plat->tx_queues_to_use)
+			return -EINVAL;
+		bpf->xsk.umem = priv->tx_queue[bpf->xsk.queue_id].xsk_umem;
+		return 0;
+	case XDP_SETUP_XSK_UMEM:
+		return stmmac_xsk_umem_setup(dev, bpf->xsk.umem,
+					     bpf->xsk.queue_id);
+	default:
+		return -EINVAL;
+	}
+}
+
+static int stmmac_xdp_xmit(struct net_device *dev, int num_frames,
+			   struct xdp_frame **frames, u32 flags)
+{
+	struct stmmac_priv *priv = netdev_priv(dev);
+	int cpu = smp_processor_id();
+	struct netdev_queue *nq;
+	int i, drops = 0;
+	u32 queue;
+
+	if (unlikely(test_bit(STMMAC_DOWN, &priv->state) ||
+		     !netif_carrier_ok(dev)))
+		return -ENETDOWN;
+
+	if (unlikely(flags & ~XDP_XMIT_FLAGS_MASK))
+		return -EINVAL;
+
+	queue = stmmac_xdp_get_tx_queue(priv, cpu);
+	nq = netdev_get_tx_queue(priv->dev, queue);
+
+	__netif_tx_lock(nq, cpu);
+	/* Avoids TX time-out as we are sharing with slow path */
+	txq_trans_update(nq);
+
+	for (i = 0; i < num_frames; i++) {
+		if (stmmac_xdp_xmit_xdpf(priv, queue, frames[i],
+					 STMMAC_TXBUF_T_XDP_NDO) !=
+		    STMMAC_XDP_TX) {
+			xdp_return_frame_rx_napi(frames[i]);
+			drops++;
+		}
+	}
+
+	if (flags & XDP_XMIT_FLUSH)
+		stmmac_xdp_kick_tx(priv, queue);
+
+	__netif_tx_unlock(nq);
+
+	return num_frames - drops;
+}
+
+static int stmmac_xsk_async_xmit(struct net_device *dev, u32 queue)
+{
+	struct stmmac_priv *priv = netdev_priv(dev);
+
+	if (unlikely(test_bit(STMMAC_DOWN, &priv->state) ||
+		     !netif_carrier_ok(dev)))
+		return -ENETDOWN;
+
+	if (queue >= priv->plat->tx_queues_to_use ||
+	    !priv->tx_queue[queue].xsk_umem)
+		return -ENXIO;
+
+	/* An already scheduled NAPI is marked as missed and polls again */
+	local_bh_disable();
+	napi_schedule(stmmac_tx_napi(priv, queue));
+	local_bh_enable();
+
+	return 0;
+}
+
 static const struct net_device_ops stmmac_netdev_ops = {
 	.ndo_open = stmmac_open,
 	.ndo_start_xmit = stmmac_xmit,
@@ -4068,6 +5010,9 @@ static const struct net_device_ops stmmac_netdev_ops = {
 	.ndo_poll_controller = stmmac_poll_controller,
 #endif
 	.ndo_set_mac_address = stmmac_set_mac_address,
+	.ndo_bpf = stmmac_bpf,
+	.ndo_xdp_xmit = stmmac_xdp_xmit,
+	.ndo_xsk_async_xmit = stmmac_xsk_async_xmit,
 };
 
 static void stmmac_reset_subtask(struct stmmac_priv *priv)
@@ -4445,6 +5390,8 @@ int stmmac_suspend(struct device *dev)
 
 	stmmac_disable_all_queues(priv);
 
+	stmmac_stop_coalesce(priv);
+
 	/* Stop TX/RX DMA */
 	stmmac_stop_all_dma(priv);
 
@@ -4538,7 +5485,7 @@ int stmmac_resume(struct device *dev)
 	stmmac_clear_descriptors(priv);
 
 	stmmac_hw_setup(ndev, false);
-	stmmac_init_tx_coalesce(priv);
+	stmmac_init_coalesce(priv);
 	stmmac_set_rx_mode(ndev);
 
 	stmmac_enable_all_queues(priv);
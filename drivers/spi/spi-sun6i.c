@@ -14,6 +14,7 @@
 #include <linux/clk.h>
 #include <linux/delay.h>
 #include <linux/device.h>
+#include <linux/dmaengine.h>
 #include <linux/interrupt.h>
 #include <linux/io.h>
 #include <linux/module.h>
@@ -23,6 +24,7 @@
 #include <linux/reset.h>
 
 #include <linux/spi/spi.h>
+#include <linux/spi/spi-mem.h>
 
 #define SUN6I_FIFO_DEPTH		128
 #define SUN8I_FIFO_DEPTH		64
@@ -56,9 +58,11 @@
 #define SUN6I_FIFO_CTL_REG		0x18
 #define SUN6I_FIFO_CTL_RF_RDY_TRIG_LEVEL_MASK	0xff
 #define SUN6I_FIFO_CTL_RF_RDY_TRIG_LEVEL_BITS	0
+#define SUN6I_FIFO_CTL_RF_DRQ_EN		BIT(8)
 #define SUN6I_FIFO_CTL_RF_RST			BIT(15)
 #define SUN6I_FIFO_CTL_TF_ERQ_TRIG_LEVEL_MASK	0xff
 #define SUN6I_FIFO_CTL_TF_ERQ_TRIG_LEVEL_BITS	16
+#define SUN6I_FIFO_CTL_TF_DRQ_EN		BIT(24)
 #define SUN6I_FIFO_CTL_TF_RST			BIT(31)
 
 #define SUN6I_FIFO_STA_REG		0x1c
@@ -94,6 +98,8 @@ struct sun6i_spi {
 	struct clk		*hclk;
 	struct clk		*mclk;
 	struct reset_control	*rstc;
+	phys_addr_t		dma_addr_rx;
+	phys_addr_t		dma_addr_tx;
 
 	struct completion	done;
 
@@ -197,48 +203,106 @@ static size_t sun6i_spi_max_transfer_size(struct spi_device *spi)
 	return SUN6I_MAX_XFER_SIZE - 1;
 }
 
-static int sun6i_spi_transfer_one(struct spi_master *master,
-				  struct spi_device *spi,
-				  struct spi_transfer *tfr)
+static void sun6i_spi_dma_rx_cb(void *param)
 {
-	struct sun6i_spi *sspi = spi_master_get_devdata(master);
-	unsigned int mclk_rate, div, timeout;
-	unsigned int start, end, tx_time;
-	unsigned int trig_level;
-	unsigned int tx_len = 0;
-	int ret = 0;
-	u32 reg;
+	struct sun6i_spi *sspi = param;
 
-	if (tfr->len > SUN6I_MAX_XFER_SIZE)
-		return -EINVAL;
+	complete(&sspi->done);
+}
 
-	reinit_completion(&sspi->done);
-	sspi->tx_buf = tfr->tx_buf;
-	sspi->rx_buf = tfr->rx_buf;
-	sspi->len = tfr->len;
+static struct dma_async_tx_descriptor *
+sun6i_spi_prep_dma(struct sun6i_spi *sspi, struct dma_chan *chan,
+		   struct sg_table *sgt, enum dma_transfer_direction dir)
+{
+	struct dma_slave_config conf = {
+		.direction = dir,
+	};
+	int ret;
 
-	/* Clear pending interrupts */
-	sun6i_spi_write(sspi, SUN6I_INT_STA_REG, ~0);
+	if (dir == DMA_DEV_TO_MEM) {
+		conf.src_addr = sspi->dma_addr_rx;
+		conf.src_addr_width = DMA_SLAVE_BUSWIDTH_1_BYTE;
+		conf.src_maxburst = 8;
+	} else {
+		conf.dst_addr = sspi->dma_addr_tx;
+		conf.dst_addr_width = DMA_SLAVE_BUSWIDTH_1_BYTE;
+		conf.dst_maxburst = 8;
+	}
 
-	/* Reset FIFO */
-	sun6i_spi_write(sspi, SUN6I_FIFO_CTL_REG,
-			SUN6I_FIFO_CTL_RF_RST | SUN6I_FIFO_CTL_TF_RST);
+	ret = dmaengine_slave_config(chan, &conf);
+	if (ret)
+		return NULL;
 
-	/*
-	 * Setup FIFO interrupt trigger level
-	 * Here we choose 3/4 of the full fifo depth, as it's the hardcoded
-	 * value used in old generation of Allwinner SPI controller.
-	 * (See spi-sun4i.c)
-	 */
-	trig_level = sspi->fifo_depth / 4 * 3;
-	sun6i_spi_write(sspi, SUN6I_FIFO_CTL_REG,
-			(trig_level << SUN6I_FIFO_CTL_RF_RDY_TRIG_LEVEL_BITS) |
-			(trig_level << SUN6I_FIFO_CTL_TF_ERQ_TRIG_LEVEL_BITS));
+	return dmaengine_prep_slave_sg(chan, sgt->sgl, sgt->nents, dir,
+				       DMA_PREP_INTERRUPT);
+}
+
+/*
+ * Queue the DMA transfers of a SPI transfer. When receiving, completion is
+ * signalled by the RX channel, since the transfer complete interrupt may
+ * fire before the last bytes are moved out of the RX FIFO.
+ */
+static int sun6i_spi_submit_dma(struct sun6i_spi *sspi,
+				struct sg_table *tx_sgt, struct sg_table *rx_sgt)
+{
+	struct spi_master *master = sspi->master;
+	struct dma_async_tx_descriptor *rxdesc = NULL, *txdesc = NULL;
+
+	if (rx_sgt) {
+		rxdesc = sun6i_spi_prep_dma(sspi, master->dma_rx, rx_sgt,
+					    DMA_DEV_TO_MEM);
+		if (!rxdesc)
+			return -EINVAL;
+		rxdesc->callback = sun6i_spi_dma_rx_cb;
+		rxdesc->callback_param = sspi;
+	}
+
+	if (tx_sgt) {
+		txdesc = sun6i_spi_prep_dma(sspi, master->dma_tx, tx_sgt,
+					    DMA_MEM_TO_DEV);
+		if (!txdesc) {
+			if (rxdesc)
+				dmaengine_terminate_sync(master->dma_rx);
+			return -EINVAL;
+		}
+	}
+
+	if (rxdesc) {
+		dmaengine_submit(rxdesc);
+		dma_async_issue_pending(master->dma_rx);
+	}
+
+	if (txdesc) {
+		dmaengine_submit(txdesc);
+		dma_async_issue_pending(master->dma_tx);
+	}
+
+	return 0;
+}
+
+static bool sun6i_spi_can_dma(struct spi_master *master,
+			      struct spi_device *spi,
+			      struct spi_transfer *xfer)
+{
+	struct sun6i_spi *sspi = spi_master_get_devdata(master);
 
 	/*
-	 * Setup the transfer control register: Chip Select,
-	 * polarities, etc.
+	 * If the transfer fits in the FIFO, we can just fill it and wait
+	 * for a single interrupt, so don't bother setting up the DMA.
 	 */
+	return xfer->len > sspi->fifo_depth;
+}
+
+/*
+ * Setup the transfer control register: Chip Select, polarities, etc.
+ * If discard_rx is set, what is received while transmitting is not
+ * stored in the RX FIFO.
+ */
+static void sun6i_spi_setup_mode(struct sun6i_spi *sspi,
+				 struct spi_device *spi, bool discard_rx)
+{
+	u32 reg;
+
 	reg = sun6i_spi_read(sspi, SUN6I_TFR_CTL_REG);
 
 	if (spi->mode & SPI_CPOL)
@@ -256,24 +320,26 @@ static int sun6i_spi_transfer_one(struct spi_master *master,
 	else
 		reg &= ~SUN6I_TFR_CTL_FBS;
 
-	/*
-	 * If it's a TX only transfer, we don't want to fill the RX
-	 * FIFO with bogus data
-	 */
-	if (sspi->rx_buf)
-		reg &= ~SUN6I_TFR_CTL_DHB;
-	else
+	if (discard_rx)
 		reg |= SUN6I_TFR_CTL_DHB;
+	else
+		reg &= ~SUN6I_TFR_CTL_DHB;
 
 	/* We want to control the chip select manually */
 	reg |= SUN6I_TFR_CTL_CS_MANUAL;
 
 	sun6i_spi_write(sspi, SUN6I_TFR_CTL_REG, reg);
+}
+
+static void sun6i_spi_setup_clock(struct sun6i_spi *sspi, u32 speed_hz)
+{
+	unsigned int mclk_rate, div;
+	u32 reg;
 
 	/* Ensure that we have a parent clock fast enough */
 	mclk_rate = clk_get_rate(sspi->mclk);
-	if (mclk_rate < (2 * tfr->speed_hz)) {
-		clk_set_rate(sspi->mclk, 2 * tfr->speed_hz);
+	if (mclk_rate < (2 * speed_hz)) {
+		clk_set_rate(sspi->mclk, 2 * speed_hz);
 		mclk_rate = clk_get_rate(sspi->mclk);
 	}
 
@@ -291,63 +357,274 @@ static int sun6i_spi_transfer_one(struct spi_master *master,
 	 * First try CDR2, and if we can't reach the expected
 	 * frequency, fall back to CDR1.
 	 */
-	div = mclk_rate / (2 * tfr->speed_hz);
+	div = mclk_rate / (2 * speed_hz);
 	if (div <= (SUN6I_CLK_CTL_CDR2_MASK + 1)) {
 		if (div > 0)
 			div--;
 
 		reg = SUN6I_CLK_CTL_CDR2(div) | SUN6I_CLK_CTL_DRS;
 	} else {
-		div = ilog2(mclk_rate) - ilog2(tfr->speed_hz);
+		div = ilog2(mclk_rate) - ilog2(speed_hz);
 		reg = SUN6I_CLK_CTL_CDR1(div);
 	}
 
 	sun6i_spi_write(sspi, SUN6I_CLK_CTL_REG, reg);
+}
 
-	/* Setup the transfer now... */
-	if (sspi->tx_buf)
-		tx_len = tfr->len;
+/*
+ * Reset the FIFOs and setup their trigger levels.
+ * In PIO mode we choose 3/4 of the full fifo depth, as it's the hardcoded
+ * value used in old generation of Allwinner SPI controller.
+ * (See spi-sun4i.c)
+ * In DMA mode, the level is used as the DMA request trigger and we choose
+ * half of the fifo depth.
+ */
+static void sun6i_spi_setup_fifo(struct sun6i_spi *sspi, bool tx_dma,
+				 bool rx_dma)
+{
+	unsigned int trig_level;
+	u32 reg = 0;
 
-	/* Setup the counters */
-	sun6i_spi_write(sspi, SUN6I_BURST_CNT_REG, SUN6I_BURST_CNT(tfr->len));
-	sun6i_spi_write(sspi, SUN6I_XMIT_CNT_REG, SUN6I_XMIT_CNT(tx_len));
-	sun6i_spi_write(sspi, SUN6I_BURST_CTL_CNT_REG,
-			SUN6I_BURST_CTL_CNT_STC(tx_len));
+	sun6i_spi_write(sspi, SUN6I_FIFO_CTL_REG,
+			SUN6I_FIFO_CTL_RF_RST | SUN6I_FIFO_CTL_TF_RST);
 
-	/* Fill the TX FIFO */
-	sun6i_spi_fill_fifo(sspi, sspi->fifo_depth);
+	if (tx_dma || rx_dma)
+		trig_level = sspi->fifo_depth / 2;
+	else
+		trig_level = sspi->fifo_depth / 4 * 3;
 
-	/* Enable the interrupts */
-	sun6i_spi_write(sspi, SUN6I_INT_CTL_REG, SUN6I_INT_CTL_TC);
-	sun6i_spi_enable_interrupt(sspi, SUN6I_INT_CTL_TC |
-					 SUN6I_INT_CTL_RF_RDY);
-	if (tx_len > sspi->fifo_depth)
-		sun6i_spi_enable_interrupt(sspi, SUN6I_INT_CTL_TF_ERQ);
+	if (tx_dma)
+		reg |= SUN6I_FIFO_CTL_TF_DRQ_EN;
+	if (rx_dma)
+		reg |= SUN6I_FIFO_CTL_RF_DRQ_EN;
+
+	sun6i_spi_write(sspi, SUN6I_FIFO_CTL_REG, reg |
+			(trig_level << SUN6I_FIFO_CTL_RF_RDY_TRIG_LEVEL_BITS) |
+			(trig_level << SUN6I_FIFO_CTL_TF_ERQ_TRIG_LEVEL_BITS));
+}
+
+/* Start the transfer and wait for its completion */
+static int sun6i_spi_run(struct sun6i_spi *sspi, struct spi_device *spi,
+			 unsigned int len, u32 speed_hz, bool dma)
+{
+	struct spi_master *master = sspi->master;
+	unsigned int start, end, tx_time;
+	unsigned int timeout;
+	u32 reg;
 
-	/* Start the transfer */
 	reg = sun6i_spi_read(sspi, SUN6I_TFR_CTL_REG);
 	sun6i_spi_write(sspi, SUN6I_TFR_CTL_REG, reg | SUN6I_TFR_CTL_XCH);
 
-	tx_time = max(tfr->len * 8 * 2 / (tfr->speed_hz / 1000), 100U);
+	tx_time = max(len * 8 * 2 / (speed_hz / 1000), 100U);
 	start = jiffies;
 	timeout = wait_for_completion_timeout(&sspi->done,
 					      msecs_to_jiffies(tx_time));
 	end = jiffies;
+
+	sun6i_spi_write(sspi, SUN6I_INT_CTL_REG, 0);
+
 	if (!timeout) {
 		dev_warn(&master->dev,
 			 "%s: timeout transferring %u bytes@%iHz for %i(%i)ms",
-			 dev_name(&spi->dev), tfr->len, tfr->speed_hz,
+			 dev_name(&spi->dev), len, speed_hz,
 			 jiffies_to_msecs(end - start), tx_time);
-		ret = -ETIMEDOUT;
-		goto out;
+		if (dma) {
+			dmaengine_terminate_sync(master->dma_rx);
+			dmaengine_terminate_sync(master->dma_tx);
+		}
+		return -ETIMEDOUT;
 	}
 
+	return 0;
+}
+
+static int sun6i_spi_transfer_one(struct spi_master *master,
+				  struct spi_device *spi,
+				  struct spi_transfer *tfr)
+{
+	struct sun6i_spi *sspi = spi_master_get_devdata(master);
+	unsigned int tx_len = 0;
+	bool use_dma;
+	int ret = 0;
+	u32 reg;
+
+	if (tfr->len > SUN6I_MAX_XFER_SIZE)
+		return -EINVAL;
+
+	use_dma = master->can_dma && master->can_dma(master, spi, tfr);
+
+	reinit_completion(&sspi->done);
+	sspi->tx_buf = tfr->tx_buf;
+	sspi->rx_buf = tfr->rx_buf;
+	sspi->len = tfr->len;
+
+	/* Clear pending interrupts */
+	sun6i_spi_write(sspi, SUN6I_INT_STA_REG, ~0);
+
+	sun6i_spi_setup_fifo(sspi, use_dma && tfr->tx_buf,
+			     use_dma && tfr->rx_buf);
+
+	/*
+	 * If it's a TX only transfer, we don't want to fill the RX
+	 * FIFO with bogus data
+	 */
+	sun6i_spi_setup_mode(sspi, spi, !sspi->rx_buf);
+	sun6i_spi_setup_clock(sspi, tfr->speed_hz);
+
+	/* Setup the transfer now... */
+	if (sspi->tx_buf)
+		tx_len = tfr->len;
+
+	/* Setup the counters */
+	sun6i_spi_write(sspi, SUN6I_BURST_CNT_REG, SUN6I_BURST_CNT(tfr->len));
+	sun6i_spi_write(sspi, SUN6I_XMIT_CNT_REG, SUN6I_XMIT_CNT(tx_len));
+	sun6i_spi_write(sspi, SUN6I_BURST_CTL_CNT_REG,
+			SUN6I_BURST_CTL_CNT_STC(tx_len));
+
+	if (use_dma) {
+		ret = sun6i_spi_submit_dma(sspi,
+					   tfr->tx_buf ? &tfr->tx_sg : NULL,
+					   tfr->rx_buf ? &tfr->rx_sg : NULL);
+		if (ret) {
+			dev_warn(&master->dev,
+				 "%s: DMA setup failed, using PIO\n",
+				 dev_name(&spi->dev));
+			use_dma = false;
+			sun6i_spi_setup_fifo(sspi, false, false);
+		}
+	}
+
+	if (use_dma) {
+		/* The RX channel callback completes DMA receptions */
+		reg = tfr->rx_buf ? 0 : SUN6I_INT_CTL_TC;
+	} else {
+		/* Fill the TX FIFO */
+		sun6i_spi_fill_fifo(sspi, sspi->fifo_depth);
+
+		reg = SUN6I_INT_CTL_TC | SUN6I_INT_CTL_RF_RDY;
+		if (tx_len > sspi->fifo_depth)
+			reg |= SUN6I_INT_CTL_TF_ERQ;
+	}
+
+	/* Enable the interrupts */
+	sun6i_spi_write(sspi, SUN6I_INT_CTL_REG, reg);
+
+	return sun6i_spi_run(sspi, spi, tfr->len, tfr->speed_hz, use_dma);
+}
+
+/*
+ * Assert or deassert the chip select of a spi-mem device, as the core
+ * would do around a message.
+ */
+static void sun6i_spi_mem_set_cs(struct spi_device *spi, bool assert)
+{
+	bool level = !!(spi->mode & SPI_CS_HIGH);
+
+	sun6i_spi_set_cs(spi, assert ? level : !level);
+}
+
+static int sun6i_spi_mem_adjust_op_size(struct spi_mem *mem,
+					struct spi_mem_op *op)
+{
+	unsigned int len = 1 + op->addr.nbytes + op->dummy.nbytes;
+
+	if (op->data.nbytes > SUN6I_MAX_XFER_SIZE - 1 - len)
+		op->data.nbytes = SUN6I_MAX_XFER_SIZE - 1 - len;
+
+	return 0;
+}
+
+/*
+ * Memory reads are issued as a single burst: the opcode, address and dummy
+ * bytes are pushed in the TX FIFO and the controller clocks the data in
+ * right after, with the RX FIFO emptied by DMA when available.
+ * Everything else is left to the generic transfer based implementation.
+ */
+static int sun6i_spi_mem_exec_op(struct spi_mem *mem,
+				 const struct spi_mem_op *op)
+{
+	struct spi_device *spi = mem->spi;
+	struct spi_master *master = spi->master;
+	struct sun6i_spi *sspi = spi_master_get_devdata(master);
+	unsigned int hdr_len = 1 + op->addr.nbytes + op->dummy.nbytes;
+	u32 speed_hz = spi->max_speed_hz;
+	u8 hdr[SUN6I_FIFO_DEPTH];
+	struct sg_table sgt;
+	bool use_dma;
+	int i, ret;
+
+	if (op->data.dir != SPI_MEM_DATA_IN || !op->data.nbytes)
+		return -ENOTSUPP;
+
+	if (hdr_len > sspi->fifo_depth ||
+	    op->data.nbytes > SUN6I_MAX_XFER_SIZE - 1 - hdr_len)
+		return -ENOTSUPP;
+
+	hdr[0] = op->cmd.opcode;
+	for (i = 0; i < op->addr.nbytes; i++)
+		hdr[1 + i] = op->addr.val >> (8 * (op->addr.nbytes - i - 1));
+	memset(hdr + 1 + op->addr.nbytes, 0xff, op->dummy.nbytes);
+
+	use_dma = master->dma_rx && op->data.nbytes > sspi->fifo_depth;
+	if (use_dma) {
+		ret = spi_controller_dma_map_mem_op_data(master, op, &sgt);
+		if (ret)
+			use_dma = false;
+	}
+
+	if (speed_hz > master->max_speed_hz)
+		speed_hz = master->max_speed_hz;
+
+	reinit_completion(&sspi->done);
+	sspi->tx_buf = hdr;
+	sspi->rx_buf = op->data.buf.in;
+	sspi->len = hdr_len;
+
+	sun6i_spi_mem_set_cs(spi, true);
+
+	sun6i_spi_write(sspi, SUN6I_INT_STA_REG, ~0);
+	sun6i_spi_setup_fifo(sspi, false, use_dma);
+
+	/* Drop what is received while the header is sent */
+	sun6i_spi_setup_mode(sspi, spi, true);
+	sun6i_spi_setup_clock(sspi, speed_hz);
+
+	sun6i_spi_write(sspi, SUN6I_BURST_CNT_REG,
+			SUN6I_BURST_CNT(hdr_len + op->data.nbytes));
+	sun6i_spi_write(sspi, SUN6I_XMIT_CNT_REG, SUN6I_XMIT_CNT(hdr_len));
+	sun6i_spi_write(sspi, SUN6I_BURST_CTL_CNT_REG,
+			SUN6I_BURST_CTL_CNT_STC(hdr_len));
+
+	if (use_dma) {
+		ret = sun6i_spi_submit_dma(sspi, NULL, &sgt);
+		if (ret)
+			goto out;
+	}
+
+	sun6i_spi_fill_fifo(sspi, sspi->fifo_depth);
+
+	if (use_dma)
+		sun6i_spi_write(sspi, SUN6I_INT_CTL_REG, 0);
+	else
+		sun6i_spi_write(sspi, SUN6I_INT_CTL_REG,
+				SUN6I_INT_CTL_TC | SUN6I_INT_CTL_RF_RDY);
+
+	ret = sun6i_spi_run(sspi, spi, hdr_len + op->data.nbytes, speed_hz,
+			    use_dma);
+
 out:
-	sun6i_spi_write(sspi, SUN6I_INT_CTL_REG, 0);
+	sun6i_spi_mem_set_cs(spi, false);
+	if (use_dma)
+		spi_controller_dma_unmap_mem_op_data(master, op, &sgt);
 
 	return ret;
 }
 
+static const struct spi_controller_mem_ops sun6i_spi_mem_ops = {
+	.adjust_op_size	= sun6i_spi_mem_adjust_op_size,
+	.exec_op	= sun6i_spi_mem_exec_op,
+};
+
 static irqreturn_t sun6i_spi_handler(int irq, void *dev_id)
 {
 	struct sun6i_spi *sspi = dev_id;
@@ -485,6 +762,7 @@ static int sun6i_spi_probe(struct platform_device *pdev)
 	master->dev.of_node = pdev->dev.of_node;
 	master->auto_runtime_pm = true;
 	master->max_transfer_size = sun6i_spi_max_transfer_size;
+	master->mem_ops = &sun6i_spi_mem_ops;
 
 	sspi->hclk = devm_clk_get(&pdev->dev, "ahb");
 	if (IS_ERR(sspi->hclk)) {
@@ -509,6 +787,33 @@ static int sun6i_spi_probe(struct platform_device *pdev)
 		goto err_free_master;
 	}
 
+	master->dma_tx = dma_request_slave_channel_reason(&pdev->dev, "tx");
+	if (IS_ERR(master->dma_tx)) {
+		/* Check tx to see if we need defer probing driver */
+		if (PTR_ERR(master->dma_tx) == -EPROBE_DEFER) {
+			ret = -EPROBE_DEFER;
+			goto err_free_master;
+		}
+		dev_warn(&pdev->dev, "Failed to request TX DMA channel\n");
+		master->dma_tx = NULL;
+	}
+
+	master->dma_rx = dma_request_slave_channel_reason(&pdev->dev, "rx");
+	if (IS_ERR(master->dma_rx)) {
+		if (PTR_ERR(master->dma_rx) == -EPROBE_DEFER) {
+			ret = -EPROBE_DEFER;
+			goto err_free_dma_tx;
+		}
+		dev_warn(&pdev->dev, "Failed to request RX DMA channel\n");
+		master->dma_rx = NULL;
+	}
+
+	if (master->dma_tx && master->dma_rx) {
+		sspi->dma_addr_tx = res->start + SUN6I_TXDATA_REG;
+		sspi->dma_addr_rx = res->start + SUN6I_RXDATA_REG;
+		master->can_dma = sun6i_spi_can_dma;
+	}
+
 	/*
 	 * This wake-up/shutdown pattern is to be able to have the
 	 * device woken up, even if runtime_pm is disabled
@@ -516,7 +821,7 @@ static int sun6i_spi_probe(struct platform_device *pdev)
 	ret = sun6i_spi_runtime_resume(&pdev->dev);
 	if (ret) {
 		dev_err(&pdev->dev, "Couldn't resume the device\n");
-		goto err_free_master;
+		goto err_free_dma_rx;
 	}
 
 	pm_runtime_set_active(&pdev->dev);
@@ -534,6 +839,12 @@ static int sun6i_spi_probe(struct platform_device *pdev)
 err_pm_disable:
 	pm_runtime_disable(&pdev->dev);
 	sun6i_spi_runtime_suspend(&pdev->dev);
+err_free_dma_rx:
+	if (master->dma_rx)
+		dma_release_channel(master->dma_rx);
+err_free_dma_tx:
+	if (master->dma_tx)
+		dma_release_channel(master->dma_tx);
 err_free_master:
 	spi_master_put(master);
 	return ret;
@@ -541,8 +852,15 @@ static int sun6i_spi_probe(struct platform_device *pdev)
 
 static int sun6i_spi_remove(struct platform_device *pdev)
 {
+	struct spi_master *master = platform_get_drvdata(pdev);
+
 	pm_runtime_force_suspend(&pdev->dev);
 
+	if (master->dma_tx)
+		dma_release_channel(master->dma_tx);
+	if (master->dma_rx)
+		dma_release_channel(master->dma_rx);
+
 	return 0;
 }
 
@@ -317,20 +317,68 @@ static unsigned len_args(unsigned numargs, struct fuse_arg *args)
 	return nbytes;
 }
 
+/*
+ * Each input queue hands out ids from its own residue class (see
+ * fuse_bind_queue()), so they stay unique across the queues of a connection.
+ */
 static u64 fuse_get_unique(struct fuse_iqueue *fiq)
 {
-	return ++fiq->reqctr;
+	fiq->reqctr += nr_cpu_ids + 1;
+	return fiq->reqctr;
 }
 
 static void queue_request(struct fuse_iqueue *fiq, struct fuse_req *req)
 {
 	req->in.h.len = sizeof(struct fuse_in_header) +
 		len_args(req->in.numargs, (struct fuse_arg *) req->in.args);
+	req->fiq = fiq;
 	list_add_tail(&req->list, &fiq->pending);
 	wake_up_locked(&fiq->waitq);
 	kill_fasync(&fiq->fasync, SIGIO, POLL_IN);
 }
 
+/*
+ * Lock the input queue for a new synchronous request: the queue of the
+ * current CPU if a device serves it, the shared queue otherwise.
+ */
+static struct fuse_iqueue *fuse_lock_iqueue(struct fuse_conn *fc)
+{
+	struct fuse_iqueue __percpu *iqs = READ_ONCE(fc->iqs);
+	struct fuse_iqueue *fiq;
+
+	if (iqs) {
+		fiq = raw_cpu_ptr(iqs);
+		if (READ_ONCE(fiq->nr_readers)) {
+			spin_lock(&fiq->waitq.lock);
+			if (fiq->nr_readers)
+				return fiq;
+			spin_unlock(&fiq->waitq.lock);
+		}
+	}
+
+	fiq = &fc->iq;
+	spin_lock(&fiq->waitq.lock);
+	return fiq;
+}
+
+/*
+ * Lock the input queue a request was queued on.  Requests are moved to the
+ * shared queue when the last device serving a per-CPU queue goes away, so
+ * recheck req->fiq once the lock is held.
+ */
+static struct fuse_iqueue *lock_req_iqueue(struct fuse_req *req)
+{
+	struct fuse_iqueue *fiq;
+
+	for (;;) {
+		fiq = READ_ONCE(req->fiq);
+		spin_lock(&fiq->waitq.lock);
+		if (fiq == req->fiq)
+			return fiq;
+		spin_unlock(&fiq->waitq.lock);
+	}
+}
+
 void fuse_queue_forget(struct fuse_conn *fc, struct fuse_forget_link *forget,
 		       u64 nodeid, u64 nlookup)
 {
@@ -378,14 +426,17 @@ static void flush_bg_queue(struct fuse_conn *fc)
  */
 static void request_end(struct fuse_conn *fc, struct fuse_req *req)
 {
-	struct fuse_iqueue *fiq = &fc->iq;
+	struct fuse_iqueue *fiq;
 
 	if (test_and_set_bit(FR_FINISHED, &req->flags))
 		goto put_request;
 
-	spin_lock(&fiq->waitq.lock);
-	list_del_init(&req->intr_entry);
-	spin_unlock(&fiq->waitq.lock);
+	/* Requests which were never queued can't be on an interrupt list */
+	if (req->fiq) {
+		fiq = lock_req_iqueue(req);
+		list_del_init(&req->intr_entry);
+		spin_unlock(&fiq->waitq.lock);
+	}
 	WARN_ON(test_bit(FR_PENDING, &req->flags));
 	WARN_ON(test_bit(FR_SENT, &req->flags));
 	if (test_bit(FR_BACKGROUND, &req->flags)) {
@@ -414,9 +465,10 @@ static void request_end(struct fuse_conn *fc, struct fuse_req *req)
 	fuse_put_request(fc, req);
 }
 
-static void queue_interrupt(struct fuse_iqueue *fiq, struct fuse_req *req)
+static void queue_interrupt(struct fuse_req *req)
 {
-	spin_lock(&fiq->waitq.lock);
+	struct fuse_iqueue *fiq = lock_req_iqueue(req);
+
 	if (test_bit(FR_FINISHED, &req->flags)) {
 		spin_unlock(&fiq->waitq.lock);
 		return;
@@ -431,7 +483,7 @@ static void queue_interrupt(struct fuse_iqueue *fiq, struct fuse_req *req)
 
 static void request_wait_answer(struct fuse_conn *fc, struct fuse_req *req)
 {
-	struct fuse_iqueue *fiq = &fc->iq;
+	struct fuse_iqueue *fiq;
 	int err;
 
 	if (!fc->no_interrupt) {
@@ -445,7 +497,7 @@ static void request_wait_answer(struct fuse_conn *fc, struct fuse_req *req)
 		/* matches barrier in fuse_dev_do_read() */
 		smp_mb__after_atomic();
 		if (test_bit(FR_SENT, &req->flags))
-			queue_interrupt(fiq, req);
+			queue_interrupt(req);
 	}
 
 	if (!test_bit(FR_FORCE, &req->flags)) {
@@ -455,7 +507,7 @@ static void request_wait_answer(struct fuse_conn *fc, struct fuse_req *req)
 		if (!err)
 			return;
 
-		spin_lock(&fiq->waitq.lock);
+		fiq = lock_req_iqueue(req);
 		/* Request is not yet in userspace, bail out */
 		if (test_bit(FR_PENDING, &req->flags)) {
 			list_del(&req->list);
@@ -476,10 +528,10 @@ static void request_wait_answer(struct fuse_conn *fc, struct fuse_req *req)
 
 static void __fuse_request_send(struct fuse_conn *fc, struct fuse_req *req)
 {
-	struct fuse_iqueue *fiq = &fc->iq;
+	struct fuse_iqueue *fiq;
 
 	BUG_ON(test_bit(FR_BACKGROUND, &req->flags));
-	spin_lock(&fiq->waitq.lock);
+	fiq = fuse_lock_iqueue(fc);
 	if (!fiq->connected) {
 		spin_unlock(&fiq->waitq.lock);
 		req->out.h.error = -ENOTCONN;
@@ -1233,7 +1285,7 @@ static ssize_t fuse_dev_do_read(struct fuse_dev *fud, struct file *file,
 {
 	ssize_t err;
 	struct fuse_conn *fc = fud->fc;
-	struct fuse_iqueue *fiq = &fc->iq;
+	struct fuse_iqueue *fiq = fud->fiq;
 	struct fuse_pqueue *fpq = &fud->pq;
 	struct fuse_req *req;
 	struct fuse_in *in;
@@ -1316,7 +1368,7 @@ static ssize_t fuse_dev_do_read(struct fuse_dev *fud, struct file *file,
 	/* matches barrier in request_wait_answer() */
 	smp_mb__after_atomic();
 	if (test_bit(FR_INTERRUPTED, &req->flags))
-		queue_interrupt(fiq, req);
+		queue_interrupt(req);
 
 	return reqsize;
 
@@ -1884,7 +1936,7 @@ static ssize_t fuse_dev_do_write(struct fuse_dev *fud,
 		if (oh.error == -ENOSYS)
 			fc->no_interrupt = 1;
 		else if (oh.error == -EAGAIN)
-			queue_interrupt(&fc->iq, req);
+			queue_interrupt(req);
 
 		fuse_copy_finish(cs);
 		return nbytes;
@@ -2030,7 +2082,7 @@ static __poll_t fuse_dev_poll(struct file *file, poll_table *wait)
 	if (!fud)
 		return EPOLLERR;
 
-	fiq = &fud->fc->iq;
+	fiq = fud->fiq;
 	poll_wait(file, &fiq->waitq, wait);
 
 	spin_lock(&fiq->waitq.lock);
@@ -2093,10 +2145,28 @@ static void end_polls(struct fuse_conn *fc)
  * is OK, the request will in that case be removed from the list before we touch
  * it.
  */
-void fuse_abort_conn(struct fuse_conn *fc, bool is_abort)
+/*
+ * Disconnect an input queue, moving its pending requests to @to_end.
+ */
+static void fuse_iqueue_abort(struct fuse_iqueue *fiq,
+			      struct list_head *to_end)
 {
-	struct fuse_iqueue *fiq = &fc->iq;
+	struct fuse_req *req;
+
+	spin_lock(&fiq->waitq.lock);
+	fiq->connected = 0;
+	list_for_each_entry(req, &fiq->pending, list)
+		clear_bit(FR_PENDING, &req->flags);
+	list_splice_tail_init(&fiq->pending, to_end);
+	while (forget_pending(fiq))
+		kfree(dequeue_forget(fiq, 1, NULL));
+	wake_up_all_locked(&fiq->waitq);
+	spin_unlock(&fiq->waitq.lock);
+	kill_fasync(&fiq->fasync, SIGIO, POLL_IN);
+}
 
+void fuse_abort_conn(struct fuse_conn *fc, bool is_abort)
+{
 	spin_lock(&fc->lock);
 	if (fc->connected) {
 		struct fuse_dev *fud;
@@ -2129,16 +2199,14 @@ void fuse_abort_conn(struct fuse_conn *fc, bool is_abort)
 		fc->max_background = UINT_MAX;
 		flush_bg_queue(fc);
 
-		spin_lock(&fiq->waitq.lock);
-		fiq->connected = 0;
-		list_for_each_entry(req, &fiq->pending, list)
-			clear_bit(FR_PENDING, &req->flags);
-		list_splice_tail_init(&fiq->pending, &to_end);
-		while (forget_pending(fiq))
-			kfree(dequeue_forget(fiq, 1, NULL));
-		wake_up_all_locked(&fiq->waitq);
-		spin_unlock(&fiq->waitq.lock);
-		kill_fasync(&fiq->fasync, SIGIO, POLL_IN);
+		fuse_iqueue_abort(&fc->iq, &to_end);
+		if (fc->iqs) {
+			int cpu;
+
+			for_each_possible_cpu(cpu)
+				fuse_iqueue_abort(per_cpu_ptr(fc->iqs, cpu),
+						  &to_end);
+		}
 		end_polls(fc);
 		wake_up_all(&fc->blocked_waitq);
 		spin_unlock(&fc->lock);
@@ -2155,6 +2223,59 @@ void fuse_wait_aborted(struct fuse_conn *fc)
 	wait_event(fc->blocked_waitq, atomic_read(&fc->num_waiting) == 0);
 }
 
+/*
+ * Stop serving a per-CPU input queue.  When its last device goes away, hand
+ * whatever is still queued there over to the shared queue.
+ */
+static void fuse_unbind_queue(struct fuse_dev *fud)
+{
+	struct fuse_iqueue *fiq = fud->fiq;
+	struct fuse_iqueue *shared = &fud->fc->iq;
+	struct fuse_req *req;
+
+	if (fiq == shared)
+		return;
+
+	spin_lock(&fiq->waitq.lock);
+	if (--fiq->nr_readers == 0 &&
+	    (!list_empty(&fiq->pending) || !list_empty(&fiq->interrupts))) {
+		spin_lock_nested(&shared->waitq.lock, SINGLE_DEPTH_NESTING);
+		list_for_each_entry(req, &fiq->pending, list)
+			req->fiq = shared;
+		list_for_each_entry(req, &fiq->interrupts, intr_entry)
+			req->fiq = shared;
+		list_splice_tail_init(&fiq->pending, &shared->pending);
+		list_splice_tail_init(&fiq->interrupts, &shared->interrupts);
+		wake_up_all_locked(&shared->waitq);
+		spin_unlock(&shared->waitq.lock);
+		kill_fasync(&shared->fasync, SIGIO, POLL_IN);
+	}
+	spin_unlock(&fiq->waitq.lock);
+	fud->fiq = shared;
+}
+
+/*
+ * Background requests, FORGETs and notify replies are only ever queued on the
+ * shared queue, so some other device must keep reading it.
+ */
+static bool fuse_shared_queue_served(struct fuse_dev *fud)
+{
+	struct fuse_conn *fc = fud->fc;
+	struct fuse_dev *other;
+	bool served = false;
+
+	spin_lock(&fc->lock);
+	list_for_each_entry(other, &fc->devices, entry) {
+		if (other != fud && other->fiq == &fc->iq) {
+			served = true;
+			break;
+		}
+	}
+	spin_unlock(&fc->lock);
+
+	return served;
+}
+
 int fuse_dev_release(struct inode *inode, struct file *file)
 {
 	struct fuse_dev *fud = fuse_get_dev(file);
@@ -2163,6 +2284,19 @@ int fuse_dev_release(struct inode *inode, struct file *file)
 		struct fuse_conn *fc = fud->fc;
 		struct fuse_pqueue *fpq = &fud->pq;
 		LIST_HEAD(to_end);
+		bool orphaned;
+
+		/*
+		 * If the devices left are all bound to per-CPU queues, nothing
+		 * would read the shared queue any more.  fuse_mutex orders this
+		 * against fuse_bind_queue(), which stops counting us once
+		 * fud->fiq is cleared.
+		 */
+		mutex_lock(&fuse_mutex);
+		orphaned = fud->fiq == &fc->iq && !fuse_shared_queue_served(fud);
+		fuse_unbind_queue(fud);
+		fud->fiq = NULL;
+		mutex_unlock(&fuse_mutex);
 
 		spin_lock(&fpq->lock);
 		WARN_ON(!list_empty(&fpq->io));
@@ -2175,6 +2309,8 @@ int fuse_dev_release(struct inode *inode, struct file *file)
 		if (atomic_dec_and_test(&fc->dev_count)) {
 			WARN_ON(fc->iq.fasync != NULL);
 			fuse_abort_conn(fc, false);
+		} else if (orphaned) {
+			fuse_abort_conn(fc, false);
 		}
 		fuse_dev_free(fud);
 	}
@@ -2185,12 +2321,39 @@ EXPORT_SYMBOL_GPL(fuse_dev_release);
 static int fuse_dev_fasync(int fd, struct file *file, int on)
 {
 	struct fuse_dev *fud = fuse_get_dev(file);
+	int err;
 
 	if (!fud)
 		return -EPERM;
 
-	/* No locking - fasync_helper does its own locking */
-	return fasync_helper(fd, file, on, &fud->fc->iq.fasync);
+	/*
+	 * fasync_helper does its own locking, fuse_mutex keeps fud->fiq from
+	 * being rebound under us.
+	 */
+	mutex_lock(&fuse_mutex);
+	err = fasync_helper(fd, file, on, &fud->fiq->fasync);
+	mutex_unlock(&fuse_mutex);
+
+	return err;
+}
+
+/* Whether @file asked for SIGIO on @fiq, must hold fuse_mutex */
+static bool fuse_fasync_registered(struct fuse_iqueue *fiq, struct file *file)
+{
+	struct fasync_struct *fa;
+	bool found = false;
+
+	rcu_read_lock();
+	for (fa = rcu_dereference(fiq->fasync); fa;
+	     fa = rcu_dereference(fa->fa_next)) {
+		if (fa->fa_file == file) {
+			found = true;
+			break;
+		}
+	}
+	rcu_read_unlock();
+
+	return found;
 }
 
 static int fuse_device_clone(struct fuse_conn *fc, struct file *new)
@@ -2210,12 +2373,82 @@ static int fuse_device_clone(struct fuse_conn *fc, struct file *new)
 	return 0;
 }
 
+/*
+ * Make a device serve the input queue of @cpu.  The per-CPU queues are
+ * allocated on first use; queue n hands out request ids congruent to n + 1
+ * modulo nr_cpu_ids + 1, the shared queue those congruent to 0.
+ */
+static int fuse_bind_queue(struct file *file, struct fuse_dev *fud, u32 cpu)
+{
+	struct fuse_conn *fc = fud->fc;
+	struct fuse_iqueue __percpu *iqs;
+	struct fuse_iqueue *fiq;
+	int i;
+
+	if (cpu >= nr_cpu_ids || !cpu_possible(cpu))
+		return -EINVAL;
+
+	if (fud->fiq != &fc->iq)
+		return -EBUSY;
+
+	/* The SIGIO registration would be left behind on the shared queue */
+	if (fuse_fasync_registered(&fc->iq, file))
+		return -EBUSY;
+
+	if (!fuse_shared_queue_served(fud))
+		return -EBUSY;
+
+	if (!READ_ONCE(fc->iqs)) {
+		iqs = alloc_percpu(struct fuse_iqueue);
+		if (!iqs)
+			return -ENOMEM;
+
+		for_each_possible_cpu(i) {
+			fiq = per_cpu_ptr(iqs, i);
+			fuse_iqueue_init(fiq);
+			fiq->reqctr = i + 1;
+		}
+
+		spin_lock(&fc->lock);
+		if (!fc->iqs) {
+			for_each_possible_cpu(i)
+				per_cpu_ptr(iqs, i)->connected = fc->connected;
+			/* Pairs with READ_ONCE() in fuse_lock_iqueue() */
+			smp_store_release(&fc->iqs, iqs);
+			iqs = NULL;
+		}
+		spin_unlock(&fc->lock);
+		free_percpu(iqs);
+	}
+
+	fiq = per_cpu_ptr(fc->iqs, cpu);
+	spin_lock(&fiq->waitq.lock);
+	fiq->nr_readers++;
+	spin_unlock(&fiq->waitq.lock);
+	fud->fiq = fiq;
+
+	return 0;
+}
+
 static long fuse_dev_ioctl(struct file *file, unsigned int cmd,
 			   unsigned long arg)
 {
 	int err = -ENOTTY;
 
-	if (cmd == FUSE_DEV_IOC_CLONE) {
+	if (cmd == FUSE_DEV_IOC_BIND_QUEUE) {
+		struct fuse_dev *fud = fuse_get_dev(file);
+		u32 cpu;
+
+		err = -EPERM;
+		if (fud && file->f_op == &fuse_dev_operations) {
+			err = -EFAULT;
+			if (!get_user(cpu, (__u32 __user *) arg)) {
+				mutex_lock(&fuse_mutex);
+				err = fuse_bind_queue(file, fud, cpu);
+				mutex_unlock(&fuse_mutex);
+			}
+		}
+	} else if (cmd == FUSE_DEV_IOC_CLONE) {
 		int oldfd;
 
 		err = -EFAULT;
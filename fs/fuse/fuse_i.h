@@ -308,6 +308,9 @@ struct fuse_req {
 	/** Entry on the interrupts list  */
 	struct list_head intr_entry;
 
+	/** Input queue the request was queued on */
+	struct fuse_iqueue *fiq;
+
 	/** refcount */
 	refcount_t count;
 
@@ -409,6 +412,9 @@ struct fuse_iqueue {
 
 	/** O_ASYNC requests */
 	struct fasync_struct *fasync;
+
+	/** Number of devices bound to this per-CPU queue */
+	unsigned nr_readers;
 };
 
 struct fuse_pqueue {
@@ -435,6 +441,9 @@ struct fuse_dev {
 	/** Processing queue */
 	struct fuse_pqueue pq;
 
+	/** Input queue read by this device (fc->iq unless bound to a CPU) */
+	struct fuse_iqueue *fiq;
+
 	/** list entry on fc->devices */
 	struct list_head entry;
 };
@@ -479,6 +488,9 @@ struct fuse_conn {
 	/** Input queue */
 	struct fuse_iqueue iq;
 
+	/** Per-CPU input queues, allocated on the first FUSE_DEV_IOC_BIND_QUEUE */
+	struct fuse_iqueue __percpu *iqs;
+
 	/** The next unique kernel file handle */
 	u64 khctr;
 
@@ -883,6 +895,11 @@ struct fuse_conn *fuse_conn_get(struct fuse_conn *fc);
  */
 void fuse_conn_init(struct fuse_conn *fc, struct user_namespace *user_ns);
 
+/**
+ * Initialize an input queue
+ */
+void fuse_iqueue_init(struct fuse_iqueue *fiq);
+
 /**
  * Release reference to fuse_conn
  */
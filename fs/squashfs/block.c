@@ -30,8 +30,9 @@
 #include <linux/vfs.h>
 #include <linux/slab.h>
 #include <linux/string.h>
-#include <linux/buffer_head.h>
 #include <linux/bio.h>
+#include <linux/blkdev.h>
+#include <linux/err.h>
 
 #include "squashfs_fs.h"
 #include "squashfs_fs_sb.h"
@@ -40,42 +41,186 @@
 #include "page_actor.h"
 
 /*
- * Read the metadata block length, this is stored in the first two
- * bytes of the metadata block.
+ * Copy an uncompressed block held in the pages of @bio, starting @offset
+ * bytes into its first segment, into the page actor.
  */
-static struct buffer_head *get_block_length(struct super_block *sb,
-			u64 *cur_index, int *offset, int *length)
+static int copy_bio_to_actor(struct bio *bio,
+			     struct squashfs_page_actor *actor,
+			     int offset, int req_length)
+{
+	void *actor_addr = squashfs_first_page(actor);
+	struct bio_vec *bvec;
+	int idx = 0, copied_bytes = 0, actor_offset = 0;
+
+	while (copied_bytes < req_length &&
+	       (bvec = squashfs_bio_next_segment(bio, &idx))) {
+		int in = min_t(int, bvec->bv_len - offset,
+			       req_length - copied_bytes);
+		void *data = page_address(bvec->bv_page) + bvec->bv_offset;
+
+		while (in) {
+			int avail;
+
+			if (actor_offset == PAGE_SIZE) {
+				actor_addr = squashfs_next_page(actor);
+				if (!actor_addr)
+					goto out;
+				actor_offset = 0;
+			}
+
+			avail = min_t(int, in, PAGE_SIZE - actor_offset);
+			memcpy(actor_addr + actor_offset, data + offset, avail);
+			in -= avail;
+			offset += avail;
+			actor_offset += avail;
+			copied_bytes += avail;
+		}
+		offset = 0;
+	}
+
+out:
+	squashfs_finish_page(actor);
+	return copied_bytes;
+}
+
+static void squashfs_bio_free(struct bio *bio)
+{
+	bio_free_pages(bio);
+	bio_put(bio);
+}
+
+/*
+ * Allocate a bio covering the device blocks which hold the @length bytes
+ * at byte @index of the filesystem.  The data starts *@block_offset bytes
+ * into the first page of the bio.
+ */
+static struct bio *squashfs_bio_alloc(struct super_block *sb, u64 index,
+				      int length, int *block_offset)
 {
 	struct squashfs_sb_info *msblk = sb->s_fs_info;
-	struct buffer_head *bh;
+	const u64 read_start = round_down(index, msblk->devblksize);
+	const sector_t block = read_start >> msblk->devblksize_log2;
+	const u64 read_end = round_up(index + length, msblk->devblksize);
+	int total_len = read_end - read_start;
+	const int page_count = DIV_ROUND_UP(total_len, PAGE_SIZE);
+	struct bio *bio;
+	int i;
 
-	bh = sb_bread(sb, *cur_index);
-	if (bh == NULL)
+	if (page_count <= BIO_MAX_PAGES)
+		bio = bio_alloc(GFP_NOIO, page_count);
+	else
+		bio = bio_kmalloc(GFP_NOIO, page_count);
+	if (!bio)
 		return NULL;
 
-	if (msblk->devblksize - *offset == 1) {
-		*length = (unsigned char) bh->b_data[*offset];
-		put_bh(bh);
-		bh = sb_bread(sb, ++(*cur_index));
-		if (bh == NULL)
+	bio_set_dev(bio, sb->s_bdev);
+	bio->bi_opf = REQ_OP_READ;
+	bio->bi_iter.bi_sector = block * (msblk->devblksize >> SECTOR_SHIFT);
+
+	for (i = 0; i < page_count; i++) {
+		unsigned int len = min_t(unsigned int, PAGE_SIZE, total_len);
+		struct page *page = alloc_page(GFP_NOIO);
+
+		if (!page || !bio_add_page(bio, page, len, 0)) {
+			if (page)
+				__free_page(page);
+			squashfs_bio_free(bio);
 			return NULL;
-		*length |= (unsigned char) bh->b_data[0] << 8;
-		*offset = 1;
-	} else {
-		*length = (unsigned char) bh->b_data[*offset] |
-			(unsigned char) bh->b_data[*offset + 1] << 8;
-		*offset += 2;
-
-		if (*offset == msblk->devblksize) {
-			put_bh(bh);
-			bh = sb_bread(sb, ++(*cur_index));
-			if (bh == NULL)
-				return NULL;
-			*offset = 0;
 		}
+		total_len -= len;
+	}
+
+	*block_offset = index & ((1 << msblk->devblksize_log2) - 1);
+	return bio;
+}
+
+/* Synchronously read @length bytes at byte @index of the filesystem */
+static struct bio *squashfs_bio_read(struct super_block *sb, u64 index,
+				     int length, int *block_offset)
+{
+	struct bio *bio = squashfs_bio_alloc(sb, index, length, block_offset);
+
+	if (!bio)
+		return NULL;
+
+	if (submit_bio_wait(bio)) {
+		squashfs_bio_free(bio);
+		return NULL;
+	}
+
+	return bio;
+}
+
+/*
+ * Decompress (or copy, if stored uncompressed) the block read into @bio
+ * into the page actor, and free the bio.
+ */
+static int squashfs_bio_to_actor(struct squashfs_sb_info *msblk,
+				 struct bio *bio, int offset, int length,
+				 int compressed,
+				 struct squashfs_page_actor *output)
+{
+	int res;
+
+	if (compressed) {
+		if (!msblk->stream)
+			res = -EIO;
+		else
+			res = squashfs_decompress(msblk, bio, offset, length,
+						  output);
+	} else
+		res = copy_bio_to_actor(bio, output, offset, length) ==
+			length ? length : -EIO;
+
+	squashfs_bio_free(bio);
+	return res;
+}
+
+/*
+ * Validate the on-disk size of a datablock, returning its length with the
+ * compressed bit stripped.
+ */
+static int squashfs_datablock_length(struct squashfs_sb_info *msblk,
+				     u64 index, int length, int max)
+{
+	length = SQUASHFS_COMPRESSED_SIZE_BLOCK(length);
+
+	if (length <= 0 || length > max ||
+			(index + length) > msblk->bytes_used)
+		return -EIO;
+
+	return length;
+}
+
+/*
+ * Read the metadata block length, this is stored in the first two
+ * bytes of the metadata block.
+ */
+static int get_block_length(struct super_block *sb, u64 index)
+{
+	struct bio *bio;
+	struct bio_vec *bvec;
+	unsigned char *data;
+	int idx = 0, offset, length;
+
+	bio = squashfs_bio_read(sb, index, 2, &offset);
+	if (!bio)
+		return -EIO;
+
+	bvec = squashfs_bio_next_segment(bio, &idx);
+	data = page_address(bvec->bv_page) + bvec->bv_offset;
+	length = data[offset];
+	if (offset + 1 < bvec->bv_len)
+		length |= data[offset + 1] << 8;
+	else {
+		/* The two bytes straddle a page boundary */
+		bvec = squashfs_bio_next_segment(bio, &idx);
+		data = page_address(bvec->bv_page) + bvec->bv_offset;
+		length |= data[0] << 8;
 	}
 
-	return bh;
+	squashfs_bio_free(bio);
+	return length;
 }
 
 
@@ -92,40 +237,23 @@ int squashfs_read_data(struct super_block *sb, u64 index, int length,
 		u64 *next_index, struct squashfs_page_actor *output)
 {
 	struct squashfs_sb_info *msblk = sb->s_fs_info;
-	struct buffer_head **bh;
-	int offset = index & ((1 << msblk->devblksize_log2) - 1);
-	u64 cur_index = index >> msblk->devblksize_log2;
-	int bytes, compressed, b = 0, k = 0, avail, i;
-
-	bh = kcalloc(((output->length + msblk->devblksize - 1)
-		>> msblk->devblksize_log2) + 1, sizeof(*bh), GFP_KERNEL);
-	if (bh == NULL)
-		return -ENOMEM;
+	struct bio *bio;
+	int compressed, offset;
 
 	if (length) {
 		/*
 		 * Datablock.
 		 */
-		bytes = -offset;
 		compressed = SQUASHFS_COMPRESSED_BLOCK(length);
-		length = SQUASHFS_COMPRESSED_SIZE_BLOCK(length);
+		length = squashfs_datablock_length(msblk, index, length,
+						   output->length);
+		if (length < 0)
+			goto read_failure;
 		if (next_index)
 			*next_index = index + length;
 
 		TRACE("Block @ 0x%llx, %scompressed size %d, src size %d\n",
 			index, compressed ? "" : "un", length, output->length);
-
-		if (length < 0 || length > output->length ||
-				(index + length) > msblk->bytes_used)
-			goto read_failure;
-
-		for (b = 0; bytes < length; b++, cur_index++) {
-			bh[b] = sb_getblk(sb, cur_index);
-			if (bh[b] == NULL)
-				goto block_release;
-			bytes += msblk->devblksize;
-		}
-		ll_rw_block(REQ_OP_READ, 0, b, bh);
 	} else {
 		/*
 		 * Metadata block.
@@ -133,85 +261,99 @@ int squashfs_read_data(struct super_block *sb, u64 index, int length,
 		if ((index + 2) > msblk->bytes_used)
 			goto read_failure;
 
-		bh[0] = get_block_length(sb, &cur_index, &offset, &length);
-		if (bh[0] == NULL)
+		length = get_block_length(sb, index);
+		if (length < 0)
 			goto read_failure;
-		b = 1;
+		index += 2;
 
-		bytes = msblk->devblksize - offset;
 		compressed = SQUASHFS_COMPRESSED(length);
 		length = SQUASHFS_COMPRESSED_SIZE(length);
 		if (next_index)
-			*next_index = index + length + 2;
+			*next_index = index + length;
 
-		TRACE("Block @ 0x%llx, %scompressed size %d\n", index,
+		TRACE("Block @ 0x%llx, %scompressed size %d\n", index - 2,
 				compressed ? "" : "un", length);
 
-		if (length < 0 || length > output->length ||
+		if (length <= 0 || length > output->length ||
 					(index + length) > msblk->bytes_used)
-			goto block_release;
-
-		for (; bytes < length; b++) {
-			bh[b] = sb_getblk(sb, ++cur_index);
-			if (bh[b] == NULL)
-				goto block_release;
-			bytes += msblk->devblksize;
-		}
-		ll_rw_block(REQ_OP_READ, 0, b - 1, bh + 1);
+			goto read_failure;
 	}
 
-	for (i = 0; i < b; i++) {
-		wait_on_buffer(bh[i]);
-		if (!buffer_uptodate(bh[i]))
-			goto block_release;
-	}
+	bio = squashfs_bio_read(sb, index, length, &offset);
+	if (!bio)
+		goto read_failure;
 
-	if (compressed) {
-		if (!msblk->stream)
-			goto read_failure;
-		length = squashfs_decompress(msblk, bh, b, offset, length,
-			output);
-		if (length < 0)
-			goto read_failure;
-	} else {
-		/*
-		 * Block is uncompressed.
-		 */
-		int in, pg_offset = 0;
-		void *data = squashfs_first_page(output);
-
-		for (bytes = length; k < b; k++) {
-			in = min(bytes, msblk->devblksize - offset);
-			bytes -= in;
-			while (in) {
-				if (pg_offset == PAGE_SIZE) {
-					data = squashfs_next_page(output);
-					pg_offset = 0;
-				}
-				avail = min_t(int, in, PAGE_SIZE -
-						pg_offset);
-				memcpy(data + pg_offset, bh[k]->b_data + offset,
-						avail);
-				in -= avail;
-				pg_offset += avail;
-				offset += avail;
-			}
-			offset = 0;
-			put_bh(bh[k]);
-		}
-		squashfs_finish_page(output);
-	}
+	length = squashfs_bio_to_actor(msblk, bio, offset, length, compressed,
+				       output);
+	if (length < 0)
+		goto read_failure;
 
-	kfree(bh);
 	return length;
 
-block_release:
-	for (; k < b; k++)
-		put_bh(bh[k]);
-
 read_failure:
 	ERROR("squashfs_read_data failed to read block 0x%llx\n",
 					(unsigned long long) index);
-	kfree(bh);
+	return -EIO;
+}
+
+
+/*
+ * Start an asynchronous read of the datablock at @index, with on-disk size
+ * @length, for readahead.  @end_io is called from the bio completion with
+ * @private in bio->bi_private; squashfs_finish_datablock() must then be
+ * called to decompress the block and release the bio.
+ */
+struct bio *squashfs_submit_datablock(struct super_block *sb, u64 index,
+		int length, bio_end_io_t *end_io, void *private)
+{
+	struct squashfs_sb_info *msblk = sb->s_fs_info;
+	struct bio *bio;
+	int offset;
+
+	length = squashfs_datablock_length(msblk, index, length,
+					   msblk->block_size);
+	if (length < 0)
+		return ERR_PTR(length);
+
+	bio = squashfs_bio_alloc(sb, index, length, &offset);
+	if (!bio)
+		return ERR_PTR(-ENOMEM);
+
+	bio->bi_end_io = end_io;
+	bio->bi_private = private;
+	submit_bio(bio);
+
+	return bio;
+}
+
+
+/*
+ * Decompress a datablock started by squashfs_submit_datablock() once its
+ * bio has completed.  The bio is always released.
+ */
+int squashfs_finish_datablock(struct super_block *sb, struct bio *bio,
+		u64 index, int length, struct squashfs_page_actor *output)
+{
+	struct squashfs_sb_info *msblk = sb->s_fs_info;
+	int compressed = SQUASHFS_COMPRESSED_BLOCK(length);
+	int offset = index & ((1 << msblk->devblksize_log2) - 1);
+
+	length = SQUASHFS_COMPRESSED_SIZE_BLOCK(length);
+
+	if (bio->bi_status) {
+		squashfs_bio_free(bio);
+		goto read_failure;
+	}
+
+	length = squashfs_bio_to_actor(msblk, bio, offset, length, compressed,
+				       output);
+	if (length < 0)
+		goto read_failure;
+
+	return length;
+
+read_failure:
+	ERROR("squashfs_finish_datablock failed to read block 0x%llx\n",
+					(unsigned long long) index);
 	return -EIO;
 }
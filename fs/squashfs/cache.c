@@ -24,6 +24,9 @@
 /*
  * Blocks in Squashfs are compressed.  To avoid repeatedly decompressing
  * recently accessed data Squashfs uses two small metadata and fragment caches.
+ * The fragment cache grows on demand up to a limit set at mount time, evicts
+ * the least recently used block once full, and gives its extra entries back
+ * to a shrinker under memory pressure.
  *
  * This file implements a generic cache implementation used for both caches,
  * plus functions layered ontop of the generic cache implementation to
@@ -58,6 +61,79 @@
 #include "squashfs.h"
 #include "page_actor.h"
 
+/*
+ * Allocate the buffers of a cache entry.  To avoid vmalloc fragmentation
+ * issues each entry is allocated as a sequence of kmalloced PAGE_SIZE
+ * buffers.
+ */
+static int squashfs_cache_entry_alloc(struct squashfs_cache *cache,
+	struct squashfs_cache_entry *entry, gfp_t gfp)
+{
+	int j;
+
+	entry->data = kcalloc(cache->pages, sizeof(void *), gfp);
+	if (entry->data == NULL)
+		goto cleanup;
+
+	for (j = 0; j < cache->pages; j++) {
+		entry->data[j] = kmalloc(PAGE_SIZE, gfp);
+		if (entry->data[j] == NULL)
+			goto cleanup;
+	}
+
+	entry->actor = squashfs_page_actor_init(entry->data, cache->pages, 0);
+	if (entry->actor == NULL)
+		goto cleanup;
+
+	return 0;
+
+cleanup:
+	if (entry->data) {
+		for (j = 0; j < cache->pages; j++)
+			kfree(entry->data[j]);
+		kfree(entry->data);
+		entry->data = NULL;
+	}
+	return -ENOMEM;
+}
+
+
+static void squashfs_cache_entry_free(struct squashfs_cache *cache,
+	void **data, struct squashfs_page_actor *actor)
+{
+	int j;
+
+	if (data) {
+		for (j = 0; j < cache->pages; j++)
+			kfree(data[j]);
+		kfree(data);
+	}
+	kfree(actor);
+}
+
+
+/*
+ * Return the least recently used allocated entry which isn't in use, or -1
+ * if there is none.  Called with the cache lock held.
+ */
+static int squashfs_cache_lru(struct squashfs_cache *cache)
+{
+	int i, lru = -1;
+
+	for (i = 0; i < cache->entries; i++) {
+		struct squashfs_cache_entry *entry = &cache->entry[i];
+
+		if (entry->data == NULL || entry->refcount)
+			continue;
+		if (lru == -1 || time_before(entry->last_used,
+						cache->entry[lru].last_used))
+			lru = i;
+	}
+
+	return lru;
+}
+
+
 /*
  * Look-up block in cache, and increment usage count.  If not in cache, read
  * and decompress it from disk.
@@ -65,8 +141,8 @@
 struct squashfs_cache_entry *squashfs_cache_get(struct super_block *sb,
 	struct squashfs_cache *cache, u64 block, int length)
 {
-	int i, n;
-	struct squashfs_cache_entry *entry;
+	int i, n, grow = 1;
+	struct squashfs_cache_entry *entry, spare = { .data = NULL };
 
 	spin_lock(&cache->lock);
 
@@ -81,8 +157,37 @@ struct squashfs_cache_entry *squashfs_cache_get(struct super_block *sb,
 
 		if (n == cache->entries) {
 			/*
-			 * Block not in cache, if all cache entries are used
-			 * go to sleep waiting for one to become available.
+			 * Block not in cache.  If the cache hasn't reached its
+			 * maximum size, grow it by one entry rather than
+			 * evicting a block which may be needed again soon.
+			 * The buffers can't be allocated under the spinlock,
+			 * so drop it and look the block up again afterwards.
+			 */
+			if (grow && cache->allocated < cache->entries) {
+				if (spare.data == NULL) {
+					spin_unlock(&cache->lock);
+					grow = !squashfs_cache_entry_alloc(cache,
+						&spare, GFP_KERNEL |
+						__GFP_NOWARN);
+					spin_lock(&cache->lock);
+					continue;
+				}
+
+				for (i = 0; cache->entry[i].data; i++)
+					;
+				entry = &cache->entry[i];
+				entry->data = spare.data;
+				entry->actor = spare.actor;
+				entry->last_used = 0;
+				spare.data = NULL;
+				spare.actor = NULL;
+				cache->allocated++;
+				cache->unused++;
+			}
+
+			/*
+			 * If all cache entries are used go to sleep waiting
+			 * for one to become available.
 			 */
 			if (cache->unused == 0) {
 				cache->num_waiters++;
@@ -94,18 +199,10 @@ struct squashfs_cache_entry *squashfs_cache_get(struct super_block *sb,
 			}
 
 			/*
-			 * At least one unused cache entry.  A simple
-			 * round-robin strategy is used to choose the entry to
-			 * be evicted from the cache.
+			 * At least one unused cache entry.  Evict the least
+			 * recently used one.
 			 */
-			i = cache->next_blk;
-			for (n = 0; n < cache->entries; n++) {
-				if (cache->entry[i].refcount == 0)
-					break;
-				i = (i + 1) % cache->entries;
-			}
-
-			cache->next_blk = (i + 1) % cache->entries;
+			i = squashfs_cache_lru(cache);
 			entry = &cache->entry[i];
 
 			/*
@@ -113,11 +210,13 @@ struct squashfs_cache_entry *squashfs_cache_get(struct super_block *sb,
 			 * disk.
 			 */
 			cache->unused--;
+			cache->misses++;
 			entry->block = block;
 			entry->refcount = 1;
 			entry->pending = 1;
 			entry->num_waiters = 0;
 			entry->error = 0;
+			entry->last_used = ++cache->lru_clock;
 			spin_unlock(&cache->lock);
 
 			entry->length = squashfs_read_data(sb, block, length,
@@ -154,6 +253,8 @@ struct squashfs_cache_entry *squashfs_cache_get(struct super_block *sb,
 		if (entry->refcount == 0)
 			cache->unused--;
 		entry->refcount++;
+		entry->last_used = ++cache->lru_clock;
+		cache->hits++;
 
 		/*
 		 * If the entry is currently being filled in by another process
@@ -170,6 +271,9 @@ struct squashfs_cache_entry *squashfs_cache_get(struct super_block *sb,
 	}
 
 out:
+	/* Another process grew the cache while we were allocating */
+	squashfs_cache_entry_free(cache, spare.data, spare.actor);
+
 	TRACE("Got %s %d, start block %lld, refcount %d, error %d\n",
 		cache->name, i, entry->block, entry->refcount, entry->error);
 
@@ -204,24 +308,75 @@ void squashfs_cache_put(struct squashfs_cache_entry *entry)
 	spin_unlock(&cache->lock);
 }
 
+
+/*
+ * Number of entries the shrinker may free: the unused entries the cache has
+ * grown by beyond its minimum size.
+ */
+unsigned long squashfs_cache_count(struct squashfs_cache *cache)
+{
+	if (cache == NULL)
+		return 0;
+
+	return min(cache->unused, max(cache->allocated - cache->min_entries,
+									0));
+}
+
+
+/*
+ * Free up to nr unused entries, least recently used first, never shrinking
+ * the cache below its minimum size.  Returns the number of entries freed.
+ */
+unsigned long squashfs_cache_shrink(struct squashfs_cache *cache,
+	unsigned long nr)
+{
+	unsigned long freed = 0;
+
+	if (cache == NULL)
+		return 0;
+
+	while (freed < nr) {
+		struct squashfs_page_actor *actor;
+		void **data;
+		int i;
+
+		spin_lock(&cache->lock);
+		if (cache->allocated <= cache->min_entries ||
+				(i = squashfs_cache_lru(cache)) == -1) {
+			spin_unlock(&cache->lock);
+			break;
+		}
+
+		data = cache->entry[i].data;
+		actor = cache->entry[i].actor;
+		cache->entry[i].data = NULL;
+		cache->entry[i].actor = NULL;
+		cache->entry[i].block = SQUASHFS_INVALID_BLK;
+		cache->allocated--;
+		cache->unused--;
+		spin_unlock(&cache->lock);
+
+		squashfs_cache_entry_free(cache, data, actor);
+		freed++;
+	}
+
+	return freed;
+}
+
+
 /*
  * Delete cache reclaiming all kmalloced buffers.
  */
 void squashfs_cache_delete(struct squashfs_cache *cache)
 {
-	int i, j;
+	int i;
 
 	if (cache == NULL)
 		return;
 
-	for (i = 0; i < cache->entries; i++) {
-		if (cache->entry[i].data) {
-			for (j = 0; j < cache->pages; j++)
-				kfree(cache->entry[i].data[j]);
-			kfree(cache->entry[i].data);
-		}
-		kfree(cache->entry[i].actor);
-	}
+	for (i = 0; i < cache->entries; i++)
+		squashfs_cache_entry_free(cache, cache->entry[i].data,
+					  cache->entry[i].actor);
 
 	kfree(cache->entry);
 	kfree(cache);
@@ -230,13 +385,13 @@ void squashfs_cache_delete(struct squashfs_cache *cache)
 
 /*
  * Initialise cache allocating the specified number of entries, each of
- * size block_size.  To avoid vmalloc fragmentation issues each entry
- * is allocated as a sequence of kmalloced PAGE_SIZE buffers.
+ * size block_size.  The cache may grow on demand up to max_entries, and
+ * is shrunk back towards entries under memory pressure.
  */
 struct squashfs_cache *squashfs_cache_init(char *name, int entries,
-	int block_size)
+	int max_entries, int block_size)
 {
-	int i, j;
+	int i;
 	struct squashfs_cache *cache = kzalloc(sizeof(*cache), GFP_KERNEL);
 
 	if (cache == NULL) {
@@ -244,16 +399,19 @@ struct squashfs_cache *squashfs_cache_init(char *name, int entries,
 		return NULL;
 	}
 
-	cache->entry = kcalloc(entries, sizeof(*(cache->entry)), GFP_KERNEL);
+	max_entries = max(entries, max_entries);
+	cache->entry = kcalloc(max_entries, sizeof(*(cache->entry)),
+								GFP_KERNEL);
 	if (cache->entry == NULL) {
 		ERROR("Failed to allocate %s cache\n", name);
 		goto cleanup;
 	}
 
 	cache->curr_blk = 0;
-	cache->next_blk = 0;
 	cache->unused = entries;
-	cache->entries = entries;
+	cache->entries = max_entries;
+	cache->min_entries = entries;
+	cache->allocated = entries;
 	cache->block_size = block_size;
 	cache->pages = block_size >> PAGE_SHIFT;
 	cache->pages = cache->pages ? cache->pages : 1;
@@ -262,29 +420,16 @@ struct squashfs_cache *squashfs_cache_init(char *name, int entries,
 	spin_lock_init(&cache->lock);
 	init_waitqueue_head(&cache->wait_queue);
 
-	for (i = 0; i < entries; i++) {
+	for (i = 0; i < max_entries; i++) {
 		struct squashfs_cache_entry *entry = &cache->entry[i];
 
 		init_waitqueue_head(&cache->entry[i].wait_queue);
 		entry->cache = cache;
 		entry->block = SQUASHFS_INVALID_BLK;
-		entry->data = kcalloc(cache->pages, sizeof(void *), GFP_KERNEL);
-		if (entry->data == NULL) {
-			ERROR("Failed to allocate %s cache entry\n", name);
-			goto cleanup;
-		}
-
-		for (j = 0; j < cache->pages; j++) {
-			entry->data[j] = kmalloc(PAGE_SIZE, GFP_KERNEL);
-			if (entry->data[j] == NULL) {
-				ERROR("Failed to allocate %s buffer\n", name);
-				goto cleanup;
-			}
-		}
+		if (i >= entries)
+			continue;
 
-		entry->actor = squashfs_page_actor_init(entry->data,
-						cache->pages, 0);
-		if (entry->actor == NULL) {
+		if (squashfs_cache_entry_alloc(cache, entry, GFP_KERNEL)) {
 			ERROR("Failed to allocate %s cache entry\n", name);
 			goto cleanup;
 		}
@@ -23,18 +23,29 @@
  * decompressor.h
  */
 
+#include <linux/bio.h>
+
 struct squashfs_decompressor {
 	void	*(*init)(struct squashfs_sb_info *, void *);
 	void	*(*comp_opts)(struct squashfs_sb_info *, void *, int);
 	void	(*free)(void *);
 	int	(*decompress)(struct squashfs_sb_info *, void *,
-		struct buffer_head **, int, int, int,
-		struct squashfs_page_actor *);
+		struct bio *, int, int, struct squashfs_page_actor *);
 	int	id;
 	char	*name;
 	int	supported;
 };
 
+/*
+ * Return the next segment of a bio read by squashfs_read_data(), or NULL
+ * once all of them have been consumed.
+ */
+static inline struct bio_vec *squashfs_bio_next_segment(struct bio *bio,
+							int *idx)
+{
+	return *idx < bio->bi_vcnt ? &bio->bi_io_vec[(*idx)++] : NULL;
+}
+
 static inline void *squashfs_comp_opts(struct squashfs_sb_info *msblk,
 							void *buff, int length)
 {
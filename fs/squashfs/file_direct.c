@@ -13,6 +13,10 @@
 #include <linux/string.h>
 #include <linux/pagemap.h>
 #include <linux/mutex.h>
+#include <linux/bio.h>
+#include <linux/blkdev.h>
+#include <linux/err.h>
+#include <linux/workqueue.h>
 
 #include "squashfs_fs.h"
 #include "squashfs_fs_sb.h"
@@ -37,7 +41,7 @@ int squashfs_readpage_block(struct page *target_page, u64 block, int bsize,
 	int end_index = start_index | mask;
 	int i, n, pages, missing_pages, bytes, res = -ENOMEM;
 	struct page **page;
-	struct squashfs_page_actor *actor;
+	struct squashfs_page_actor *actor = NULL;
 	void *pageaddr;
 
 	if (end_index > file_end)
@@ -49,14 +53,6 @@ int squashfs_readpage_block(struct page *target_page, u64 block, int bsize,
 	if (page == NULL)
 		return res;
 
-	/*
-	 * Create a "page actor" which will kmap and kunmap the
-	 * page cache pages appropriately within the decompressor
-	 */
-	actor = squashfs_page_actor_init_special(page, pages, 0);
-	if (actor == NULL)
-		goto out;
-
 	/* Try to grab all the pages covered by the Squashfs block */
 	for (missing_pages = 0, i = 0, n = start_index; i < pages; i++, n++) {
 		page[i] = (n == target_page->index) ? target_page :
@@ -91,6 +87,16 @@ int squashfs_readpage_block(struct page *target_page, u64 block, int bsize,
 		goto out;
 	}
 
+	/*
+	 * Create a "page actor" which will kmap and kunmap the
+	 * page cache pages appropriately within the decompressor
+	 */
+	actor = squashfs_page_actor_init_special(page, pages, 0);
+	if (actor == NULL) {
+		res = -ENOMEM;
+		goto mark_errored;
+	}
+
 	/* Decompress directly into the page cache buffers */
 	res = squashfs_read_data(inode->i_sb, block, bsize, NULL, actor);
 	if (res < 0)
@@ -118,7 +124,7 @@ int squashfs_readpage_block(struct page *target_page, u64 block, int bsize,
 			put_page(page[i]);
 	}
 
-	kfree(actor);
+	squashfs_page_actor_free(actor);
 	kfree(page);
 
 	return 0;
@@ -137,7 +143,8 @@ int squashfs_readpage_block(struct page *target_page, u64 block, int bsize,
 	}
 
 out:
-	kfree(actor);
+	if (actor)
+		squashfs_page_actor_free(actor);
 	kfree(page);
 	return res;
 }
@@ -174,3 +181,268 @@ static int squashfs_read_cache(struct page *target_page, u64 block, int bsize,
 	squashfs_cache_put(buffer);
 	return res;
 }
+
+
+/*
+ * Readahead.  The pages handed to ->readpages() are grouped by the
+ * datablock they belong to, and the compressed blocks are read with up to
+ * SQUASHFS_RA_BLOCKS bios in flight.  As each bio completes, its block is
+ * handed to squashfs_read_wq and decompressed straight into the page cache,
+ * filling every page of the block, not just the ones readahead asked for.
+ * The workqueue is unbound, so consecutive blocks are decompressed on all
+ * CPUs concurrently (given a decompressor implementation which allows it).
+ */
+#define SQUASHFS_RA_BLOCKS	8
+
+static struct workqueue_struct *squashfs_read_wq;
+
+struct squashfs_ra_block {
+	struct work_struct	work;
+	struct completion	done;
+	struct inode		*inode;
+	struct bio		*bio;
+	struct page		**page;
+	struct squashfs_page_actor *actor;
+	u64			block;
+	int			bsize;
+	int			index;
+	int			pages;
+};
+
+static void squashfs_ra_end_io(struct bio *bio)
+{
+	struct squashfs_ra_block *ra = bio->bi_private;
+
+	ra->bio = bio;
+	queue_work(squashfs_read_wq, &ra->work);
+}
+
+static void squashfs_ra_release(struct squashfs_ra_block *ra, int uptodate)
+{
+	int i;
+
+	for (i = 0; i < ra->pages; i++) {
+		if (ra->page[i] == NULL)
+			continue;
+		if (uptodate) {
+			flush_dcache_page(ra->page[i]);
+			SetPageUptodate(ra->page[i]);
+		}
+		unlock_page(ra->page[i]);
+		put_page(ra->page[i]);
+	}
+
+	squashfs_page_actor_free(ra->actor);
+	kfree(ra->page);
+}
+
+/*
+ * Look up datablock ra->index and collect the pages it covers: the locked
+ * readahead pages in @list, and whatever else can be grabbed without
+ * blocking.  Returns 0 if the block can be read into the page cache
+ * directly, otherwise the readahead pages are left to squashfs_readpage().
+ */
+static int squashfs_ra_prepare(struct inode *inode,
+	struct squashfs_ra_block *ra, struct page **list, int count)
+{
+	struct squashfs_sb_info *msblk = inode->i_sb->s_fs_info;
+	int shift = msblk->block_log - PAGE_SHIFT;
+	int file_end = (i_size_read(inode) - 1) >> PAGE_SHIFT;
+	int start_index = ra->index << shift;
+	int i, k, n;
+
+	if (ra->index >= (i_size_read(inode) >> msblk->block_log) &&
+			squashfs_i(inode)->fragment_block !=
+			SQUASHFS_INVALID_BLK)
+		return -EINVAL;
+
+	ra->bsize = squashfs_read_blocklist(inode, ra->index, &ra->block);
+	if (ra->bsize <= 0)
+		return -EINVAL;
+
+	ra->pages = min(start_index + (1 << shift) - 1, file_end) -
+		start_index + 1;
+	ra->page = kcalloc(ra->pages, sizeof(void *), GFP_KERNEL);
+	if (ra->page == NULL)
+		return -ENOMEM;
+
+	for (i = 0, k = 0, n = start_index; i < ra->pages; i++, n++) {
+		if (k < count && list[k]->index == n) {
+			ra->page[i] = list[k++];
+			get_page(ra->page[i]);
+			continue;
+		}
+
+		ra->page[i] = grab_cache_page_nowait(inode->i_mapping, n);
+		if (ra->page[i] && PageUptodate(ra->page[i])) {
+			unlock_page(ra->page[i]);
+			put_page(ra->page[i]);
+			ra->page[i] = NULL;
+		}
+	}
+
+	ra->actor = squashfs_page_actor_init_special(ra->page, ra->pages, 0);
+	if (ra->actor)
+		return 0;
+
+	/* Drop the grabbed pages, leaving the readahead pages locked */
+	for (i = 0, k = 0; i < ra->pages; i++) {
+		if (ra->page[i] == NULL)
+			continue;
+		if (k < count && ra->page[i] == list[k])
+			k++;
+		else
+			unlock_page(ra->page[i]);
+		put_page(ra->page[i]);
+	}
+	kfree(ra->page);
+	return -ENOMEM;
+}
+
+/* Decompress a block submitted by squashfs_readpages() once it is read */
+static void squashfs_ra_finish(struct squashfs_ra_block *ra)
+{
+	struct inode *inode = ra->inode;
+	struct squashfs_sb_info *msblk = inode->i_sb->s_fs_info;
+	int expected = ra->index == i_size_read(inode) >> msblk->block_log ?
+			(i_size_read(inode) & (msblk->block_size - 1)) :
+			 msblk->block_size;
+	struct page *last = ra->page[ra->pages - 1];
+	int res, bytes;
+	void *pageaddr;
+
+	res = squashfs_finish_datablock(inode->i_sb, ra->bio, ra->block,
+					ra->bsize, ra->actor);
+	if (res != expected) {
+		/*
+		 * Leave the pages !Uptodate, squashfs_readpage() will retry
+		 * and report the error when they are accessed.
+		 */
+		squashfs_ra_release(ra, 0);
+		return;
+	}
+
+	/* Last page may have trailing bytes not filled */
+	bytes = res % PAGE_SIZE;
+	if (bytes && last) {
+		pageaddr = kmap_atomic(last);
+		memset(pageaddr + bytes, 0, PAGE_SIZE - bytes);
+		kunmap_atomic(pageaddr);
+	}
+
+	squashfs_ra_release(ra, 1);
+}
+
+static void squashfs_ra_work(struct work_struct *work)
+{
+	struct squashfs_ra_block *ra = container_of(work,
+					struct squashfs_ra_block, work);
+
+	squashfs_ra_finish(ra);
+	complete(&ra->done);
+}
+
+int squashfs_readpages(struct file *file, struct address_space *mapping,
+	struct list_head *pages, unsigned int nr_pages)
+{
+	struct inode *inode = mapping->host;
+	struct squashfs_sb_info *msblk = inode->i_sb->s_fs_info;
+	int shift = msblk->block_log - PAGE_SHIFT;
+	struct squashfs_ra_block *ra;
+	struct page **page;
+	struct blk_plug plug;
+	int i, n, first, nr, nblocks;
+
+	page = kmalloc_array(nr_pages, sizeof(void *), GFP_KERNEL);
+	ra = kcalloc(SQUASHFS_RA_BLOCKS, sizeof(*ra), GFP_KERNEL);
+	if (page == NULL || ra == NULL) {
+		kfree(page);
+		kfree(ra);
+		/* Let the caller fall back to ->readpage() */
+		return 0;
+	}
+
+	/* The list is in reverse order, so this sorts the pages by index */
+	for (i = 0, nr = 0; i < nr_pages; i++) {
+		struct page *p = list_last_entry(pages, struct page, lru);
+
+		list_del(&p->lru);
+		if (add_to_page_cache_lru(p, mapping, p->index,
+				readahead_gfp_mask(mapping))) {
+			put_page(p);
+			continue;
+		}
+		page[nr++] = p;
+	}
+
+	for (i = 0; i < nr; ) {
+		/*
+		 * Look up and set up a batch of blocks first, so that the
+		 * metadata reads don't break up the plugged submission.
+		 */
+		for (nblocks = 0; nblocks < SQUASHFS_RA_BLOCKS && i < nr;
+								nblocks++) {
+			ra[nblocks].index = page[i]->index >> shift;
+			for (first = i; i < nr && page[i]->index >> shift ==
+					ra[nblocks].index; i++)
+				;
+
+			if (squashfs_ra_prepare(inode, &ra[nblocks],
+					page + first, i - first) == 0)
+				continue;
+
+			/* Fragment, sparse or failed block */
+			for (n = first; n < i; n++)
+				squashfs_readpage(file, page[n]);
+			nblocks--;
+		}
+
+		blk_start_plug(&plug);
+		for (n = 0; n < nblocks; n++) {
+			struct bio *bio;
+
+			ra[n].inode = inode;
+			INIT_WORK(&ra[n].work, squashfs_ra_work);
+			init_completion(&ra[n].done);
+			bio = squashfs_submit_datablock(inode->i_sb,
+					ra[n].block, ra[n].bsize,
+					squashfs_ra_end_io, &ra[n]);
+			if (IS_ERR(bio)) {
+				squashfs_ra_release(&ra[n], 0);
+				complete(&ra[n].done);
+			}
+		}
+		blk_finish_plug(&plug);
+
+		/*
+		 * Each block fills its own pages, so completing them in
+		 * submission order is enough to keep the page cache in order
+		 * with respect to the next batch.
+		 */
+		for (n = 0; n < nblocks; n++)
+			wait_for_completion(&ra[n].done);
+	}
+
+	for (n = 0; n < nr; n++)
+		put_page(page[n]);
+
+	kfree(ra);
+	kfree(page);
+	return 0;
+}
+
+
+int __init squashfs_readahead_init(void)
+{
+	squashfs_read_wq = alloc_workqueue("squashfs_read",
+			WQ_UNBOUND | WQ_HIGHPRI | WQ_MEM_RECLAIM,
+			num_possible_cpus());
+
+	return squashfs_read_wq ? 0 : -ENOMEM;
+}
+
+
+void squashfs_readahead_exit(void)
+{
+	destroy_workqueue(squashfs_read_wq);
+}
@@ -50,6 +50,7 @@ struct squashfs_page_actor *squashfs_page_actor_init(void **buffer,
 
 	actor->length = length ? : pages * PAGE_SIZE;
 	actor->buffer = buffer;
+	actor->tmp_page = NULL;
 	actor->pages = pages;
 	actor->next_page = 0;
 	actor->squashfs_first_page = cache_first_page;
@@ -58,20 +59,33 @@ struct squashfs_page_actor *squashfs_page_actor_init(void **buffer,
 	return actor;
 }
 
-/* Implementation of page_actor for decompressing directly into page cache. */
+/*
+ * Implementation of page_actor for decompressing directly into page cache.
+ * Pages which could not be grabbed (NULL entries) are decompressed into
+ * tmp_page and discarded.
+ */
+static void *direct_map_page(struct squashfs_page_actor *actor)
+{
+	struct page *page = actor->page[actor->next_page++];
+
+	actor->pageaddr = page ? kmap_atomic(page) : NULL;
+	return page ? actor->pageaddr : actor->tmp_page;
+}
+
 static void *direct_first_page(struct squashfs_page_actor *actor)
 {
-	actor->next_page = 1;
-	return actor->pageaddr = kmap_atomic(actor->page[0]);
+	actor->next_page = 0;
+	return direct_map_page(actor);
 }
 
 static void *direct_next_page(struct squashfs_page_actor *actor)
 {
 	if (actor->pageaddr)
 		kunmap_atomic(actor->pageaddr);
+	actor->pageaddr = NULL;
 
-	return actor->pageaddr = actor->next_page == actor->pages ? NULL :
-		kmap_atomic(actor->page[actor->next_page++]);
+	return actor->next_page == actor->pages ? NULL :
+		direct_map_page(actor);
 }
 
 static void direct_finish_page(struct squashfs_page_actor *actor)
@@ -84,10 +98,24 @@ struct squashfs_page_actor *squashfs_page_actor_init_special(struct page **page,
 	int pages, int length)
 {
 	struct squashfs_page_actor *actor = kmalloc(sizeof(*actor), GFP_KERNEL);
+	int i;
 
 	if (actor == NULL)
 		return NULL;
 
+	actor->tmp_page = NULL;
+	for (i = 0; i < pages; i++) {
+		if (page[i])
+			continue;
+
+		actor->tmp_page = kmalloc(PAGE_SIZE, GFP_KERNEL);
+		if (actor->tmp_page == NULL) {
+			kfree(actor);
+			return NULL;
+		}
+		break;
+	}
+
 	actor->length = length ? : pages * PAGE_SIZE;
 	actor->page = page;
 	actor->pages = pages;
@@ -98,3 +126,9 @@ struct squashfs_page_actor *squashfs_page_actor_init_special(struct page **page,
 	actor->squashfs_finish_page = direct_finish_page;
 	return actor;
 }
+
+void squashfs_page_actor_free(struct squashfs_page_actor *actor)
+{
+	kfree(actor->tmp_page);
+	kfree(actor);
+}
@@ -24,6 +24,8 @@
  */
 
 #define SQUASHFS_CACHED_FRAGMENTS	CONFIG_SQUASHFS_FRAGMENT_CACHE_SIZE
+#define SQUASHFS_MAX_CACHED_FRAGMENTS	(SQUASHFS_CACHED_FRAGMENTS * 8)
+#define SQUASHFS_CACHE_ENTRIES_LIMIT	1024
 #define SQUASHFS_MAJOR			4
 #define SQUASHFS_MINOR			0
 #define SQUASHFS_START			0
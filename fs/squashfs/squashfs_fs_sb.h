@@ -23,17 +23,25 @@
  * squashfs_fs_sb.h
  */
 
+#include <linux/completion.h>
+#include <linux/kobject.h>
+#include <linux/shrinker.h>
+
 #include "squashfs_fs.h"
 
 struct squashfs_cache {
 	char			*name;
 	int			entries;
+	int			min_entries;
+	int			allocated;
 	int			curr_blk;
-	int			next_blk;
 	int			num_waiters;
 	int			unused;
 	int			block_size;
 	int			pages;
+	unsigned long		lru_clock;
+	unsigned long		hits;
+	unsigned long		misses;
 	spinlock_t		lock;
 	wait_queue_head_t	wait_queue;
 	struct squashfs_cache_entry *entry;
@@ -47,6 +55,7 @@ struct squashfs_cache_entry {
 	int			pending;
 	int			error;
 	int			num_waiters;
+	unsigned long		last_used;
 	wait_queue_head_t	wait_queue;
 	struct squashfs_cache	*cache;
 	void			**data;
@@ -77,5 +86,9 @@ struct squashfs_sb_info {
 	unsigned int				inodes;
 	unsigned int				fragments;
 	int					xattr_ids;
+	int					fragment_cache_size;
+	struct shrinker				shrinker;
+	struct kobject				kobj;
+	struct completion			kobj_unregister;
 };
 #endif
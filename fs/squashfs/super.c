@@ -38,6 +38,8 @@
 #include <linux/module.h>
 #include <linux/magic.h>
 #include <linux/xattr.h>
+#include <linux/parser.h>
+#include <linux/seq_file.h>
 
 #include "squashfs_fs.h"
 #include "squashfs_fs_sb.h"
@@ -76,6 +78,76 @@ static const struct squashfs_decompressor *supported_squashfs_filesystem(short
 }
 
 
+enum {
+	Opt_fragment_cache, Opt_err
+};
+
+static const match_table_t tokens = {
+	{Opt_fragment_cache, "fragment_cache=%u"},
+	{Opt_err, NULL}
+};
+
+static int squashfs_parse_options(struct squashfs_sb_info *msblk,
+	char *options)
+{
+	substring_t args[MAX_OPT_ARGS];
+	char *p;
+	int option;
+
+	msblk->fragment_cache_size = SQUASHFS_MAX_CACHED_FRAGMENTS;
+
+	if (!options)
+		return 0;
+
+	while ((p = strsep(&options, ",")) != NULL) {
+		if (!*p)
+			continue;
+
+		switch (match_token(p, tokens, args)) {
+		case Opt_fragment_cache:
+			if (match_int(&args[0], &option) || option < 1 ||
+					option > SQUASHFS_CACHE_ENTRIES_LIMIT) {
+				ERROR("Invalid fragment_cache value \"%s\"\n",
+					args[0].from);
+				return -EINVAL;
+			}
+			msblk->fragment_cache_size = option;
+			break;
+		default:
+			/* Mount data used to be ignored, keep accepting it */
+			WARNING("Ignoring unrecognized mount option \"%s\"\n",
+				p);
+			break;
+		}
+	}
+
+	return 0;
+}
+
+
+static unsigned long squashfs_shrink_count(struct shrinker *shrink,
+	struct shrink_control *sc)
+{
+	struct squashfs_sb_info *msblk = container_of(shrink,
+					struct squashfs_sb_info, shrinker);
+
+	return squashfs_cache_count(msblk->fragment_cache);
+}
+
+
+static unsigned long squashfs_shrink_scan(struct shrinker *shrink,
+	struct shrink_control *sc)
+{
+	struct squashfs_sb_info *msblk = container_of(shrink,
+					struct squashfs_sb_info, shrinker);
+	unsigned long freed;
+
+	freed = squashfs_cache_shrink(msblk->fragment_cache, sc->nr_to_scan);
+
+	return freed ? freed : SHRINK_STOP;
+}
+
+
 static int squashfs_fill_super(struct super_block *sb, void *data, int silent)
 {
 	struct squashfs_sb_info *msblk;
@@ -96,6 +168,10 @@ static int squashfs_fill_super(struct super_block *sb, void *data, int silent)
 	}
 	msblk = sb->s_fs_info;
 
+	err = squashfs_parse_options(msblk, data);
+	if (err)
+		goto failed_mount;
+
 	msblk->devblksize = sb_min_blocksize(sb, SQUASHFS_DEVBLK_SIZE);
 	msblk->devblksize_log2 = ffz(~msblk->devblksize);
 
@@ -202,13 +278,15 @@ static int squashfs_fill_super(struct super_block *sb, void *data, int silent)
 	err = -ENOMEM;
 
 	msblk->block_cache = squashfs_cache_init("metadata",
-			SQUASHFS_CACHED_BLKS, SQUASHFS_METADATA_SIZE);
+			SQUASHFS_CACHED_BLKS, SQUASHFS_CACHED_BLKS,
+			SQUASHFS_METADATA_SIZE);
 	if (msblk->block_cache == NULL)
 		goto failed_mount;
 
 	/* Allocate read_page block */
 	msblk->read_page = squashfs_cache_init("data",
-		squashfs_max_decompressors(), msblk->block_size);
+		squashfs_max_decompressors(), squashfs_max_decompressors(),
+		msblk->block_size);
 	if (msblk->read_page == NULL) {
 		ERROR("Failed to allocate read_page block\n");
 		goto failed_mount;
@@ -277,8 +355,13 @@ static int squashfs_fill_super(struct super_block *sb, void *data, int silent)
 	if (fragments == 0)
 		goto check_directory_table;
 
+	/*
+	 * The fragment cache starts out with SQUASHFS_CACHED_FRAGMENTS
+	 * entries and grows on demand up to the fragment_cache mount option.
+	 */
 	msblk->fragment_cache = squashfs_cache_init("fragment",
-		SQUASHFS_CACHED_FRAGMENTS, msblk->block_size);
+		min(SQUASHFS_CACHED_FRAGMENTS, msblk->fragment_cache_size),
+		msblk->fragment_cache_size, msblk->block_size);
 	if (msblk->fragment_cache == NULL) {
 		err = -ENOMEM;
 		goto failed_mount;
@@ -308,18 +391,29 @@ static int squashfs_fill_super(struct super_block *sb, void *data, int silent)
 		goto failed_mount;
 	}
 
+	msblk->shrinker.count_objects = squashfs_shrink_count;
+	msblk->shrinker.scan_objects = squashfs_shrink_scan;
+	msblk->shrinker.seeks = DEFAULT_SEEKS;
+	err = register_shrinker(&msblk->shrinker);
+	if (err)
+		goto failed_mount;
+
+	err = squashfs_sysfs_register(sb);
+	if (err)
+		goto failed_shrinker;
+
 	/* allocate root */
 	root = new_inode(sb);
 	if (!root) {
 		err = -ENOMEM;
-		goto failed_mount;
+		goto failed_sysfs;
 	}
 
 	err = squashfs_read_inode(root, root_inode);
 	if (err) {
 		make_bad_inode(root);
 		iput(root);
-		goto failed_mount;
+		goto failed_sysfs;
 	}
 	insert_inode_hash(root);
 
@@ -327,13 +421,17 @@ static int squashfs_fill_super(struct super_block *sb, void *data, int silent)
 	if (sb->s_root == NULL) {
 		ERROR("Root inode create failed\n");
 		err = -ENOMEM;
-		goto failed_mount;
+		goto failed_sysfs;
 	}
 
 	TRACE("Leaving squashfs_fill_super\n");
 	kfree(sblk);
 	return 0;
 
+failed_sysfs:
+	squashfs_sysfs_unregister(msblk);
+failed_shrinker:
+	unregister_shrinker(&msblk->shrinker);
 failed_mount:
 	squashfs_cache_delete(msblk->block_cache);
 	squashfs_cache_delete(msblk->fragment_cache);
@@ -371,6 +469,18 @@ static int squashfs_statfs(struct dentry *dentry, struct kstatfs *buf)
 }
 
 
+static int squashfs_show_options(struct seq_file *seq, struct dentry *root)
+{
+	struct squashfs_sb_info *msblk = root->d_sb->s_fs_info;
+
+	if (msblk->fragment_cache_size != SQUASHFS_MAX_CACHED_FRAGMENTS)
+		seq_printf(seq, ",fragment_cache=%d",
+			   msblk->fragment_cache_size);
+
+	return 0;
+}
+
+
 static int squashfs_remount(struct super_block *sb, int *flags, char *data)
 {
 	sync_filesystem(sb);
@@ -383,6 +493,8 @@ static void squashfs_put_super(struct super_block *sb)
 {
 	if (sb->s_fs_info) {
 		struct squashfs_sb_info *sbi = sb->s_fs_info;
+		squashfs_sysfs_unregister(sbi);
+		unregister_shrinker(&sbi->shrinker);
 		squashfs_cache_delete(sbi->block_cache);
 		squashfs_cache_delete(sbi->fragment_cache);
 		squashfs_cache_delete(sbi->read_page);
@@ -445,21 +557,37 @@ static int __init init_squashfs_fs(void)
 	if (err)
 		return err;
 
+	err = squashfs_readahead_init();
+	if (err)
+		goto failed_readahead;
+
+	err = squashfs_sysfs_init();
+	if (err)
+		goto failed_sysfs;
+
 	err = register_filesystem(&squashfs_fs_type);
-	if (err) {
-		destroy_inodecache();
-		return err;
-	}
+	if (err)
+		goto failed_register;
 
 	pr_info("version 4.0 (2009/01/31) Phillip Lougher\n");
 
 	return 0;
+
+failed_register:
+	squashfs_sysfs_exit();
+failed_sysfs:
+	squashfs_readahead_exit();
+failed_readahead:
+	destroy_inodecache();
+	return err;
 }
 
 
 static void __exit exit_squashfs_fs(void)
 {
 	unregister_filesystem(&squashfs_fs_type);
+	squashfs_sysfs_exit();
+	squashfs_readahead_exit();
 	destroy_inodecache();
 }
 
@@ -499,6 +627,7 @@ static const struct super_operations squashfs_super_ops = {
 	.destroy_inode = squashfs_destroy_inode,
 	.statfs = squashfs_statfs,
 	.put_super = squashfs_put_super,
+	.show_options = squashfs_show_options,
 	.remount_fs = squashfs_remount
 };
 
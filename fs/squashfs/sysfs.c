@@ -0,0 +1,150 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Squashfs sysfs interface
+ *
+ * Each mounted filesystem gets a /sys/fs/squashfs/<dev> directory exporting
+ * the size and hit/miss statistics of its metadata, fragment and data
+ * caches.
+ */
+
+#include <linux/fs.h>
+#include <linux/kobject.h>
+#include <linux/sysfs.h>
+
+#include "squashfs_fs.h"
+#include "squashfs_fs_sb.h"
+#include "squashfs.h"
+
+enum {
+	attr_hits,
+	attr_misses,
+	attr_entries,
+	attr_max_entries,
+};
+
+struct squashfs_attr {
+	struct attribute attr;
+	int kind;
+	/* offset of the struct squashfs_cache pointer in squashfs_sb_info */
+	size_t offset;
+};
+
+static struct kset *squashfs_kset;
+
+static ssize_t squashfs_attr_show(struct kobject *kobj,
+				  struct attribute *attr, char *buf)
+{
+	struct squashfs_sb_info *msblk = container_of(kobj,
+					struct squashfs_sb_info, kobj);
+	struct squashfs_attr *a = container_of(attr, struct squashfs_attr,
+					       attr);
+	struct squashfs_cache *cache = *(struct squashfs_cache **)
+					((char *)msblk + a->offset);
+
+	/* The fragment cache doesn't exist if there are no fragments */
+	if (cache == NULL)
+		return sprintf(buf, "0\n");
+
+	switch (a->kind) {
+	case attr_hits:
+		return sprintf(buf, "%lu\n", READ_ONCE(cache->hits));
+	case attr_misses:
+		return sprintf(buf, "%lu\n", READ_ONCE(cache->misses));
+	case attr_entries:
+		return sprintf(buf, "%d\n", READ_ONCE(cache->allocated));
+	case attr_max_entries:
+		return sprintf(buf, "%d\n", cache->entries);
+	}
+
+	return 0;
+}
+
+#define SQUASHFS_CACHE_ATTR(_name, _cache, _kind)			\
+static struct squashfs_attr squashfs_attr_##_name##_##_kind = {	\
+	.attr = { .name = __stringify(_name##_cache_##_kind),		\
+		  .mode = 0444 },					\
+	.kind = attr_##_kind,						\
+	.offset = offsetof(struct squashfs_sb_info, _cache),		\
+}
+
+#define SQUASHFS_CACHE_ATTRS(_name, _cache)				\
+	SQUASHFS_CACHE_ATTR(_name, _cache, hits);			\
+	SQUASHFS_CACHE_ATTR(_name, _cache, misses);			\
+	SQUASHFS_CACHE_ATTR(_name, _cache, entries);			\
+	SQUASHFS_CACHE_ATTR(_name, _cache, max_entries)
+
+#define ATTR_LIST(_name, _kind)	(&squashfs_attr_##_name##_##_kind.attr)
+
+SQUASHFS_CACHE_ATTRS(metadata, block_cache);
+SQUASHFS_CACHE_ATTRS(fragment, fragment_cache);
+SQUASHFS_CACHE_ATTRS(data, read_page);
+
+static struct attribute *squashfs_attrs[] = {
+	ATTR_LIST(metadata, hits),
+	ATTR_LIST(metadata, misses),
+	ATTR_LIST(metadata, entries),
+	ATTR_LIST(metadata, max_entries),
+	ATTR_LIST(fragment, hits),
+	ATTR_LIST(fragment, misses),
+	ATTR_LIST(fragment, entries),
+	ATTR_LIST(fragment, max_entries),
+	ATTR_LIST(data, hits),
+	ATTR_LIST(data, misses),
+	ATTR_LIST(data, entries),
+	ATTR_LIST(data, max_entries),
+	NULL,
+};
+
+static void squashfs_sb_release(struct kobject *kobj)
+{
+	struct squashfs_sb_info *msblk = container_of(kobj,
+					struct squashfs_sb_info, kobj);
+
+	complete(&msblk->kobj_unregister);
+}
+
+static const struct sysfs_ops squashfs_attr_ops = {
+	.show	= squashfs_attr_show,
+};
+
+static struct kobj_type squashfs_sb_ktype = {
+	.default_attrs	= squashfs_attrs,
+	.sysfs_ops	= &squashfs_attr_ops,
+	.release	= squashfs_sb_release,
+};
+
+int squashfs_sysfs_register(struct super_block *sb)
+{
+	struct squashfs_sb_info *msblk = sb->s_fs_info;
+	int err;
+
+	init_completion(&msblk->kobj_unregister);
+	msblk->kobj.kset = squashfs_kset;
+	err = kobject_init_and_add(&msblk->kobj, &squashfs_sb_ktype, NULL,
+				   "%s", sb->s_id);
+	if (err) {
+		kobject_put(&msblk->kobj);
+		wait_for_completion(&msblk->kobj_unregister);
+	}
+
+	return err;
+}
+
+void squashfs_sysfs_unregister(struct squashfs_sb_info *msblk)
+{
+	kobject_del(&msblk->kobj);
+	kobject_put(&msblk->kobj);
+	wait_for_completion(&msblk->kobj_unregister);
+}
+
+int __init squashfs_sysfs_init(void)
+{
+	squashfs_kset = kset_create_and_add("squashfs", NULL, fs_kobj);
+
+	return squashfs_kset ? 0 : -ENOMEM;
+}
+
+void squashfs_sysfs_exit(void)
+{
+	kset_unregister(squashfs_kset);
+}
@@ -23,7 +23,7 @@
 
 
 #include <linux/mutex.h>
-#include <linux/buffer_head.h>
+#include <linux/bio.h>
 #include <linux/slab.h>
 #include <linux/zlib.h>
 #include <linux/vmalloc.h>
@@ -63,21 +63,25 @@ static void zlib_free(void *strm)
 
 
 static int zlib_uncompress(struct squashfs_sb_info *msblk, void *strm,
-	struct buffer_head **bh, int b, int offset, int length,
+	struct bio *bio, int offset, int length,
 	struct squashfs_page_actor *output)
 {
-	int zlib_err, zlib_init = 0, k = 0;
+	int zlib_err, zlib_init = 0, idx = 0;
 	z_stream *stream = strm;
+	struct bio_vec *bvec;
 
 	stream->avail_out = PAGE_SIZE;
 	stream->next_out = squashfs_first_page(output);
 	stream->avail_in = 0;
 
 	do {
-		if (stream->avail_in == 0 && k < b) {
-			int avail = min(length, msblk->devblksize - offset);
+		if (stream->avail_in == 0 && length &&
+		    (bvec = squashfs_bio_next_segment(bio, &idx))) {
+			int avail = min_t(int, length, bvec->bv_len - offset);
+
 			length -= avail;
-			stream->next_in = bh[k]->b_data + offset;
+			stream->next_in = page_address(bvec->bv_page) +
+					  bvec->bv_offset + offset;
 			stream->avail_in = avail;
 			offset = 0;
 		}
@@ -98,9 +102,6 @@ static int zlib_uncompress(struct squashfs_sb_info *msblk, void *strm,
 		}
 
 		zlib_err = zlib_inflate(stream, Z_SYNC_FLUSH);
-
-		if (stream->avail_in == 0 && k < b)
-			put_bh(bh[k++]);
 	} while (zlib_err == Z_OK);
 
 	squashfs_finish_page(output);
@@ -112,15 +113,12 @@ static int zlib_uncompress(struct squashfs_sb_info *msblk, void *strm,
 	if (zlib_err != Z_OK)
 		goto out;
 
-	if (k < b)
+	if (length)
 		goto out;
 
 	return stream->total_out;
 
 out:
-	for (; k < b; k++)
-		put_bh(bh[k]);
-
 	return -EIO;
 }
 
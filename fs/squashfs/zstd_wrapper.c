@@ -18,7 +18,7 @@
  */
 
 #include <linux/mutex.h>
-#include <linux/buffer_head.h>
+#include <linux/bio.h>
 #include <linux/slab.h>
 #include <linux/zstd.h>
 #include <linux/vmalloc.h>
@@ -68,14 +68,15 @@ static void zstd_free(void *strm)
 
 
 static int zstd_uncompress(struct squashfs_sb_info *msblk, void *strm,
-	struct buffer_head **bh, int b, int offset, int length,
+	struct bio *bio, int offset, int length,
 	struct squashfs_page_actor *output)
 {
 	struct workspace *wksp = strm;
 	ZSTD_DStream *stream;
 	size_t total_out = 0;
 	size_t zstd_err;
-	int k = 0;
+	int idx = 0;
+	struct bio_vec *bvec;
 	ZSTD_inBuffer in_buf = { NULL, 0, 0 };
 	ZSTD_outBuffer out_buf = { NULL, 0, 0 };
 
@@ -90,11 +91,13 @@ static int zstd_uncompress(struct squashfs_sb_info *msblk, void *strm,
 	out_buf.dst = squashfs_first_page(output);
 
 	do {
-		if (in_buf.pos == in_buf.size && k < b) {
-			int avail = min(length, msblk->devblksize - offset);
+		if (in_buf.pos == in_buf.size && length &&
+		    (bvec = squashfs_bio_next_segment(bio, &idx))) {
+			int avail = min_t(int, length, bvec->bv_len - offset);
 
 			length -= avail;
-			in_buf.src = bh[k]->b_data + offset;
+			in_buf.src = page_address(bvec->bv_page) +
+				     bvec->bv_offset + offset;
 			in_buf.size = avail;
 			in_buf.pos = 0;
 			offset = 0;
@@ -116,9 +119,6 @@ static int zstd_uncompress(struct squashfs_sb_info *msblk, void *strm,
 		total_out -= out_buf.pos;
 		zstd_err = ZSTD_decompressStream(stream, &out_buf, &in_buf);
 		total_out += out_buf.pos; /* add the additional data produced */
-
-		if (in_buf.pos == in_buf.size && k < b)
-			put_bh(bh[k++]);
 	} while (zstd_err != 0 && !ZSTD_isError(zstd_err));
 
 	squashfs_finish_page(output);
@@ -129,15 +129,12 @@ static int zstd_uncompress(struct squashfs_sb_info *msblk, void *strm,
 		goto out;
 	}
 
-	if (k < b)
+	if (length)
 		goto out;
 
 	return (int)total_out;
 
 out:
-	for (; k < b; k++)
-		put_bh(bh[k]);
-
 	return -EIO;
 }
 
@@ -244,6 +244,8 @@ struct xt_table {
 
 #include <linux/netfilter_ipv4.h>
 
+struct xt_skip_steps;
+
 /* The table itself */
 struct xt_table_info {
 	/* Size per table */
@@ -264,6 +266,9 @@ struct xt_table_info {
 	unsigned int stacksize;
 	void ***jumpstack;
 
+	/* Rule skip steps, built by and private to ip_tables */
+	struct xt_skip_steps *skip;
+
 	unsigned char entries[0] __aligned(8);
 };
 
@@ -572,6 +572,41 @@ TRACE_EVENT(sched_wake_idle_without_ipi,
 
 	TP_printk("cpu=%d", __entry->cpu)
 );
+
+/*
+ * Tracepoint for energy-aware wake-up placement decisions. The energies
+ * are the estimates for the whole root domain, in the Energy Model units,
+ * with the task placed on prev_cpu and on the selected CPU.
+ */
+TRACE_EVENT(sched_energy_placement,
+
+	TP_PROTO(struct task_struct *p, int prev_cpu, int dst_cpu,
+		 unsigned long prev_energy, unsigned long dst_energy),
+
+	TP_ARGS(p, prev_cpu, dst_cpu, prev_energy, dst_energy),
+
+	TP_STRUCT__entry(
+		__array(	char,		comm,	TASK_COMM_LEN	)
+		__field(	pid_t,		pid			)
+		__field(	int,		prev_cpu		)
+		__field(	int,		dst_cpu			)
+		__field(	unsigned long,	prev_energy		)
+		__field(	unsigned long,	dst_energy		)
+	),
+
+	TP_fast_assign(
+		memcpy(__entry->comm, p->comm, TASK_COMM_LEN);
+		__entry->pid		= p->pid;
+		__entry->prev_cpu	= prev_cpu;
+		__entry->dst_cpu	= dst_cpu;
+		__entry->prev_energy	= prev_energy;
+		__entry->dst_energy	= dst_energy;
+	),
+
+	TP_printk("comm=%s pid=%d prev_cpu=%d dst_cpu=%d prev_energy=%lu dst_energy=%lu",
+		  __entry->comm, __entry->pid, __entry->prev_cpu,
+		  __entry->dst_cpu, __entry->prev_energy, __entry->dst_energy)
+);
 #endif /* _TRACE_SCHED_H */
 
 /* This part must be outside protection */
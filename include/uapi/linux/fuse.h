@@ -780,6 +780,15 @@ struct fuse_notify_retrieve_in {
 
 /* Device ioctls: */
 #define FUSE_DEV_IOC_CLONE	_IOR(229, 0, uint32_t)
+/*
+ * Serve the input queue of the given CPU on a cloned device: synchronous
+ * requests issued on that CPU are queued there instead of on the shared
+ * queue.  FORGET, background and notify reply requests always go to the
+ * shared queue, so at least one device must remain unbound: binding the last
+ * unbound device, or one with O_ASYNC set, fails with EBUSY, and closing it
+ * while bound devices remain aborts the connection.
+ */
+#define FUSE_DEV_IOC_BIND_QUEUE	_IOW(229, 1, uint32_t)
 
 struct fuse_lseek_in {
 	uint64_t	fh;
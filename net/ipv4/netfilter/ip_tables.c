@@ -18,6 +18,11 @@
 #include <linux/netdevice.h>
 #include <linux/module.h>
 #include <linux/icmp.h>
+#include <linux/tcp.h>
+#include <linux/udp.h>
+#include <linux/proc_fs.h>
+#include <linux/seq_file_net.h>
+#include <linux/percpu.h>
 #include <net/ip.h>
 #include <net/compat.h>
 #include <linux/uaccess.h>
@@ -27,6 +32,7 @@
 #include <linux/cpumask.h>
 
 #include <linux/netfilter/x_tables.h>
+#include <linux/netfilter/xt_tcpudp.h>
 #include <linux/netfilter_ipv4/ip_tables.h>
 #include <net/netfilter/nf_log.h>
 #include "../../netfilter/xt_repldata.h"
@@ -125,7 +131,6 @@ ipt_get_target_c(const struct ipt_entry *e)
 	return ipt_get_target((struct ipt_entry *)e);
 }
 
-#if IS_ENABLED(CONFIG_NETFILTER_XT_TARGET_TRACE)
 static const char *const hooknames[] = {
 	[NF_INET_PRE_ROUTING]		= "PREROUTING",
 	[NF_INET_LOCAL_IN]		= "INPUT",
@@ -134,6 +139,7 @@ static const char *const hooknames[] = {
 	[NF_INET_POST_ROUTING]		= "POSTROUTING",
 };
 
+#if IS_ENABLED(CONFIG_NETFILTER_XT_TARGET_TRACE)
 enum nf_ip_trace_comments {
 	NF_IP_TRACE_COMMENT_RULE,
 	NF_IP_TRACE_COMMENT_RETURN,
@@ -223,6 +229,141 @@ struct ipt_entry *ipt_next_entry(const struct ipt_entry *entry)
 	return (void *)entry + entry->next_offset;
 }
 
+/* Skip steps: for every rule and criterion, the index of the next rule
+ * whose value for that criterion differs. A packet failing a criterion of
+ * a rule fails it for all the following rules up to there as well, so they
+ * can be jumped over without changing the evaluation order.
+ */
+enum {
+	IPT_SKIP_SRC,
+	IPT_SKIP_DST,
+	IPT_SKIP_IFIN,
+	IPT_SKIP_IFOUT,
+	IPT_SKIP_PROTO,
+	IPT_SKIP_DPORT,
+	IPT_SKIP_MAX,
+};
+
+struct ipt_skip_rule {
+	unsigned int skip[IPT_SKIP_MAX];
+	unsigned int chain;
+	/* Destination port range of a leading tcp/udp match */
+	u16 dpts[2];
+	bool dport;
+	bool dport_inv;
+};
+
+struct ipt_skip_chain {
+	const char *name;
+	unsigned int rules;
+};
+
+struct xt_skip_steps {
+	unsigned int number;
+	unsigned int nchains;
+	unsigned int hook_index[NF_INET_NUMHOOKS];
+	unsigned int *offsets;
+	struct ipt_skip_rule *rules;
+	struct ipt_skip_chain *chains;
+	u64 __percpu *skipped;
+};
+
+/* Rule index of the entry at @offset */
+static inline unsigned int
+ipt_skip_index(const struct xt_skip_steps *skip, unsigned int offset)
+{
+	unsigned int lo = 0, hi = skip->number;
+
+	while (hi - lo > 1) {
+		unsigned int mid = lo + (hi - lo) / 2;
+
+		if (skip->offsets[mid] <= offset)
+			lo = mid;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
+/* Destination port of the packet as the tcp/udp matches would see it,
+ * or -1 if they would not get that far.
+ */
+static int
+ipt_skip_dport(const struct sk_buff *skb, const struct iphdr *ip,
+	       const struct xt_action_param *par)
+{
+	__be16 _ports[2];
+	const __be16 *ports;
+	unsigned int hdrlen;
+
+	if (par->fragoff != 0)
+		return -1;
+
+	switch (ip->protocol) {
+	case IPPROTO_TCP:
+		hdrlen = sizeof(struct tcphdr);
+		break;
+	case IPPROTO_UDP:
+	case IPPROTO_UDPLITE:
+		hdrlen = sizeof(struct udphdr);
+		break;
+	default:
+		return -1;
+	}
+	if (par->thoff + hdrlen > skb->len)
+		return -1;
+
+	ports = skb_header_pointer(skb, par->thoff, sizeof(_ports), _ports);
+	if (ports == NULL)
+		return -1;
+	return ntohs(ports[1]);
+}
+
+static inline bool
+ipt_skip_dport_match(const struct ipt_skip_rule *r, int dport)
+{
+	if (!r->dport || dport < 0)
+		return true;
+	return (dport >= r->dpts[0] && dport <= r->dpts[1]) ^ r->dport_inv;
+}
+
+/* The packet does not match rule @idx: return the index of the first rule
+ * which might match it.
+ */
+static unsigned int
+ipt_skip_next(const struct xt_skip_steps *skip, unsigned int idx,
+	      const struct ipt_entry *e, const struct iphdr *ip,
+	      const char *indev, const char *outdev, int dport)
+{
+	const struct ipt_skip_rule *r = &skip->rules[idx];
+	const struct ipt_ip *ipinfo = &e->ip;
+	unsigned int next = idx + 1;
+
+	if (NF_INVF(ipinfo, IPT_INV_SRCIP,
+		    (ip->saddr & ipinfo->smsk.s_addr) != ipinfo->src.s_addr))
+		next = max(next, r->skip[IPT_SKIP_SRC]);
+	if (NF_INVF(ipinfo, IPT_INV_DSTIP,
+		    (ip->daddr & ipinfo->dmsk.s_addr) != ipinfo->dst.s_addr))
+		next = max(next, r->skip[IPT_SKIP_DST]);
+	if (NF_INVF(ipinfo, IPT_INV_VIA_IN,
+		    ifname_compare_aligned(indev, ipinfo->iniface,
+					   ipinfo->iniface_mask) != 0))
+		next = max(next, r->skip[IPT_SKIP_IFIN]);
+	if (NF_INVF(ipinfo, IPT_INV_VIA_OUT,
+		    ifname_compare_aligned(outdev, ipinfo->outiface,
+					   ipinfo->outiface_mask) != 0))
+		next = max(next, r->skip[IPT_SKIP_IFOUT]);
+	if (ipinfo->proto &&
+	    NF_INVF(ipinfo, IPT_INV_PROTO, ip->protocol != ipinfo->proto))
+		next = max(next, r->skip[IPT_SKIP_PROTO]);
+	if (!ipt_skip_dport_match(r, dport))
+		next = max(next, r->skip[IPT_SKIP_DPORT]);
+
+	if (next > idx + 1)
+		this_cpu_ptr(skip->skipped)[r->chain] += next - idx - 1;
+	return next;
+}
+
 /* Returns one of the generic firewall policies, like NF_ACCEPT. */
 unsigned int
 ipt_do_table(struct sk_buff *skb,
@@ -239,8 +380,10 @@ ipt_do_table(struct sk_buff *skb,
 	struct ipt_entry *e, **jumpstack;
 	unsigned int stackidx, cpu;
 	const struct xt_table_info *private;
+	const struct xt_skip_steps *skip;
 	struct xt_action_param acpar;
-	unsigned int addend;
+	unsigned int addend, idx = 0;
+	int dport = -1;
 
 	/* Initialization */
 	stackidx = 0;
@@ -277,6 +420,11 @@ ipt_do_table(struct sk_buff *skb,
 		jumpstack += private->stacksize * __this_cpu_read(nf_skb_duplicated);
 
 	e = get_entry(table_base, private->hook_entry[hook]);
+	skip = private->skip;
+	if (skip) {
+		idx = skip->hook_index[hook];
+		dport = ipt_skip_dport(skb, ip, &acpar);
+	}
 
 	do {
 		const struct xt_entry_target *t;
@@ -285,9 +433,17 @@ ipt_do_table(struct sk_buff *skb,
 
 		WARN_ON(!e);
 		if (!ip_packet_match(ip, indev, outdev,
-		    &e->ip, acpar.fragoff)) {
+		    &e->ip, acpar.fragoff) ||
+		    (skip && !ipt_skip_dport_match(&skip->rules[idx], dport))) {
+			if (skip) {
+				idx = ipt_skip_next(skip, idx, e, ip, indev,
+						    outdev, dport);
+				e = get_entry(table_base, skip->offsets[idx]);
+				continue;
+			}
  no_match:
 			e = ipt_next_entry(e);
+			idx++;
 			continue;
 		}
 
@@ -328,6 +484,9 @@ ipt_do_table(struct sk_buff *skb,
 					e = jumpstack[--stackidx];
 					e = ipt_next_entry(e);
 				}
+				if (skip)
+					idx = ipt_skip_index(skip,
+							     (void *)e - table_base);
 				continue;
 			}
 			if (table_base + v != ipt_next_entry(e) &&
@@ -340,6 +499,8 @@ ipt_do_table(struct sk_buff *skb,
 			}
 
 			e = get_entry(table_base, v);
+			if (skip)
+				idx = ipt_skip_index(skip, v);
 			continue;
 		}
 
@@ -351,6 +512,9 @@ ipt_do_table(struct sk_buff *skb,
 			/* Target might have changed stuff. */
 			ip = ip_hdr(skb);
 			e = ipt_next_entry(e);
+			idx++;
+			if (skip)
+				dport = ipt_skip_dport(skb, ip, &acpar);
 		} else {
 			/* Verdict */
 			break;
@@ -658,6 +822,173 @@ cleanup_entry(struct ipt_entry *e, struct net *net)
 	xt_percpu_counter_free(&e->counters);
 }
 
+static void ipt_skip_free(struct xt_skip_steps *skip)
+{
+	if (!skip)
+		return;
+	free_percpu(skip->skipped);
+	kvfree(skip->chains);
+	kvfree(skip->rules);
+	kvfree(skip->offsets);
+	kfree(skip);
+}
+
+static void ipt_free_table_info(struct xt_table_info *info)
+{
+	ipt_skip_free(info->skip);
+	xt_free_table_info(info);
+}
+
+static void ipt_skip_dport_init(struct ipt_skip_rule *r,
+				const struct ipt_entry *e)
+{
+	const struct xt_entry_match *m = (const void *)e->elems;
+	const char *name;
+
+	/* Only a leading match fails before any other one had a chance to
+	 * run, so that skipping the rule cannot drop side effects.
+	 */
+	if (e->target_offset == sizeof(struct ipt_entry))
+		return;
+	name = m->u.kernel.match->name;
+	if (strcmp(name, "tcp") == 0) {
+		const struct xt_tcp *tcpinfo = (const void *)m->data;
+
+		r->dpts[0] = tcpinfo->dpts[0];
+		r->dpts[1] = tcpinfo->dpts[1];
+		r->dport_inv = !!(tcpinfo->invflags & XT_TCP_INV_DSTPT);
+	} else if (strcmp(name, "udp") == 0) {
+		const struct xt_udp *udpinfo = (const void *)m->data;
+
+		r->dpts[0] = udpinfo->dpts[0];
+		r->dpts[1] = udpinfo->dpts[1];
+		r->dport_inv = !!(udpinfo->invflags & XT_UDP_INV_DSTPT);
+	} else {
+		return;
+	}
+	r->dport = r->dpts[0] != 0 || r->dpts[1] != 0xFFFF || r->dport_inv;
+}
+
+/* Whether @a and @b test the criterion @c the same way */
+static bool ipt_skip_same(const struct ipt_entry *a,
+			  const struct ipt_skip_rule *ra,
+			  const struct ipt_entry *b,
+			  const struct ipt_skip_rule *rb, unsigned int c)
+{
+	const struct ipt_ip *x = &a->ip, *y = &b->ip;
+
+	switch (c) {
+	case IPT_SKIP_SRC:
+		return x->src.s_addr == y->src.s_addr &&
+		       x->smsk.s_addr == y->smsk.s_addr &&
+		       !((x->invflags ^ y->invflags) & IPT_INV_SRCIP);
+	case IPT_SKIP_DST:
+		return x->dst.s_addr == y->dst.s_addr &&
+		       x->dmsk.s_addr == y->dmsk.s_addr &&
+		       !((x->invflags ^ y->invflags) & IPT_INV_DSTIP);
+	case IPT_SKIP_IFIN:
+		return memcmp(x->iniface, y->iniface, IFNAMSIZ) == 0 &&
+		       memcmp(x->iniface_mask, y->iniface_mask, IFNAMSIZ) == 0 &&
+		       !((x->invflags ^ y->invflags) & IPT_INV_VIA_IN);
+	case IPT_SKIP_IFOUT:
+		return memcmp(x->outiface, y->outiface, IFNAMSIZ) == 0 &&
+		       memcmp(x->outiface_mask, y->outiface_mask, IFNAMSIZ) == 0 &&
+		       !((x->invflags ^ y->invflags) & IPT_INV_VIA_OUT);
+	case IPT_SKIP_PROTO:
+		return x->proto == y->proto &&
+		       (!x->proto ||
+			!((x->invflags ^ y->invflags) & IPT_INV_PROTO));
+	case IPT_SKIP_DPORT:
+		return ra->dport == rb->dport &&
+		       (!ra->dport ||
+			(ra->dpts[0] == rb->dpts[0] &&
+			 ra->dpts[1] == rb->dpts[1] &&
+			 ra->dport_inv == rb->dport_inv));
+	}
+	return false;
+}
+
+/* Build the skip steps of a translated table. This is an optimisation only:
+ * without them ipt_do_table() evaluates every rule in turn.
+ */
+static void ipt_skip_build(struct xt_table_info *newinfo, void *entry0,
+			   unsigned int valid_hooks)
+{
+	struct xt_skip_steps *skip;
+	struct ipt_skip_chain *chain = NULL;
+	const struct ipt_entry *iter;
+	unsigned int i, j, c, h, head;
+
+	skip = kzalloc(sizeof(*skip), GFP_KERNEL);
+	if (!skip)
+		return;
+	skip->number = newinfo->number;
+	skip->offsets = kvmalloc_array(skip->number, sizeof(*skip->offsets),
+				       GFP_KERNEL);
+	skip->rules = kvcalloc(skip->number, sizeof(*skip->rules), GFP_KERNEL);
+	skip->chains = kvcalloc(newinfo->stacksize + NF_INET_NUMHOOKS,
+				sizeof(*skip->chains), GFP_KERNEL);
+	skip->skipped = __alloc_percpu(sizeof(u64) *
+				       (newinfo->stacksize + NF_INET_NUMHOOKS),
+				       __alignof__(u64));
+	if (!skip->offsets || !skip->rules || !skip->chains || !skip->skipped)
+		goto err;
+
+	i = 0;
+	xt_entry_foreach(iter, entry0, newinfo->size) {
+		unsigned int off = (void *)iter - entry0;
+		const struct xt_entry_target *t = ipt_get_target_c(iter);
+		bool builtin = false;
+
+		for (h = 0; h < NF_INET_NUMHOOKS; h++) {
+			if (!(valid_hooks & (1 << h)) ||
+			    newinfo->hook_entry[h] != off)
+				continue;
+			skip->hook_index[h] = i;
+			if (!builtin) {
+				chain = &skip->chains[skip->nchains++];
+				chain->name = hooknames[h];
+				builtin = true;
+			}
+		}
+		if (strcmp(t->u.kernel.target->name, XT_ERROR_TARGET) == 0) {
+			/* Head of user chain, or the table trailer */
+			if (i + 1 < skip->number) {
+				chain = &skip->chains[skip->nchains++];
+				chain->name = (const char *)t->data;
+			}
+		} else if (chain) {
+			chain->rules++;
+		}
+		if (chain)
+			skip->rules[i].chain = chain - skip->chains;
+		skip->offsets[i] = off;
+		ipt_skip_dport_init(&skip->rules[i], iter);
+		++i;
+	}
+
+	/* Rules of the last run fall through to the next one as usual */
+	for (c = 0; c < IPT_SKIP_MAX; c++) {
+		for (head = 0, i = 1; i <= skip->number; i++) {
+			if (i < skip->number &&
+			    ipt_skip_same(entry0 + skip->offsets[head],
+					  &skip->rules[head],
+					  entry0 + skip->offsets[i],
+					  &skip->rules[i], c))
+				continue;
+			for (j = head; j < i; j++)
+				skip->rules[j].skip[c] =
+					i < skip->number ? i : j + 1;
+			head = i;
+		}
+	}
+
+	newinfo->skip = skip;
+	return;
+err:
+	ipt_skip_free(skip);
+}
+
 /* Checks and translates the user-supplied table segment (held in
    newinfo) */
 static int
@@ -733,6 +1064,7 @@ translate_table(struct net *net, struct xt_table_info *newinfo, void *entry0,
 		return ret;
 	}
 
+	ipt_skip_build(newinfo, entry0, repl->valid_hooks);
 	return ret;
  out_free:
 	kvfree(offsets);
@@ -1087,7 +1419,7 @@ __do_replace(struct net *net, const char *name, unsigned int valid_hooks,
 	xt_entry_foreach(iter, oldinfo->entries, oldinfo->size)
 		cleanup_entry(iter, net);
 
-	xt_free_table_info(oldinfo);
+	ipt_free_table_info(oldinfo);
 	if (copy_to_user(counters_ptr, counters,
 			 sizeof(struct xt_counters) * num_counters) != 0) {
 		/* Silent error, can't fail, new table is already in place */
@@ -1150,7 +1482,7 @@ do_replace(struct net *net, const void __user *user, unsigned int len)
 	xt_entry_foreach(iter, loc_cpu_entry, newinfo->size)
 		cleanup_entry(iter, net);
  free_newinfo:
-	xt_free_table_info(newinfo);
+	ipt_free_table_info(newinfo);
 	return ret;
 }
 
@@ -1471,11 +1803,11 @@ translate_compat_table(struct net *net,
 
 	*pinfo = newinfo;
 	*pentry0 = entry1;
-	xt_free_table_info(info);
+	ipt_free_table_info(info);
 	return 0;
 
 free_newinfo:
-	xt_free_table_info(newinfo);
+	ipt_free_table_info(newinfo);
 	return ret;
 out_unlock:
 	xt_compat_flush_offsets(AF_INET);
@@ -1533,7 +1865,7 @@ compat_do_replace(struct net *net, void __user *user, unsigned int len)
 	xt_entry_foreach(iter, loc_cpu_entry, newinfo->size)
 		cleanup_entry(iter, net);
  free_newinfo:
-	xt_free_table_info(newinfo);
+	ipt_free_table_info(newinfo);
 	return ret;
 }
 
@@ -1737,6 +2069,72 @@ do_ipt_get_ctl(struct sock *sk, int cmd, void __user *user, int *len)
 	return ret;
 }
 
+#ifdef CONFIG_PROC_FS
+#define IPT_SKIP_PROC_DIR	"ip_tables_skip"
+
+/* One line per chain: name, number of rules and rules skipped so far */
+static int ipt_skip_seq_show(struct seq_file *seq, void *v)
+{
+	const struct xt_table *table = PDE_DATA(file_inode(seq->file));
+	struct net *net = seq_file_single_net(seq);
+	const struct xt_skip_steps *skip;
+	struct xt_table *t;
+	unsigned int i, cpu;
+
+	t = xt_find_table_lock(net, AF_INET, table->name);
+	if (IS_ERR(t))
+		return PTR_ERR(t);
+
+	skip = t->private->skip;
+	for (i = 0; skip && i < skip->nchains; i++) {
+		u64 skipped = 0;
+
+		for_each_possible_cpu(cpu) {
+			seqcount_t *s = &per_cpu(xt_recseq, cpu);
+			unsigned int start;
+			u64 tmp;
+
+			do {
+				start = read_seqcount_begin(s);
+				tmp = per_cpu_ptr(skip->skipped, cpu)[i];
+			} while (read_seqcount_retry(s, start));
+			skipped += tmp;
+		}
+		seq_printf(seq, "%s %u %llu\n", skip->chains[i].name,
+			   skip->chains[i].rules, skipped);
+	}
+
+	module_put(t->me);
+	xt_table_unlock(t);
+	return 0;
+}
+
+static void ipt_skip_proc_init(struct net *net, struct xt_table *table)
+{
+	char name[sizeof(IPT_SKIP_PROC_DIR) + XT_TABLE_MAXNAMELEN];
+
+	snprintf(name, sizeof(name), IPT_SKIP_PROC_DIR "/%s", table->name);
+	proc_create_net_single(name, 0440, net->proc_net, ipt_skip_seq_show,
+			       table);
+}
+
+static void ipt_skip_proc_fini(struct net *net, struct xt_table *table)
+{
+	char name[sizeof(IPT_SKIP_PROC_DIR) + XT_TABLE_MAXNAMELEN];
+
+	snprintf(name, sizeof(name), IPT_SKIP_PROC_DIR "/%s", table->name);
+	remove_proc_subtree(name, net->proc_net);
+}
+#else
+static inline void ipt_skip_proc_init(struct net *net, struct xt_table *table)
+{
+}
+
+static inline void ipt_skip_proc_fini(struct net *net, struct xt_table *table)
+{
+}
+#endif /* CONFIG_PROC_FS */
+
 static void __ipt_unregister_table(struct net *net, struct xt_table *table)
 {
 	struct xt_table_info *private;
@@ -1744,6 +2142,7 @@ static void __ipt_unregister_table(struct net *net, struct xt_table *table)
 	struct module *table_owner = table->me;
 	struct ipt_entry *iter;
 
+	ipt_skip_proc_fini(net, table);
 	private = xt_unregister_table(table);
 
 	/* Decrease module usage counts and free resources */
@@ -1752,7 +2151,7 @@ static void __ipt_unregister_table(struct net *net, struct xt_table *table)
 		cleanup_entry(iter, net);
 	if (private->number > private->initial_entries)
 		module_put(table_owner);
-	xt_free_table_info(private);
+	ipt_free_table_info(private);
 }
 
 int ipt_register_table(struct net *net, const struct xt_table *table,
@@ -1782,6 +2181,8 @@ int ipt_register_table(struct net *net, const struct xt_table *table,
 		goto out_free;
 	}
 
+	ipt_skip_proc_init(net, new_table);
+
 	/* set res now, will see skbs right after nf_register_net_hooks */
 	WRITE_ONCE(*res, new_table);
 	if (!ops)
@@ -1796,7 +2197,7 @@ int ipt_register_table(struct net *net, const struct xt_table *table,
 	return ret;
 
 out_free:
-	xt_free_table_info(newinfo);
+	ipt_free_table_info(newinfo);
 	return ret;
 }
 
@@ -1904,12 +2305,18 @@ static struct xt_match ipt_builtin_mt[] __read_mostly = {
 
 static int __net_init ip_tables_net_init(struct net *net)
 {
+#ifdef CONFIG_PROC_FS
+	proc_net_mkdir(net, IPT_SKIP_PROC_DIR, net->proc_net);
+#endif
 	return xt_proto_init(net, NFPROTO_IPV4);
 }
 
 static void __net_exit ip_tables_net_exit(struct net *net)
 {
 	xt_proto_fini(net, NFPROTO_IPV4);
+#ifdef CONFIG_PROC_FS
+	remove_proc_subtree(IPT_SKIP_PROC_DIR, net->proc_net);
+#endif
 }
 
 static struct pernet_operations ip_tables_net_ops = {
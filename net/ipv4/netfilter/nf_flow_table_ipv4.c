@@ -2,19 +2,141 @@
 #include <linux/init.h>
 #include <linux/module.h>
 #include <linux/netfilter.h>
+#include <linux/percpu.h>
+#include <linux/proc_fs.h>
+#include <linux/seq_file_net.h>
+#include <linux/u64_stats_sync.h>
+#include <net/netns/generic.h>
 #include <net/netfilter/nf_flow_table.h>
 #include <net/netfilter/nf_tables.h>
 
+/* Outcome of the ingress fast path for the packets it has seen */
+struct nf_flow_ipv4_stat {
+	u64			offloaded;	/* forwarded by the fast path */
+	u64			passed;		/* handed on to the stack */
+	u64			dropped;
+	struct u64_stats_sync	syncp;
+};
+
+struct nf_flow_ipv4_net {
+	struct nf_flow_ipv4_stat __percpu *stat;
+};
+
+static unsigned int nf_flow_ipv4_net_id __read_mostly;
+
+static unsigned int
+nf_flow_offload_ipv4_hook(void *priv, struct sk_buff *skb,
+			  const struct nf_hook_state *state)
+{
+	struct nf_flow_ipv4_net *fn = net_generic(state->net,
+						  nf_flow_ipv4_net_id);
+	struct nf_flow_ipv4_stat *st;
+	unsigned int verdict;
+
+	verdict = nf_flow_offload_ip_hook(priv, skb, state);
+
+	st = this_cpu_ptr(fn->stat);
+	u64_stats_update_begin(&st->syncp);
+	switch (verdict & NF_VERDICT_MASK) {
+	case NF_STOLEN:
+		st->offloaded++;
+		break;
+	case NF_ACCEPT:
+		st->passed++;
+		break;
+	default:
+		st->dropped++;
+		break;
+	}
+	u64_stats_update_end(&st->syncp);
+
+	return verdict;
+}
+
 static struct nf_flowtable_type flowtable_ipv4 = {
 	.family		= NFPROTO_IPV4,
 	.init		= nf_flow_table_init,
 	.free		= nf_flow_table_free,
-	.hook		= nf_flow_offload_ip_hook,
+	.hook		= nf_flow_offload_ipv4_hook,
 	.owner		= THIS_MODULE,
 };
 
+#ifdef CONFIG_PROC_FS
+static int nf_flow_ipv4_stat_show(struct seq_file *seq, void *v)
+{
+	struct net *net = seq_file_single_net(seq);
+	struct nf_flow_ipv4_net *fn = net_generic(net, nf_flow_ipv4_net_id);
+	u64 offloaded = 0, passed = 0, dropped = 0;
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		const struct nf_flow_ipv4_stat *st = per_cpu_ptr(fn->stat, cpu);
+		u64 o, p, d;
+		unsigned int start;
+
+		do {
+			start = u64_stats_fetch_begin_irq(&st->syncp);
+			o = st->offloaded;
+			p = st->passed;
+			d = st->dropped;
+		} while (u64_stats_fetch_retry_irq(&st->syncp, start));
+
+		offloaded += o;
+		passed += p;
+		dropped += d;
+	}
+	seq_puts(seq, "offloaded passed dropped\n");
+	seq_printf(seq, "%llu %llu %llu\n", offloaded, passed, dropped);
+	return 0;
+}
+#endif
+
+static int __net_init nf_flow_ipv4_net_init(struct net *net)
+{
+	struct nf_flow_ipv4_net *fn = net_generic(net, nf_flow_ipv4_net_id);
+	int cpu;
+
+	fn->stat = alloc_percpu(struct nf_flow_ipv4_stat);
+	if (!fn->stat)
+		return -ENOMEM;
+	for_each_possible_cpu(cpu)
+		u64_stats_init(&per_cpu_ptr(fn->stat, cpu)->syncp);
+#ifdef CONFIG_PROC_FS
+	if (!proc_create_net_single("nf_flowtable_ipv4", 0444,
+				    net->proc_net_stat,
+				    nf_flow_ipv4_stat_show, NULL)) {
+		free_percpu(fn->stat);
+		return -ENOMEM;
+	}
+#endif
+	return 0;
+}
+
+static void __net_exit nf_flow_ipv4_net_exit(struct net *net)
+{
+	struct nf_flow_ipv4_net *fn = net_generic(net, nf_flow_ipv4_net_id);
+
+#ifdef CONFIG_PROC_FS
+	remove_proc_entry("nf_flowtable_ipv4", net->proc_net_stat);
+#endif
+	free_percpu(fn->stat);
+}
+
+static struct pernet_operations nf_flow_ipv4_net_ops = {
+	.init	= nf_flow_ipv4_net_init,
+	.exit	= nf_flow_ipv4_net_exit,
+	.id	= &nf_flow_ipv4_net_id,
+	.size	= sizeof(struct nf_flow_ipv4_net),
+};
+
 static int __init nf_flow_ipv4_module_init(void)
 {
+	int ret;
+
+	ret = register_pernet_subsys(&nf_flow_ipv4_net_ops);
+	if (ret < 0)
+		return ret;
+
 	nft_register_flowtable_type(&flowtable_ipv4);
 
 	return 0;
@@ -23,6 +145,7 @@ static int __init nf_flow_ipv4_module_init(void)
 static void __exit nf_flow_ipv4_module_exit(void)
 {
 	nft_unregister_flowtable_type(&flowtable_ipv4);
+	unregister_pernet_subsys(&nf_flow_ipv4_net_ops);
 }
 
 module_init(nf_flow_ipv4_module_init);
@@ -0,0 +1,896 @@
+// SPDX-License-Identifier: GPL-2.0
+
+/* Kernel module implementing an IP set type: the lpm:net type
+ *
+ * The networks are stored in a path-compressed binary trie, so testing an
+ * address is a single root to leaf walk bounded by the address length,
+ * independently of the number of different prefix lengths in the set.
+ * Kernel side lookups are lockless under RCU, updates are serialized by
+ * the set lock.
+ */
+
+#include <linux/module.h>
+#include <linux/ip.h>
+#include <linux/skbuff.h>
+#include <linux/errno.h>
+#include <linux/bitops.h>
+#include <linux/rcupdate.h>
+#include <linux/slab.h>
+#include <net/ip.h>
+#include <net/ipv6.h>
+#include <net/netlink.h>
+
+#include <linux/netfilter.h>
+#include <linux/netfilter/ipset/pfxlen.h>
+#include <linux/netfilter/ipset/ip_set.h>
+#include <linux/netfilter/ipset/ip_set_hash.h>
+
+#define IPSET_TYPE_REV_MIN	0
+#define IPSET_TYPE_REV_MAX	0
+
+MODULE_LICENSE("GPL");
+IP_SET_MODULE_DESC("lpm:net", IPSET_TYPE_REV_MIN, IPSET_TYPE_REV_MAX);
+MODULE_ALIAS("ip_set_lpm:net");
+
+#define lpm_net_dereference(p, set) \
+	rcu_dereference_protected(p, spin_is_locked(&(set)->lock))
+
+#define rcu_dereference_bh_nfnl(p)	rcu_dereference_bh_check(p, 1)
+
+/* Trie nodes. Intermediate nodes are branch points only, created when two
+ * prefixes diverge, and are never matched or listed. All nodes are
+ * allocated with room for the extensions, so that an intermediate node can
+ * be turned into a member in place and back.
+ */
+struct lpm_net_node {
+	struct rcu_head rcu;
+	struct lpm_net_node __rcu *child[2];
+	union nf_inet_addr ip;
+	u8 cidr;
+	u8 nomatch;
+	u8 intermediate;
+} __aligned(__alignof__(u64));
+
+/* Prefix lengths 0 to 128 can be found on the path to an address */
+#define LPM_NET_MAX_DEPTH	(128 + 1)
+
+struct lpm_net_elem {
+	union nf_inet_addr ip;
+	u8 cidr;
+};
+
+/* Type structure */
+struct lpm_net {
+	struct lpm_net_node __rcu *root;
+	struct timer_list gc;	/* garbage collection */
+	struct ip_set *set;	/* attached to this ip_set */
+	u32 maxelem;		/* max elements in the set */
+	u32 nodes;		/* allocated trie nodes */
+	u8 host_mask;		/* 32 or 128 */
+};
+
+static inline u8
+lpm_net_bit(const union nf_inet_addr *ip, u8 index)
+{
+	return (ntohl(ip->all[index / 32]) >> (31 - index % 32)) & 1;
+}
+
+/* Number of leading bits @ip shares with the prefix of @n, at most @cidr */
+static u8
+lpm_net_match_len(const struct lpm_net_node *n, const union nf_inet_addr *ip,
+		  u8 cidr)
+{
+	u8 limit = min(n->cidr, cidr);
+	u8 i, len = 0;
+	u32 diff;
+
+	for (i = 0; len < limit; i++) {
+		diff = ntohl(n->ip.all[i] ^ ip->all[i]);
+		if (diff) {
+			len += 32 - fls(diff);
+			break;
+		}
+		len += 32;
+	}
+	return min(len, limit);
+}
+
+/* Return the node following the position of @ip/@cidr in preorder, which is
+ * ascending address, then ascending prefix length order. The key does not
+ * need to be present in the trie, so walkers may remove the node they are
+ * standing on before moving on.
+ */
+static struct lpm_net_node *
+lpm_net_next(const struct lpm_net *map, const union nf_inet_addr *ip, u8 cidr)
+{
+	struct lpm_net_node *n, *child, *next = NULL;
+	u8 len;
+
+	n = rcu_dereference_bh_nfnl(map->root);
+	while (n) {
+		len = lpm_net_match_len(n, ip, cidr);
+		if (len < n->cidr && len < cidr)
+			/* The whole subtree is either before or after the key */
+			return lpm_net_bit(&n->ip, len) ? n : next;
+		if (n->cidr > cidr)
+			return n;
+		if (n->cidr == cidr) {
+			child = rcu_dereference_bh_nfnl(n->child[0]);
+			if (!child)
+				child = rcu_dereference_bh_nfnl(n->child[1]);
+			return child ? child : next;
+		}
+		if (!lpm_net_bit(ip, n->cidr)) {
+			child = rcu_dereference_bh_nfnl(n->child[1]);
+			if (child)
+				next = child;
+			n = rcu_dereference_bh_nfnl(n->child[0]);
+		} else {
+			n = rcu_dereference_bh_nfnl(n->child[1]);
+		}
+	}
+	return next;
+}
+
+/* Locate the member node of @ip/@cidr together with the slot pointing to it
+ * and the slot pointing to its parent, if any.
+ */
+static struct lpm_net_node *
+lpm_net_find(struct ip_set *set, const union nf_inet_addr *ip, u8 cidr,
+	     struct lpm_net_node __rcu ***slot,
+	     struct lpm_net_node __rcu ***pslot)
+{
+	struct lpm_net *map = set->data;
+	struct lpm_net_node *n;
+	u8 len = 0;
+
+	*slot = &map->root;
+	*pslot = NULL;
+	while ((n = lpm_net_dereference(**slot, set))) {
+		len = lpm_net_match_len(n, ip, cidr);
+		if (n->cidr != len || n->cidr == cidr)
+			break;
+		*pslot = *slot;
+		*slot = &n->child[lpm_net_bit(ip, n->cidr)];
+	}
+	if (!n || n->cidr != cidr || len != cidr || n->intermediate)
+		return NULL;
+	return n;
+}
+
+/* Remove the member @n from the trie. A node with two children stays as a
+ * branch point, otherwise it is replaced by its only child, collapsing the
+ * parent too when that was a branch point left with a single child.
+ */
+static void
+lpm_net_unlink(struct ip_set *set, struct lpm_net_node *n,
+	       struct lpm_net_node __rcu **slot,
+	       struct lpm_net_node __rcu **pslot)
+{
+	struct lpm_net *map = set->data;
+	struct lpm_net_node *parent, *child;
+
+	set->elements--;
+	ip_set_ext_destroy(set, n);
+
+	if (rcu_access_pointer(n->child[0]) &&
+	    rcu_access_pointer(n->child[1])) {
+		WRITE_ONCE(n->intermediate, 1);
+		return;
+	}
+
+	child = lpm_net_dereference(n->child[0], set);
+	if (!child)
+		child = lpm_net_dereference(n->child[1], set);
+	parent = pslot ? lpm_net_dereference(*pslot, set) : NULL;
+	if (!child && parent && parent->intermediate) {
+		child = lpm_net_dereference(
+			parent->child[rcu_access_pointer(parent->child[0]) == n],
+			set);
+		rcu_assign_pointer(*pslot, child);
+		kfree_rcu(parent, rcu);
+		map->nodes--;
+	} else {
+		rcu_assign_pointer(*slot, child);
+	}
+	kfree_rcu(n, rcu);
+	map->nodes--;
+}
+
+static void
+lpm_net_expire(struct ip_set *set)
+{
+	struct lpm_net *map = set->data;
+	struct lpm_net_node __rcu **slot;
+	struct lpm_net_node __rcu **pslot;
+	struct lpm_net_node *n;
+	union nf_inet_addr ip;
+	u8 cidr;
+
+	n = lpm_net_dereference(map->root, set);
+	while (n) {
+		ip = n->ip;
+		cidr = n->cidr;
+		if (!n->intermediate &&
+		    ip_set_timeout_expired(ext_timeout(n, set))) {
+			n = lpm_net_find(set, &ip, cidr, &slot, &pslot);
+			if (n)
+				lpm_net_unlink(set, n, slot, pslot);
+		}
+		n = lpm_net_next(map, &ip, cidr);
+	}
+}
+
+static void
+lpm_net_init_extensions(struct ip_set *set, const struct ip_set_ext *ext,
+			struct lpm_net_node *n, u32 flags)
+{
+	n->nomatch = (flags >> 16) & IPSET_FLAG_NOMATCH;
+	if (SET_WITH_COUNTER(set))
+		ip_set_init_counter(ext_counter(n, set), ext);
+	if (SET_WITH_COMMENT(set))
+		ip_set_init_comment(set, ext_comment(n, set), ext);
+	if (SET_WITH_SKBINFO(set))
+		ip_set_init_skbinfo(ext_skbinfo(n, set), ext);
+	/* Update timeout last */
+	if (SET_WITH_TIMEOUT(set))
+		ip_set_timeout_set(ext_timeout(n, set), ext->timeout);
+}
+
+static int
+lpm_net_add(struct ip_set *set, void *value, const struct ip_set_ext *ext,
+	    struct ip_set_ext *mext, u32 flags)
+{
+	struct lpm_net *map = set->data;
+	const struct lpm_net_elem *d = value;
+	struct lpm_net_node __rcu **slot = &map->root;
+	struct lpm_net_node *n, *e, *im = NULL;
+	bool flag_exist = flags & IPSET_FLAG_EXIST;
+	u8 len = 0;
+
+	if (set->elements >= map->maxelem && SET_WITH_TIMEOUT(set))
+		lpm_net_expire(set);
+
+	while ((n = lpm_net_dereference(*slot, set))) {
+		len = lpm_net_match_len(n, &d->ip, d->cidr);
+		if (n->cidr != len || n->cidr == d->cidr)
+			break;
+		slot = &n->child[lpm_net_bit(&d->ip, n->cidr)];
+	}
+
+	if (n && n->cidr == d->cidr && len == d->cidr && !n->intermediate) {
+		if (!flag_exist &&
+		    !(SET_WITH_TIMEOUT(set) &&
+		      ip_set_timeout_expired(ext_timeout(n, set))))
+			return -IPSET_ERR_EXIST;
+		/* Just the extensions could be overwritten */
+		lpm_net_init_extensions(set, ext, n, flags);
+		return 0;
+	}
+
+	if (set->elements >= map->maxelem) {
+		if (net_ratelimit())
+			pr_warn("Set %s is full, maxelem %u reached\n",
+				set->name, map->maxelem);
+		return -IPSET_ERR_HASH_FULL;
+	}
+
+	if (n && n->cidr == d->cidr && len == d->cidr) {
+		/* Turn the branch point into a member */
+		lpm_net_init_extensions(set, ext, n, flags);
+		smp_wmb();
+		WRITE_ONCE(n->intermediate, 0);
+		set->elements++;
+		return 0;
+	}
+
+	e = kzalloc(set->dsize, GFP_ATOMIC);
+	if (!e)
+		return -ENOMEM;
+	if (n && len != d->cidr) {
+		/* Prefixes diverge at bit len: insert a branch point */
+		im = kzalloc(set->dsize, GFP_ATOMIC);
+		if (!im) {
+			kfree(e);
+			return -ENOMEM;
+		}
+		im->ip = d->ip;
+		ip6_netmask(&im->ip, len);
+		im->cidr = len;
+		im->intermediate = 1;
+	}
+	e->ip = d->ip;
+	e->cidr = d->cidr;
+	lpm_net_init_extensions(set, ext, e, flags);
+
+	if (im) {
+		u8 bit = lpm_net_bit(&d->ip, len);
+
+		RCU_INIT_POINTER(im->child[bit], e);
+		RCU_INIT_POINTER(im->child[!bit], n);
+		rcu_assign_pointer(*slot, im);
+		map->nodes++;
+	} else {
+		if (n)
+			/* The new prefix covers the subtree */
+			RCU_INIT_POINTER(e->child[lpm_net_bit(&n->ip, len)], n);
+		rcu_assign_pointer(*slot, e);
+	}
+	map->nodes++;
+	set->elements++;
+
+	return 0;
+}
+
+static int
+lpm_net_del(struct ip_set *set, void *value, const struct ip_set_ext *ext,
+	    struct ip_set_ext *mext, u32 flags)
+{
+	const struct lpm_net_elem *d = value;
+	struct lpm_net_node __rcu **slot;
+	struct lpm_net_node __rcu **pslot;
+	struct lpm_net_node *n;
+
+	n = lpm_net_find(set, &d->ip, d->cidr, &slot, &pslot);
+	if (!n ||
+	    (SET_WITH_TIMEOUT(set) &&
+	     ip_set_timeout_expired(ext_timeout(n, set))))
+		return -IPSET_ERR_EXIST;
+
+	lpm_net_unlink(set, n, slot, pslot);
+	return 0;
+}
+
+/* Whether @n is a live member of the set */
+static inline bool
+lpm_net_live(const struct ip_set *set, const struct lpm_net_node *n)
+{
+	return !READ_ONCE(n->intermediate) &&
+	       !(SET_WITH_TIMEOUT(set) &&
+		 ip_set_timeout_expired(ext_timeout(n, set)));
+}
+
+/* Return the node of the prefix @ip/@cidr on the path to @ip, if any */
+static struct lpm_net_node *
+lpm_net_lookup(const struct lpm_net *map, const union nf_inet_addr *ip,
+	       u8 cidr)
+{
+	struct lpm_net_node *n = rcu_dereference_bh(map->root);
+
+	while (n && lpm_net_match_len(n, ip, cidr) >= n->cidr) {
+		if (n->cidr == cidr)
+			return n;
+		n = rcu_dereference_bh(n->child[lpm_net_bit(ip, n->cidr)]);
+	}
+	return NULL;
+}
+
+/* Test whether the element is added to the set: a host address is matched
+ * against the live prefixes covering it from the longest to the shortest,
+ * until one of them matches the extensions as well, the same way as the
+ * hash:net type does. A network is matched against the exact same prefix
+ * only.
+ */
+static int
+lpm_net_test(struct ip_set *set, void *value, const struct ip_set_ext *ext,
+	     struct ip_set_ext *mext, u32 flags)
+{
+	struct lpm_net *map = set->data;
+	const struct lpm_net_elem *d = value;
+	struct lpm_net_node *n, *found = NULL;
+	bool host = d->cidr == map->host_mask;
+	u8 cidrs[LPM_NET_MAX_DEPTH];
+	int i = 0;
+
+	n = rcu_dereference_bh(map->root);
+	while (n) {
+		if (lpm_net_match_len(n, &d->ip, d->cidr) < n->cidr)
+			break;
+		if ((host || n->cidr == d->cidr) && lpm_net_live(set, n)) {
+			cidrs[i++] = n->cidr;
+			found = n;
+		}
+		if (n->cidr == d->cidr)
+			break;
+		n = rcu_dereference_bh(n->child[lpm_net_bit(&d->ip, n->cidr)]);
+	}
+
+	/* Only the prefix lengths are kept, too many node pointers would be
+	 * needed on the stack: the shorter prefixes are looked up again.
+	 */
+	n = found;
+	while (i-- > 0) {
+		if (n && lpm_net_live(set, n) &&
+		    ip_set_match_extensions(set, ext, mext, flags, n))
+			/* nomatch entries return -ENOTEMPTY */
+			return n->nomatch ? -ENOTEMPTY : 1;
+		if (i > 0)
+			n = lpm_net_lookup(map, &d->ip, cidrs[i - 1]);
+	}
+	return 0;
+}
+
+/* Release a detached trie bottom-up, without recursion */
+static void
+lpm_net_free(struct ip_set *set, struct lpm_net_node *root, bool deferred)
+{
+	struct lpm_net_node __rcu **slot;
+	struct lpm_net_node *n;
+
+	while (root) {
+		slot = NULL;
+		n = root;
+		for (;;) {
+			if (rcu_access_pointer(n->child[0]))
+				slot = &n->child[0];
+			else if (rcu_access_pointer(n->child[1]))
+				slot = &n->child[1];
+			else
+				break;
+			n = rcu_dereference_protected(*slot, 1);
+		}
+		if (slot)
+			RCU_INIT_POINTER(*slot, NULL);
+		else
+			root = NULL;
+		ip_set_ext_destroy(set, n);
+		if (deferred)
+			kfree_rcu(n, rcu);
+		else
+			kfree(n);
+	}
+}
+
+static void
+lpm_net_flush(struct ip_set *set)
+{
+	struct lpm_net *map = set->data;
+	struct lpm_net_node *root = lpm_net_dereference(map->root, set);
+
+	rcu_assign_pointer(map->root, NULL);
+	lpm_net_free(set, root, true);
+	map->nodes = 0;
+	set->elements = 0;
+	set->ext_size = 0;
+}
+
+static void
+lpm_net_destroy(struct ip_set *set)
+{
+	struct lpm_net *map = set->data;
+
+	if (SET_WITH_TIMEOUT(set))
+		del_timer_sync(&map->gc);
+
+	lpm_net_free(set, rcu_dereference_protected(map->root, 1), false);
+	kfree(map);
+
+	set->data = NULL;
+}
+
+static int
+lpm_net_head(struct ip_set *set, struct sk_buff *skb)
+{
+	const struct lpm_net *map = set->data;
+	struct nlattr *nested;
+	size_t memsize;
+
+	/* Drop the timed out elements so that the counter is right */
+	if (SET_WITH_TIMEOUT(set)) {
+		spin_lock_bh(&set->lock);
+		lpm_net_expire(set);
+		spin_unlock_bh(&set->lock);
+	}
+	memsize = sizeof(*map) + map->nodes * set->dsize + set->ext_size;
+
+	nested = ipset_nest_start(skb, IPSET_ATTR_DATA);
+	if (!nested)
+		goto nla_put_failure;
+	if (nla_put_net32(skb, IPSET_ATTR_MAXELEM, htonl(map->maxelem)) ||
+	    nla_put_net32(skb, IPSET_ATTR_REFERENCES, htonl(set->ref)) ||
+	    nla_put_net32(skb, IPSET_ATTR_MEMSIZE, htonl(memsize)) ||
+	    nla_put_net32(skb, IPSET_ATTR_ELEMENTS, htonl(set->elements)))
+		goto nla_put_failure;
+	if (unlikely(ip_set_put_flags(skb, set)))
+		goto nla_put_failure;
+	ipset_nest_end(skb, nested);
+
+	return 0;
+nla_put_failure:
+	return -EMSGSIZE;
+}
+
+static bool
+lpm_net_data_list(struct sk_buff *skb, const struct ip_set *set,
+		  const struct lpm_net_node *n)
+{
+	u32 flags = n->nomatch ? IPSET_FLAG_NOMATCH : 0;
+
+	if ((set->family == NFPROTO_IPV4 ?
+	     nla_put_ipaddr4(skb, IPSET_ATTR_IP, n->ip.ip) :
+	     nla_put_ipaddr6(skb, IPSET_ATTR_IP, &n->ip.in6)) ||
+	    nla_put_u8(skb, IPSET_ATTR_CIDR, n->cidr) ||
+	    (flags &&
+	     nla_put_net32(skb, IPSET_ATTR_CADT_FLAGS, htonl(flags))))
+		return true;
+	return false;
+}
+
+/* The key of the last listed element is kept across dump chunks, so that
+ * listing can resume from it with lpm_net_next(). It is released when the
+ * dump of the set ends.
+ */
+static void
+lpm_net_uref(struct ip_set *set, struct netlink_callback *cb, bool start)
+{
+	if (!start && cb->args[IPSET_CB_PRIVATE]) {
+		kfree((struct lpm_net_elem *)cb->args[IPSET_CB_PRIVATE]);
+		cb->args[IPSET_CB_PRIVATE] = 0;
+	}
+}
+
+static int
+lpm_net_list(const struct ip_set *set,
+	     struct sk_buff *skb, struct netlink_callback *cb)
+{
+	const struct lpm_net *map = set->data;
+	struct lpm_net_elem *last =
+		(struct lpm_net_elem *)cb->args[IPSET_CB_PRIVATE];
+	struct lpm_net_node *n, *listed = NULL;
+	struct nlattr *atd, *nested = NULL;
+	int ret = 0;
+
+	if (!last) {
+		last = kmalloc(sizeof(*last), GFP_KERNEL);
+		if (!last)
+			return -ENOMEM;
+		cb->args[IPSET_CB_PRIVATE] = (unsigned long)last;
+	}
+
+	atd = ipset_nest_start(skb, IPSET_ATTR_ADT);
+	if (!atd)
+		return -EMSGSIZE;
+
+	rcu_read_lock();
+	/* The last listed element may be gone, the successor of its key is
+	 * still well defined.
+	 */
+	n = cb->args[IPSET_CB_ARG0] ? lpm_net_next(map, &last->ip, last->cidr)
+				    : rcu_dereference(map->root);
+	for (; n; n = lpm_net_next(map, &n->ip, n->cidr)) {
+		if (READ_ONCE(n->intermediate) ||
+		    (SET_WITH_TIMEOUT(set) &&
+		     ip_set_timeout_expired(ext_timeout(n, set))))
+			continue;
+		nested = ipset_nest_start(skb, IPSET_ATTR_DATA);
+		if (!nested)
+			goto nla_put_failure;
+		if (lpm_net_data_list(skb, set, n))
+			goto nla_put_failure;
+		if (ip_set_put_extensions(skb, set, n, true))
+			goto nla_put_failure;
+		ipset_nest_end(skb, nested);
+		listed = n;
+	}
+
+	ipset_nest_end(skb, atd);
+	/* Set listing finished */
+	cb->args[IPSET_CB_ARG0] = 0;
+	goto out;
+
+nla_put_failure:
+	nla_nest_cancel(skb, nested);
+	if (unlikely(!listed)) {
+		nla_nest_cancel(skb, atd);
+		cb->args[IPSET_CB_ARG0] = 0;
+		ret = -EMSGSIZE;
+	} else {
+		last->ip = listed->ip;
+		last->cidr = listed->cidr;
+		cb->args[IPSET_CB_ARG0] = 1;
+		ipset_nest_end(skb, atd);
+	}
+out:
+	rcu_read_unlock();
+	return ret;
+}
+
+static bool
+lpm_net_same_set(const struct ip_set *a, const struct ip_set *b)
+{
+	const struct lpm_net *x = a->data;
+	const struct lpm_net *y = b->data;
+
+	return x->maxelem == y->maxelem &&
+	       a->timeout == b->timeout &&
+	       a->extensions == b->extensions;
+}
+
+/* IPv4 variant */
+
+static int
+lpm_net4_kadt(struct ip_set *set, const struct sk_buff *skb,
+	      const struct xt_action_param *par,
+	      enum ipset_adt adt, struct ip_set_adt_opt *opt)
+{
+	ipset_adtfn adtfn = set->variant->adt[adt];
+	struct lpm_net_elem e = { .cidr = 32 };
+	struct ip_set_ext ext = IP_SET_INIT_KEXT(skb, opt, set);
+
+	ip4addrptr(skb, opt->flags & IPSET_DIM_ONE_SRC, &e.ip.ip);
+
+	return adtfn(set, &e, &ext, &opt->ext, opt->cmdflags);
+}
+
+static int
+lpm_net4_uadt(struct ip_set *set, struct nlattr *tb[],
+	      enum ipset_adt adt, u32 *lineno, u32 flags, bool retried)
+{
+	ipset_adtfn adtfn = set->variant->adt[adt];
+	struct lpm_net_elem e = { .cidr = 32 };
+	struct ip_set_ext ext = IP_SET_INIT_UEXT(set);
+	u32 ip = 0, ip_to = 0;
+	int ret;
+
+	if (tb[IPSET_ATTR_LINENO])
+		*lineno = nla_get_u32(tb[IPSET_ATTR_LINENO]);
+
+	if (unlikely(!tb[IPSET_ATTR_IP] ||
+		     !ip_set_optattr_netorder(tb, IPSET_ATTR_CADT_FLAGS)))
+		return -IPSET_ERR_PROTOCOL;
+
+	ret = ip_set_get_hostipaddr4(tb[IPSET_ATTR_IP], &ip);
+	if (ret)
+		return ret;
+
+	ret = ip_set_get_extensions(set, tb, &ext);
+	if (ret)
+		return ret;
+
+	if (tb[IPSET_ATTR_CIDR]) {
+		e.cidr = nla_get_u8(tb[IPSET_ATTR_CIDR]);
+		if (!e.cidr || e.cidr > 32)
+			return -IPSET_ERR_INVALID_CIDR;
+	}
+
+	if (tb[IPSET_ATTR_CADT_FLAGS]) {
+		u32 cadt_flags = ip_set_get_h32(tb[IPSET_ATTR_CADT_FLAGS]);
+
+		if (cadt_flags & IPSET_FLAG_NOMATCH)
+			flags |= (IPSET_FLAG_NOMATCH << 16);
+	}
+
+	if (adt == IPSET_TEST || !tb[IPSET_ATTR_IP_TO]) {
+		e.ip.ip = htonl(ip & ip_set_hostmask(e.cidr));
+		ret = adtfn(set, &e, &ext, &ext, flags);
+		return ip_set_enomatch(ret, flags, adt, set) ? -ret :
+		       ip_set_eexist(ret, flags) ? 0 : ret;
+	}
+
+	/* Bulk loading of a range: split it into the covering networks */
+	ret = ip_set_get_hostipaddr4(tb[IPSET_ATTR_IP_TO], &ip_to);
+	if (ret)
+		return ret;
+	if (ip_to < ip)
+		swap(ip, ip_to);
+	if (ip + UINT_MAX == ip_to)
+		return -IPSET_ERR_HASH_RANGE;
+
+	do {
+		e.ip.ip = htonl(ip);
+		ip = ip_set_range_to_cidr(ip, ip_to, &e.cidr);
+		ret = adtfn(set, &e, &ext, &ext, flags);
+		if (ret && !ip_set_eexist(ret, flags))
+			return ret;
+
+		ret = 0;
+	} while (ip++ < ip_to);
+	return ret;
+}
+
+static const struct ip_set_type_variant lpm_net4_variant = {
+	.kadt	= lpm_net4_kadt,
+	.uadt	= lpm_net4_uadt,
+	.adt	= {
+		[IPSET_ADD] = lpm_net_add,
+		[IPSET_DEL] = lpm_net_del,
+		[IPSET_TEST] = lpm_net_test,
+	},
+	.destroy = lpm_net_destroy,
+	.flush	= lpm_net_flush,
+	.head	= lpm_net_head,
+	.list	= lpm_net_list,
+	.uref	= lpm_net_uref,
+	.same_set = lpm_net_same_set,
+};
+
+/* IPv6 variant */
+
+static int
+lpm_net6_kadt(struct ip_set *set, const struct sk_buff *skb,
+	      const struct xt_action_param *par,
+	      enum ipset_adt adt, struct ip_set_adt_opt *opt)
+{
+	ipset_adtfn adtfn = set->variant->adt[adt];
+	struct lpm_net_elem e = { .cidr = 128 };
+	struct ip_set_ext ext = IP_SET_INIT_KEXT(skb, opt, set);
+
+	ip6addrptr(skb, opt->flags & IPSET_DIM_ONE_SRC, &e.ip.in6);
+
+	return adtfn(set, &e, &ext, &opt->ext, opt->cmdflags);
+}
+
+static int
+lpm_net6_uadt(struct ip_set *set, struct nlattr *tb[],
+	      enum ipset_adt adt, u32 *lineno, u32 flags, bool retried)
+{
+	ipset_adtfn adtfn = set->variant->adt[adt];
+	struct lpm_net_elem e = { .cidr = 128 };
+	struct ip_set_ext ext = IP_SET_INIT_UEXT(set);
+	int ret;
+
+	if (tb[IPSET_ATTR_LINENO])
+		*lineno = nla_get_u32(tb[IPSET_ATTR_LINENO]);
+
+	if (unlikely(!tb[IPSET_ATTR_IP] ||
+		     !ip_set_optattr_netorder(tb, IPSET_ATTR_CADT_FLAGS)))
+		return -IPSET_ERR_PROTOCOL;
+	if (unlikely(tb[IPSET_ATTR_IP_TO]))
+		return -IPSET_ERR_HASH_RANGE_UNSUPPORTED;
+
+	ret = ip_set_get_ipaddr6(tb[IPSET_ATTR_IP], &e.ip);
+	if (ret)
+		return ret;
+
+	ret = ip_set_get_extensions(set, tb, &ext);
+	if (ret)
+		return ret;
+
+	if (tb[IPSET_ATTR_CIDR]) {
+		e.cidr = nla_get_u8(tb[IPSET_ATTR_CIDR]);
+		if (!e.cidr || e.cidr > 128)
+			return -IPSET_ERR_INVALID_CIDR;
+	}
+
+	ip6_netmask(&e.ip, e.cidr);
+
+	if (tb[IPSET_ATTR_CADT_FLAGS]) {
+		u32 cadt_flags = ip_set_get_h32(tb[IPSET_ATTR_CADT_FLAGS]);
+
+		if (cadt_flags & IPSET_FLAG_NOMATCH)
+			flags |= (IPSET_FLAG_NOMATCH << 16);
+	}
+
+	ret = adtfn(set, &e, &ext, &ext, flags);
+
+	return ip_set_enomatch(ret, flags, adt, set) ? -ret :
+	       ip_set_eexist(ret, flags) ? 0 : ret;
+}
+
+static const struct ip_set_type_variant lpm_net6_variant = {
+	.kadt	= lpm_net6_kadt,
+	.uadt	= lpm_net6_uadt,
+	.adt	= {
+		[IPSET_ADD] = lpm_net_add,
+		[IPSET_DEL] = lpm_net_del,
+		[IPSET_TEST] = lpm_net_test,
+	},
+	.destroy = lpm_net_destroy,
+	.flush	= lpm_net_flush,
+	.head	= lpm_net_head,
+	.list	= lpm_net_list,
+	.uref	= lpm_net_uref,
+	.same_set = lpm_net_same_set,
+};
+
+static void
+lpm_net_gc(struct timer_list *t)
+{
+	struct lpm_net *map = from_timer(map, t, gc);
+	struct ip_set *set = map->set;
+
+	spin_lock_bh(&set->lock);
+	lpm_net_expire(set);
+	spin_unlock_bh(&set->lock);
+
+	map->gc.expires = jiffies + IPSET_GC_PERIOD(set->timeout) * HZ;
+	add_timer(&map->gc);
+}
+
+static void
+lpm_net_gc_init(struct ip_set *set, void (*gc)(struct timer_list *t))
+{
+	struct lpm_net *map = set->data;
+
+	timer_setup(&map->gc, gc, 0);
+	mod_timer(&map->gc, jiffies + IPSET_GC_PERIOD(set->timeout) * HZ);
+}
+
+/* Create lpm:net type of sets */
+
+static int
+lpm_net_create(struct net *net, struct ip_set *set, struct nlattr *tb[],
+	       u32 flags)
+{
+	u32 maxelem = IPSET_DEFAULT_MAXELEM;
+	struct lpm_net *map;
+
+	if (!(set->family == NFPROTO_IPV4 || set->family == NFPROTO_IPV6))
+		return -IPSET_ERR_INVALID_FAMILY;
+
+	if (unlikely(!ip_set_optattr_netorder(tb, IPSET_ATTR_MAXELEM) ||
+		     !ip_set_optattr_netorder(tb, IPSET_ATTR_TIMEOUT) ||
+		     !ip_set_optattr_netorder(tb, IPSET_ATTR_CADT_FLAGS)))
+		return -IPSET_ERR_PROTOCOL;
+
+	if (tb[IPSET_ATTR_MAXELEM])
+		maxelem = ip_set_get_h32(tb[IPSET_ATTR_MAXELEM]);
+
+	map = kzalloc(sizeof(*map), GFP_KERNEL);
+	if (!map)
+		return -ENOMEM;
+
+	map->maxelem = maxelem;
+	map->host_mask = set->family == NFPROTO_IPV4 ? 32 : 128;
+	map->set = set;
+	set->data = map;
+
+	set->variant = set->family == NFPROTO_IPV4 ?
+		       &lpm_net4_variant : &lpm_net6_variant;
+	set->dsize = ip_set_elem_len(set, tb, sizeof(struct lpm_net_node),
+				     __alignof__(struct lpm_net_node));
+	set->timeout = IPSET_NO_TIMEOUT;
+	if (tb[IPSET_ATTR_TIMEOUT]) {
+		set->timeout = ip_set_timeout_uget(tb[IPSET_ATTR_TIMEOUT]);
+		lpm_net_gc_init(set, lpm_net_gc);
+	}
+	return 0;
+}
+
+static struct ip_set_type lpm_net_type __read_mostly = {
+	.name		= "lpm:net",
+	.protocol	= IPSET_PROTOCOL,
+	.features	= IPSET_TYPE_IP | IPSET_TYPE_NOMATCH,
+	.dimension	= IPSET_DIM_ONE,
+	.family		= NFPROTO_UNSPEC,
+	.revision_min	= IPSET_TYPE_REV_MIN,
+	.revision_max	= IPSET_TYPE_REV_MAX,
+	.create		= lpm_net_create,
+	.create_policy	= {
+		[IPSET_ATTR_MAXELEM]	= { .type = NLA_U32 },
+		[IPSET_ATTR_TIMEOUT]	= { .type = NLA_U32 },
+		[IPSET_ATTR_CADT_FLAGS]	= { .type = NLA_U32 },
+	},
+	.adt_policy	= {
+		[IPSET_ATTR_IP]		= { .type = NLA_NESTED },
+		[IPSET_ATTR_IP_TO]	= { .type = NLA_NESTED },
+		[IPSET_ATTR_CIDR]	= { .type = NLA_U8 },
+		[IPSET_ATTR_TIMEOUT]	= { .type = NLA_U32 },
+		[IPSET_ATTR_LINENO]	= { .type = NLA_U32 },
+		[IPSET_ATTR_CADT_FLAGS]	= { .type = NLA_U32 },
+		[IPSET_ATTR_BYTES]	= { .type = NLA_U64 },
+		[IPSET_ATTR_PACKETS]	= { .type = NLA_U64 },
+		[IPSET_ATTR_COMMENT]	= { .type = NLA_NUL_STRING,
+					    .len  = IPSET_MAX_COMMENT_SIZE },
+		[IPSET_ATTR_SKBMARK]	= { .type = NLA_U64 },
+		[IPSET_ATTR_SKBPRIO]	= { .type = NLA_U32 },
+		[IPSET_ATTR_SKBQUEUE]	= { .type = NLA_U16 },
+	},
+	.me		= THIS_MODULE,
+};
+
+static int __init
+lpm_net_init(void)
+{
+	return ip_set_type_register(&lpm_net_type);
+}
+
+static void __exit
+lpm_net_fini(void)
+{
+	rcu_barrier();
+	ip_set_type_unregister(&lpm_net_type);
+}
+
+module_init(lpm_net_init);
+module_exit(lpm_net_fini);